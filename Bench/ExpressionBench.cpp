@@ -0,0 +1,569 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include "Expression/CorpusGenerator.h"
+#include "Expression/ExecutionContext.h"
+#include "Expression/Metrics.h"
+#include "Expression/StatementParser.h"
+#include "Expression/StatementScanner.h"
+#include "Utils/StreamMethods.h"
+
+#ifndef ExpressionBench_CORPUS
+    #define ExpressionBench_CORPUS "."
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/resource.h>
+#endif
+
+using namespace Rt2;
+using namespace Rt2::Eq;
+
+// Usage: ExpressionBench [--quick] [--repeat n] [--filter text]
+//                        [--corpus dir] [--out file]
+//                        [--scale] [--generate file] [generator options]
+//
+// Every benchmark runs a fixed amount of work on deterministic input,
+// repeat times, and reports the median together with the fastest and
+// slowest run. The results are written as JSON to --out, or to stdout;
+// progress goes to stderr.
+//
+// --scale instead compiles generated sources of doubling size and
+// reports the time and memory of each step, and --generate writes
+// one generated source to a file. The generator options are
+// --seed, --statements, --variables, --depth, --ops, --calls,
+// --lists and --functions; see CorpusOptions.
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        bool   quick{false};
+        int    repeat{7};
+        String filter;
+        String corpus{ExpressionBench_CORPUS};
+        String out;
+        bool   scale{false};
+        String generate;
+
+        CorpusOptions source;
+    };
+
+    struct Result
+    {
+        String      name;
+        const char* unit{""};
+        bool        higherIsBetter{true};
+        double      median{0};
+        double      min{0};
+        double      max{0};
+        U64         work{0};
+    };
+
+    using Results = SimpleArray<Result>;
+
+    struct ScaleStep
+    {
+        U32    statements{0};
+        size_t bytes{0};
+        size_t symbols{0};
+        double parseMs{0};
+        double compileMs{0};
+        U64    programBytes{0};
+        U64    peakKb{0};
+    };
+
+    using ScaleSteps = SimpleArray<ScaleStep>;
+
+    // Formulas of the scalar tests in Test1.cpp.
+    const char* const Formulas[][2] = {
+        {        "mul", "1000*x"},
+        {     "modcos", "mod(cos(x), 3)"},
+        {   "rational", "(3.1415926535897932*x-a)/(x+b)"},
+        {  "constants", "1.0 + 9.0 / 10.0 + 9.0 / 100.0 + 6.0 / 1000.0 + 5.0 / 10000.0"},
+        { "assignment", "a=sin(x/2),b=4*atan(1)"},
+        {"precedence", "y = 7+2*2"},
+        {     "chain", "a=b=c=d=e=f=1"},
+        {       "list", "x={0,1,2,3}, y=[4,5,6,7], z={8,9,10,11}"},
+    };
+
+    double seconds(const Clock::time_point& start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    /// <summary>
+    /// Runs body repeat times. Each call returns the measured value
+    /// of one run, which is summarized by its median and range.
+    /// </summary>
+    template <typename Body>
+    Result measure(const Options& options, const String& name, const char* unit, const bool higher, const U64 work, Body body)
+    {
+        SimpleArray<double> runs;
+        for (int i = 0; i < options.repeat; ++i)
+            runs.push_back(body());
+        std::sort(runs.data(), runs.data() + runs.size());
+
+        Result r;
+        r.name           = name;
+        r.unit           = unit;
+        r.higherIsBetter = higher;
+        r.median         = runs[runs.size() / 2];
+        r.min            = runs[0];
+        r.max            = runs[runs.size() - 1];
+        r.work           = work;
+
+        std::cerr << name << ": " << r.median << ' ' << unit << '\n';
+        return r;
+    }
+
+    bool selected(const Options& options, const String& name)
+    {
+        return options.filter.empty() || name.find(options.filter) != String::npos;
+    }
+
+    bool readFile(const String& path, String& dest)
+    {
+        InputFileStream in(path, std::ios::binary);
+        if (!in.is_open())
+            return false;
+        StringStream ss;
+        ss << in.rdbuf();
+        dest = ss.str();
+        return true;
+    }
+
+    U64 scanTokens(const String& text)
+    {
+        StringStream ss(text);
+
+        StatementScanner scanner;
+        scanner.attach(&ss, PathUtil("bench"));
+
+        Token tok;
+        U64   nr = 0;
+        do
+        {
+            scanner.scan(tok);
+            ++nr;
+        } while (tok.type() != TOK_EOF);
+        return nr;
+    }
+
+    void benchScan(const Options& options, Results& results)
+    {
+        String corpus;
+        for (int i = 0; i < 4; ++i)
+        {
+            String text;
+            const String path = options.corpus + "/scan" + std::to_string(i) + ".eq";
+            if (!readFile(path, text))
+            {
+                std::cerr << "scan.corpus: cannot read " << path << '\n';
+                return;
+            }
+            corpus += text + "\n";
+        }
+
+        // the corpora are tiny, so they are scanned many times
+        const int passes = options.quick ? 2000 : 20000;
+        if (selected(options, "scan.corpus"))
+        {
+            results.push_back(measure(options, "scan.corpus", "MB/s", true, corpus.size() * passes, [&]
+                                      {
+                                          const auto start = Clock::now();
+                                          for (int p = 0; p < passes; ++p)
+                                              scanTokens(corpus);
+                                          return double(corpus.size() * passes) / 1e6 / seconds(start);
+                                      }));
+        }
+    }
+
+    void benchSynthetic(const Options& options, Results& results)
+    {
+        CorpusOptions source = options.source;
+        source.statements    = options.quick ? 2000 : 60000;
+        const String text    = CorpusGenerator(source).generate();
+
+        if (selected(options, "scan.synthetic"))
+        {
+            results.push_back(measure(options, "scan.synthetic", "MB/s", true, text.size(), [&]
+                                      {
+                                          const auto start = Clock::now();
+                                          scanTokens(text);
+                                          return double(text.size()) / 1e6 / seconds(start);
+                                      }));
+        }
+
+        if (selected(options, "parse.synthetic"))
+        {
+            results.push_back(measure(options, "parse.synthetic", "MB/s", true, text.size(), [&]
+                                      {
+                                          StringStream    ss(text);
+                                          StatementParser parser(0x800);
+
+                                          const auto start = Clock::now();
+                                          parser.read(ss);
+                                          return double(text.size()) / 1e6 / seconds(start);
+                                      }));
+        }
+
+        if (selected(options, "compile.synthetic"))
+        {
+            StringStream    ss(text);
+            StatementParser parser(0x800);
+            parser.read(ss);
+
+            results.push_back(measure(options, "compile.synthetic", "Msymbols/s", true, parser.symbols().size(), [&]
+                                      {
+                                          const auto start   = Clock::now();
+                                          ProgramPtr program = Program::compile(parser.symbols());
+                                          return double(parser.symbols().size()) / 1e6 / seconds(start);
+                                      }));
+        }
+    }
+
+    void benchExecute(const Options& options, Results& results)
+    {
+        const size_t iterations = options.quick ? 100000 : 2000000;
+
+        for (const auto& [id, source] : Formulas)
+        {
+            const String name = String("execute.") + id;
+            if (!selected(options, name))
+                continue;
+
+            StringStream ss;
+            ss << source;
+            StatementParser parser;
+            parser.read(ss);
+
+            ExecutionContext ctx(Program::compile(parser.symbols()));
+            ctx.set("x", 0.5);
+            ctx.set("a", 1.5);
+            ctx.set("b", 2.5);
+
+            Math::Real sink = 0;
+            results.push_back(measure(options, name, "ns/op", false, iterations, [&]
+                                      {
+                                          const auto start = Clock::now();
+                                          for (size_t i = 0; i < iterations; ++i)
+                                              sink += ctx.execute();
+                                          return seconds(start) * 1e9 / double(iterations);
+                                      }));
+            if (!ctx.status().ok())
+                std::cerr << name << ": " << ctx.status().message() << '\n';
+        }
+    }
+
+    void benchBatch(const Options& options, Results& results)
+    {
+        StringStream ss;
+        ss << "a = sin(x/2), y = a*x + c*sqrt(abs(x))";
+        StatementParser parser;
+        parser.read(ss);
+        const ProgramPtr program = Program::compile(parser.symbols());
+
+        const size_t rows = options.quick ? size_t(1) << 16 : size_t(1) << 22;
+
+        SimpleArray<Math::Real> x, y;
+        x.resizeFast(rows);
+        y.resizeFast(rows);
+        for (size_t i = 0; i < rows; ++i)
+            x[i] = Math::Real(i % 1000) / 100;
+
+        const size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+        // powers of two up to the hardware threads, and that count itself
+        for (size_t threads = 1; threads <= hardware; threads = threads < hardware ? std::min(threads * 2, hardware) : hardware + 1)
+        {
+            const String name = "batch.threads" + std::to_string(threads);
+            if (!selected(options, name))
+                continue;
+
+            // one context per thread, each bound to its own slice
+            const size_t                   slice = (rows + threads - 1) / threads;
+            SimpleArray<ExecutionContext*> contexts;
+            for (size_t t = 0; t < threads; ++t)
+            {
+                const size_t first = std::min(rows, t * slice);
+
+                auto* ctx = new ExecutionContext(program);
+                ctx->set("c", 0.25);
+                ctx->bind("x", StridedView::column(x.data() + first));
+                ctx->bind("y", StridedView::column(y.data() + first));
+                contexts.push_back(ctx);
+            }
+
+            results.push_back(measure(options, name, "Mrows/s", true, rows, [&]
+                                      {
+                                          const std::unique_ptr<std::thread[]> workers(new std::thread[threads]);
+
+                                          const auto start = Clock::now();
+                                          for (size_t t = 0; t < threads; ++t)
+                                          {
+                                              const size_t first = std::min(rows, t * slice);
+                                              const size_t nr    = std::min(rows, first + slice) - first;
+                                              workers[t] = std::thread([ctx = contexts[t], nr]
+                                                                       { ctx->executeBatch(nr); });
+                                          }
+                                          for (size_t t = 0; t < threads; ++t)
+                                              workers[t].join();
+                                          return double(rows) / 1e6 / seconds(start);
+                                      }));
+
+            for (const ExecutionContext* ctx : contexts)
+                delete ctx;
+        }
+    }
+
+    /// <summary>
+    /// Peak resident set size of the process in kilobytes,
+    /// or zero where it is not available.
+    /// </summary>
+    U64 peakMemory()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        rusage usage{};
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+    #if defined(__APPLE__)
+        return U64(usage.ru_maxrss) / 1024;
+    #else
+        return U64(usage.ru_maxrss);
+    #endif
+#else
+        return 0;
+#endif
+    }
+
+    void benchScale(const Options& options, ScaleSteps& steps)
+    {
+        // The compiled size is read from the metrics that
+        // Program::build records, rather than estimated here.
+        Metrics metrics;
+        Metrics::install(&metrics);
+
+        const U32 last = options.quick ? 1 << 14 : 1 << 18;
+        for (U32 statements = 1 << 10; statements <= last; statements *= 2)
+        {
+            CorpusOptions source = options.source;
+            source.statements    = statements;
+            const String text    = CorpusGenerator(source).generate();
+
+            ScaleStep step;
+            step.statements = statements;
+            step.bytes      = text.size();
+
+            SimpleArray<double> parse, compile;
+            for (int i = 0; i < options.repeat; ++i)
+            {
+                StringStream    ss(text);
+                StatementParser parser(0x800);
+
+                auto start = Clock::now();
+                parser.read(ss);
+                parse.push_back(seconds(start) * 1e3);
+
+                metrics.reset();
+                start                    = Clock::now();
+                const ProgramPtr program = Program::compile(parser.symbols());
+                compile.push_back(seconds(start) * 1e3);
+
+                MetricsSnapshot snap;
+                metrics.snapshot(snap);
+                step.symbols      = parser.symbols().size();
+                step.programBytes = snap[CountProgramBytes];
+            }
+            std::sort(parse.data(), parse.data() + parse.size());
+            std::sort(compile.data(), compile.data() + compile.size());
+
+            step.parseMs   = parse[parse.size() / 2];
+            step.compileMs = compile[compile.size() / 2];
+            step.peakKb    = peakMemory();
+            steps.push_back(step);
+
+            std::cerr << "scale " << statements << ": parse " << step.parseMs
+                      << " ms, compile " << step.compileMs
+                      << " ms, program " << step.programBytes << " bytes\n";
+        }
+        Metrics::install(nullptr);
+    }
+
+    void write(OStream&          out,
+               const Options&    options,
+               const Results&    results,
+               const ScaleSteps& steps)
+    {
+        out << "{\n  \"benchmark\": \"ExpressionBench\",\n"
+            << "  \"schema\": 1,\n"
+            << "  \"quick\": " << (options.quick ? "true" : "false") << ",\n"
+            << "  \"repeat\": " << options.repeat << ",\n"
+            << "  \"hardwareThreads\": " << std::thread::hardware_concurrency() << ",\n"
+            << "  \"results\": [";
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result& r = results[i];
+            out << (i > 0 ? ",\n    " : "\n    ")
+                << "{\"name\": \"" << r.name
+                << "\", \"unit\": \"" << r.unit
+                << "\", \"better\": \"" << (r.higherIsBetter ? "higher" : "lower")
+                << "\", \"median\": " << r.median
+                << ", \"min\": " << r.min
+                << ", \"max\": " << r.max
+                << ", \"work\": " << r.work << '}';
+        }
+        out << "\n  ]";
+
+        if (!steps.empty())
+        {
+            out << ",\n  \"scale\": [";
+            for (size_t i = 0; i < steps.size(); ++i)
+            {
+                const ScaleStep& st = steps[i];
+                out << (i > 0 ? ",\n    " : "\n    ")
+                    << "{\"statements\": " << st.statements
+                    << ", \"bytes\": " << st.bytes
+                    << ", \"symbols\": " << st.symbols
+                    << ", \"parseMs\": " << st.parseMs
+                    << ", \"compileMs\": " << st.compileMs
+                    << ", \"programBytes\": " << st.programBytes
+                    << ", \"peakKb\": " << st.peakKb << '}';
+            }
+            out << "\n  ]";
+        }
+        out << "\n}\n";
+    }
+
+    bool parseOptions(const int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const char* arg  = argv[i];
+            const bool  more = i + 1 < argc;
+
+            if (std::strcmp(arg, "--quick") == 0)
+                options.quick = true;
+            else if (std::strcmp(arg, "--repeat") == 0 && more)
+                options.repeat = std::max(1, std::atoi(argv[++i]));
+            else if (std::strcmp(arg, "--filter") == 0 && more)
+                options.filter = argv[++i];
+            else if (std::strcmp(arg, "--corpus") == 0 && more)
+                options.corpus = argv[++i];
+            else if (std::strcmp(arg, "--out") == 0 && more)
+                options.out = argv[++i];
+            else if (std::strcmp(arg, "--scale") == 0)
+                options.scale = true;
+            else if (std::strcmp(arg, "--generate") == 0 && more)
+                options.generate = argv[++i];
+            else if (std::strcmp(arg, "--seed") == 0 && more)
+                options.source.seed = std::strtoull(argv[++i], nullptr, 10);
+            else if (std::strcmp(arg, "--statements") == 0 && more)
+                options.source.statements = (U32)std::max(1, std::atoi(argv[++i]));
+            else if (std::strcmp(arg, "--variables") == 0 && more)
+                options.source.variables = (U32)std::max(1, std::atoi(argv[++i]));
+            else if (std::strcmp(arg, "--depth") == 0 && more)
+                options.source.depth = (U32)std::max(0, std::atoi(argv[++i]));
+            else if (std::strcmp(arg, "--ops") == 0 && more)
+                options.source.operators = argv[++i];
+            else if (std::strcmp(arg, "--calls") == 0 && more)
+                options.source.calls = std::atof(argv[++i]);
+            else if (std::strcmp(arg, "--lists") == 0 && more)
+                options.source.lists = std::atof(argv[++i]);
+            else if (std::strcmp(arg, "--functions") == 0 && more)
+                options.source.functions = (U32)std::max(0, std::atoi(argv[++i]));
+            else
+            {
+                std::cerr << "usage: ExpressionBench [--quick] [--repeat n] "
+                             "[--filter text] [--corpus dir] [--out file]\n"
+                             "                      [--scale] [--generate file] [--seed n]\n"
+                             "                      [--statements n] [--variables n] [--depth n]\n"
+                             "                      [--ops chars] [--calls p] [--lists p] [--functions n]\n";
+                return false;
+            }
+        }
+        if (options.quick && options.repeat == Options{}.repeat)
+            options.repeat = 3;
+        return true;
+    }
+}  // namespace
+
+int main(const int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    if (!options.generate.empty())
+    {
+        OutputFileStream out(options.generate);
+        if (!out.is_open())
+        {
+            std::cerr << "cannot write " << options.generate << '\n';
+            return 1;
+        }
+        CorpusGenerator(options.source).write(out);
+        return 0;
+    }
+
+    Results    results;
+    ScaleSteps steps;
+    try
+    {
+        if (options.scale)
+            benchScale(options, steps);
+        else
+        {
+            benchScan(options, results);
+            benchSynthetic(options, results);
+            benchExecute(options, results);
+            benchBatch(options, results);
+        }
+    }
+    catch (Exception& ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return 1;
+    }
+
+    if (options.out.empty())
+        write(std::cout, options, results, steps);
+    else
+    {
+        OutputFileStream out(options.out);
+        if (!out.is_open())
+        {
+            std::cerr << "cannot write " << options.out << '\n';
+            return 1;
+        }
+        write(out, options, results, steps);
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include <chrono>
+#include "Expression/BoxedValue.h"
+#include "Expression/StackValue.h"
+#include "Utils/Console.h"
+
+using namespace Rt2;
+using namespace Rt2::Eq;
+
+namespace
+{
+    constexpr size_t Iterations = 20000000;
+
+    StackValue makeValue(const Math::Real v, StackValue*)
+    {
+        StackValue r;
+        r.v = v;
+        return r;
+    }
+
+    BoxedValue makeValue(const Math::Real v, BoxedValue*)
+    {
+        return BoxedValue(v);
+    }
+
+    Math::Real valueOf(const StackValue& v)
+    {
+        return v.v;
+    }
+
+    Math::Real valueOf(const BoxedValue& v)
+    {
+        return v.value();
+    }
+
+    /// <summary>
+    /// Replays the stack traffic of 'y = a * b + c' the way the
+    /// ExecutionContext does it, and returns the time per push in
+    /// nanoseconds.
+    /// </summary>
+    template <typename T>
+    double run(Math::Real& sink)
+    {
+        Stack<T, AOP_SIMPLE_TYPE> stack;
+        stack.reserve(16);
+
+        constexpr T* tag = nullptr;
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < Iterations; ++i)
+        {
+            stack.resizeFast(0);
+            stack.push(makeValue(Math::Real(i & 0xFF), tag));
+            stack.push(makeValue(1.5, tag));
+            {
+                const T b = stack.popTop();
+                const T a = stack.popTop();
+                stack.push(makeValue(valueOf(a) * valueOf(b), tag));
+            }
+            stack.push(makeValue(0.25, tag));
+            {
+                const T b = stack.popTop();
+                const T a = stack.popTop();
+                stack.push(makeValue(valueOf(a) + valueOf(b), tag));
+            }
+            sink += valueOf(stack.top());
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        return ns / double(Iterations * 5);
+    }
+
+    template <typename T>
+    void report(const char* name)
+    {
+        Math::Real   sink = 0;
+        const double ns   = run<T>(sink);
+
+        Console::println(name,
+                         ": ",
+                         sizeof(T),
+                         " bytes, ",
+                         ns,
+                         " ns/push, ",
+                         1000.0 / ns,
+                         " Mpush/s",
+                         " (",
+                         sink,
+                         ")");
+    }
+}  // namespace
+
+int main(int, char**)
+{
+    report<StackValue>("StackValue");
+    report<BoxedValue>("BoxedValue");
+    return 0;
+}
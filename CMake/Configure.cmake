@@ -11,7 +11,10 @@ set_property(GLOBAL PROPERTY USE_FOLDERS ON)
 
 option(Expression_BUILD_TEST          "Build the unit test program." ON)
 option(Expression_AUTO_RUN_TEST       "Automatically run the test program." ON)
+option(Expression_BUILD_BENCH         "Build the benchmark programs." OFF)
+option(Expression_BUILD_TOOLS         "Build the command line tools." ON)
 option(Expression_USE_STATIC_RUNTIME  "Build with the MultiThreaded(Debug) runtime library." ON)
+option(Expression_PROFILE             "Count and time each executed instruction." OFF)
 
 if (Expression_USE_STATIC_RUNTIME)
     set_static_runtime()
@@ -19,6 +22,12 @@ else()
     set_dynamic_runtime()
 endif()
 
+# Changes the layout of ExecutionContext, so it is
+# defined for every target rather than just the library.
+if (Expression_PROFILE)
+    add_definitions(-DExpression_PROFILE=1)
+endif()
+
 
 configure_gtest(${Expression_SOURCE_DIR}/Test/googletest 
                 ${Expression_SOURCE_DIR}/Test/googletest/googletest/include)
@@ -0,0 +1,582 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/BatchEvaluator.h"
+#include <cassert>
+#include <type_traits>
+#include "Expression/Operators.h"
+#include "Math/Math.h"
+
+namespace Rt2::Eq
+{
+    template <typename T>
+    void BasicBatchEvaluator<T>::prepare(const Program& program)
+    {
+        _program = &program;
+
+        const size_t depth = program.stackDepth() + 1;
+        const size_t nr    = program.slots().size();
+
+        _stack.resizeFast(depth * BatchLanes);
+        _ids.resizeFast(depth);
+        _slots.resizeFast(nr * BatchLanes);
+        _written.resizeFast(nr);
+        for (U8& w : _written)
+            w = 0;
+    }
+
+    template <typename T>
+    void BasicBatchEvaluator<T>::load(const BoxedArray& values,
+                                      const Bindings&   bindings,
+                                      const Fallback&   fallback,
+                                      const size_t      first)
+    {
+        for (size_t s = 0; s < _written.size(); ++s)
+        {
+            T* dest = slot(s);
+
+            if (s < bindings.size() && bindings[s].isBound())
+            {
+                const BasicStridedView<T>& view = bindings[s];
+                for (size_t i = 0; i < _lanes; ++i)
+                    dest[i] = view.at(first + i);
+            }
+            else if (s < fallback.size() && fallback[s].isBound())
+            {
+                const BasicStridedView<Other>& view = fallback[s];
+                for (size_t i = 0; i < _lanes; ++i)
+                    dest[i] = T(view.at(first + i));
+            }
+            else
+            {
+                const T v = s < values.size() ? T(values[s].value()) : 0;
+                for (size_t i = 0; i < _lanes; ++i)
+                    dest[i] = v;
+            }
+        }
+    }
+
+    template <typename T>
+    void BasicBatchEvaluator<T>::store(const Bindings& bindings,
+                                       const Fallback& fallback,
+                                       const size_t    first)
+    {
+        for (size_t s = 0; s < _written.size(); ++s)
+        {
+            if (!_written[s])
+                continue;
+
+            if (s < bindings.size() && bindings[s].isBound())
+            {
+                const BasicStridedView<T>& view = bindings[s];
+                const T*                  src  = slot(s);
+                for (size_t i = 0; i < _lanes; ++i)
+                    view.at(first + i) = src[i];
+            }
+            else if (s < fallback.size() && fallback[s].isBound())
+            {
+                const BasicStridedView<Other>& view = fallback[s];
+                const T*                      src  = slot(s);
+                for (size_t i = 0; i < _lanes; ++i)
+                    view.at(first + i) = Other(src[i]);
+            }
+        }
+    }
+
+    template <typename T>
+    void BasicBatchEvaluator<T>::fail(const ErrorCode code, const char* op)
+    {
+        if (_status.code == ErrorNone)
+        {
+            _status.code = code;
+            _status.op   = op;
+        }
+    }
+
+    template <typename T>
+    bool BasicBatchEvaluator<T>::require(const size_t nr, const char* op)
+    {
+        if (_top < nr)
+        {
+            fail(ErrorStackUnderflow, op);
+            return false;
+        }
+        return true;
+    }
+
+    template <typename T>
+    void BasicBatchEvaluator<T>::push(const T v)
+    {
+        // the stack is sized from Program::stackDepth
+        assert(_top < _ids.size());
+        T* dest = lane(_top);
+        for (size_t i = 0; i < _lanes; ++i)
+            dest[i] = v;
+        _ids[_top++] = Npos;
+    }
+
+    template <typename T>
+    void BasicBatchEvaluator<T>::pushSlot(const U32 idx)
+    {
+        assert(_top < _ids.size());
+        T*       dest = lane(_top);
+        const T* src  = slot(idx);
+        for (size_t i = 0; i < _lanes; ++i)
+            dest[i] = src[i];
+        _ids[_top++] = idx;
+    }
+
+    template <typename T>
+    void BasicBatchEvaluator<T>::pushReference(const U32 idx)
+    {
+        // Only the target slot is needed, the
+        // assignment overwrites the lanes.
+        assert(_top < _ids.size());
+        _ids[_top++] = idx;
+    }
+
+    template <typename T>
+    template <typename Op>
+    void BasicBatchEvaluator<T>::binary(Op op, const char* name)
+    {
+        if (!require(2, name))
+            return;
+        const T* b = lane(--_top);
+        T*       a = lane(_top - 1);
+        for (size_t i = 0; i < _lanes; ++i)
+            a[i] = op(a[i], b[i]);
+        _ids[_top - 1] = Npos;
+    }
+
+    template <typename T>
+    template <typename Op>
+    void BasicBatchEvaluator<T>::unary(Op op, const char* name)
+    {
+        if (!require(1, name))
+            return;
+        T* a = lane(_top - 1);
+        for (size_t i = 0; i < _lanes; ++i)
+            a[i] = op(a[i]);
+        _ids[_top - 1] = Npos;
+    }
+
+    template <typename T>
+    void BasicBatchEvaluator<T>::select()
+    {
+        if (!require(3, "select"))
+            return;
+
+        // Both sides were evaluated for every lane, so the condition
+        // is applied as a compare and blend with no branch per row.
+        const T* b = lane(--_top);
+        const T* a = lane(--_top);
+        T*       c = lane(_top - 1);
+        for (size_t i = 0; i < _lanes; ++i)
+            c[i] = SelectOp()(c[i], a[i], b[i]);
+        _ids[_top - 1] = Npos;
+    }
+
+    template <typename T>
+    void BasicBatchEvaluator<T>::assign()
+    {
+        if (!require(2, "assign"))
+            return;
+        const T* b  = lane(--_top);
+        T*       a  = lane(_top - 1);
+        const size_t      id = _ids[_top - 1];
+
+        if (id != Npos)
+        {
+            T* dest = slot(id);
+            for (size_t i = 0; i < _lanes; ++i)
+                dest[i] = b[i];
+            _written[id] = 1;
+        }
+
+        for (size_t i = 0; i < _lanes; ++i)
+            a[i] = b[i];
+        _ids[_top - 1] = Npos;
+    }
+
+    template <typename T>
+    void BasicBatchEvaluator<T>::mathFncA1(const Fn1 f)
+    {
+        if (!require(2, "math function"))
+            return;
+        if (I32(lane(--_top)[0]) != 1)
+        {
+            fail(ErrorArgumentCount, "math function");
+            return;
+        }
+
+        T* a = lane(_top - 1);
+        for (size_t i = 0; i < _lanes; ++i)
+            a[i] = f(a[i]);
+        _ids[_top - 1] = Npos;
+    }
+
+    template <typename T>
+    void BasicBatchEvaluator<T>::mathFncA2(const Fn2 f)
+    {
+        if (!require(3, "math function"))
+            return;
+        if (I32(lane(--_top)[0]) != 2)
+        {
+            fail(ErrorArgumentCount, "math function");
+            return;
+        }
+
+        const T* b = lane(--_top);
+        T*       a = lane(_top - 1);
+        for (size_t i = 0; i < _lanes; ++i)
+            a[i] = f(a[i], b[i]);
+        _ids[_top - 1] = Npos;
+    }
+
+    template <typename T>
+    void BasicBatchEvaluator<T>::reduce(const U8 op)
+    {
+        if (!require(1, "reduction"))
+            return;
+        const size_t nr = (size_t)I32(lane(--_top)[0]);
+        if (nr < 1 || _top < nr)
+        {
+            fail(ErrorStackUnderflow, "reduction");
+            return;
+        }
+        if (op == MathDot && nr != 2)
+        {
+            fail(ErrorArgumentCount, "dot");
+            return;
+        }
+
+        // Lanes only hold single values, so each reduction
+        // folds its arguments together lane by lane.
+        const size_t first = _top - nr;
+        T*           a     = lane(first);
+
+        for (size_t k = first + 1; k < _top; ++k)
+        {
+            const T* b = lane(k);
+            switch (op)
+            {
+            case MathSum:
+            case MathMean:
+                for (size_t i = 0; i < _lanes; ++i)
+                    a[i] += b[i];
+                break;
+            case MathMin:
+                for (size_t i = 0; i < _lanes; ++i)
+                    a[i] = b[i] < a[i] ? b[i] : a[i];
+                break;
+            case MathMax:
+                for (size_t i = 0; i < _lanes; ++i)
+                    a[i] = b[i] > a[i] ? b[i] : a[i];
+                break;
+            case MathDot:
+                for (size_t i = 0; i < _lanes; ++i)
+                    a[i] *= b[i];
+                break;
+            case MathNorm:
+                if (k == first + 1)
+                {
+                    for (size_t i = 0; i < _lanes; ++i)
+                        a[i] *= a[i];
+                }
+                for (size_t i = 0; i < _lanes; ++i)
+                    a[i] += b[i] * b[i];
+                break;
+            default:
+                break;
+            }
+        }
+
+        if (op == MathMean)
+        {
+            const T s = T(1) / T(nr);
+            for (size_t i = 0; i < _lanes; ++i)
+                a[i] *= s;
+        }
+        else if (op == MathNorm)
+        {
+            if (nr == 1)
+            {
+                for (size_t i = 0; i < _lanes; ++i)
+                    a[i] = std::abs(a[i]);
+            }
+            else
+            {
+                for (size_t i = 0; i < _lanes; ++i)
+                    a[i] = std::sqrt(a[i]);
+            }
+        }
+
+        _top        = first + 1;
+        _ids[first] = Npos;
+    }
+
+    template <typename T>
+    void BasicBatchEvaluator<T>::call(const U32 index)
+    {
+        const NativeFunction& fn   = _program->functions()[index];
+        const char*           name = fn.name.c_str();
+
+        if (!require(1, name))
+            return;
+        const size_t nr = (size_t)I32(lane(--_top)[0]);
+        if (nr < 1 || _top < nr)
+        {
+            fail(ErrorStackUnderflow, name);
+            return;
+        }
+        if (!fn.isResolved())
+        {
+            fail(ErrorUnknownFunction, name);
+            return;
+        }
+        if (fn.arity != AnyArity && (size_t)fn.arity != nr)
+        {
+            fail(ErrorArgumentCount, name);
+            return;
+        }
+
+        // The lane that held the argument count is free,
+        // so the results go there and are then moved down.
+        const size_t first = _top - nr;
+        T*           out   = lane(_top);
+
+        if constexpr (std::is_same_v<T, Math::Real>)
+        {
+            if (fn.batch)
+            {
+                _argLanes.resizeFast(nr);
+                for (size_t k = 0; k < nr; ++k)
+                    _argLanes[k] = lane(first + k);
+                fn.batch(out, _argLanes.data(), (U32)nr, _lanes);
+            }
+        }
+
+        if (!fn.batch || !std::is_same_v<T, Math::Real>)
+        {
+            _args.resizeFast(nr);
+            for (size_t i = 0; i < _lanes; ++i)
+            {
+                for (size_t k = 0; k < nr; ++k)
+                    _args[k] = Math::Real(lane(first + k)[i]);
+                out[i] = T(fn.scalar(_args.data(), (U32)nr));
+            }
+        }
+
+        T* a = lane(first);
+        for (size_t i = 0; i < _lanes; ++i)
+            a[i] = out[i];
+
+        _top        = first + 1;
+        _ids[first] = Npos;
+    }
+
+    template <typename T>
+    void BasicBatchEvaluator<T>::eval(const Instruction& ins)
+    {
+        // clang-format off
+    switch (ins.op) {
+    case Numerical  : push(_program->constantPool<T>()[ins.arg]); break;
+    case Identifier : pushSlot(ins.arg); break;
+    case Reference  : pushReference(ins.arg); break;
+    case MathPi     : push(T(Math::Pi)); break;
+    case MathE      : push(T(Math::E));  break;
+    case Add        : binary(AddOp(), "add"); break;
+    case Sub        : binary(SubOp(), "sub"); break;
+    case Mul        : binary(MulOp(), "mul"); break;
+    case Div        : binary(DivOp(), "div"); break;
+    case Pow        : binary(PowOp(), "pow"); break;
+    case Mod        : binary(ModOp(), "mod"); break;
+    case Less       : binary(LessOp(), "lt");         break;
+    case LessEqual  : binary(LessEqualOp(), "le");    break;
+    case Greater    : binary(GreaterOp(), "gt");      break;
+    case GreaterEqual: binary(GreaterEqualOp(), "ge"); break;
+    case Equal      : binary(EqualOp(), "eq");        break;
+    case NotEqual   : binary(NotEqualOp(), "ne");     break;
+    case And        : binary(AndOp(), "and");         break;
+    case Or         : binary(OrOp(), "or");           break;
+    case Neg        : unary(NegOp(), "neg");          break;
+    case Not        : unary(NotOp(), "not");          break;
+    case BitwiseNot : unary(BitwiseNotOp(), "bnot");  break;
+    case Select     : select();          break;
+    case Assignment : assign();          break;
+    case Grouping   :
+    case ConstantList: fail(ErrorUnsupported, "list"); break;
+    case MathSin    : mathFncA1(std::sin);    break;
+    case MathAtan   : mathFncA1(std::atan);   break;
+    case MathAbs    : mathFncA1(std::fabs);   break;
+    case MathAcos   : mathFncA1(std::acos);   break;
+    case MathAsin   : mathFncA1(std::asin);   break;
+    case MathAtan2  : mathFncA2(std::atan2);  break;
+    case MathCeil   : mathFncA1(std::ceil);   break;
+    case MathCos    : mathFncA1(std::cos);    break;
+    case MathCosh   : mathFncA1(std::cosh);   break;
+    case MathExp    : mathFncA1(std::exp);    break;
+    case MathFabs   : mathFncA1(std::fabs);   break;
+    case MathFloor  : mathFncA1(std::floor);  break;
+    case MathFmod   : mathFncA2(lMod<T>);     break;
+    case MathLog    : mathFncA1(std::log);    break;
+    case MathLog10  : mathFncA1(std::log10);  break;
+    case MathPow    : mathFncA2(std::pow);    break;
+    case MathSinh   : mathFncA1(std::sinh);   break;
+    case MathSqrt   : mathFncA1(std::sqrt);   break;
+    case MathTan    : mathFncA1(std::tan);    break;
+    case MathTanh   : mathFncA1(std::tanh);   break;
+    case MathSum    :
+    case MathMin    :
+    case MathMax    :
+    case MathMean   :
+    case MathDot    :
+    case MathNorm   : reduce(ins.op);    break;
+    case UserFunction: call(ins.arg);  break;
+    case None:
+    default:
+        break;
+    }
+        // clang-format on
+    }
+
+    template <typename T>
+    U64 BasicBatchEvaluator<T>::laneErrors() const
+    {
+        // A lane fails when its result or any value it assigned is NaN.
+        U64 bits = 0;
+
+        if (_top > 0)
+        {
+            const T* src = lane(_top - 1);
+            for (size_t i = 0; i < _lanes; ++i)
+                bits |= U64(std::isnan(src[i])) << i;
+        }
+
+        for (size_t s = 0; s < _written.size(); ++s)
+        {
+            if (_written[s])
+            {
+                const T* src = slot(s);
+                for (size_t i = 0; i < _lanes; ++i)
+                    bits |= U64(std::isnan(src[i])) << i;
+            }
+        }
+        return bits;
+    }
+
+    template <typename T>
+    bool BasicBatchEvaluator<T>::executeImpl(BoxedArray&     values,
+                                             const Bindings& bindings,
+                                             const Fallback& fallback,
+                                             const size_t    rows,
+                                             T*              results,
+                                             ErrorMask*      errors)
+    {
+        const InstructionArray& code = _program->code();
+
+        bool domain = false;
+        for (size_t first = 0; first < rows; first += BatchLanes)
+        {
+            _lanes = std::min(BatchLanes, rows - first);
+            _top   = 0;
+
+            load(values, bindings, fallback, first);
+
+            for (U32 i = 0; i < code.size(); ++i)
+            {
+                eval(code[i]);
+
+                if (_status.code != ErrorNone)
+                {
+                    // the code is the same for every row,
+                    // so none of the rows can succeed
+                    _status.instruction = i;
+                    if (errors != nullptr)
+                    {
+                        for (size_t r = 0; r < rows; r += BatchLanes)
+                            errors->setWord(r, ~U64(0));
+                    }
+                    return false;
+                }
+            }
+
+            store(bindings, fallback, first);
+
+            if (results != nullptr)
+            {
+                const T* src = _top > 0 ? lane(_top - 1) : nullptr;
+                for (size_t i = 0; i < _lanes; ++i)
+                    results[first + i] = src ? src[i] : 0;
+            }
+
+            if (errors != nullptr)
+            {
+                if (const U64 bits = laneErrors(); bits != 0)
+                {
+                    errors->setWord(first, bits);
+                    domain = true;
+                }
+            }
+        }
+
+        if (domain)
+            _status.code = ErrorDomain;
+
+        if (rows > 0)
+        {
+            for (size_t s = 0; s < _written.size() && s < values.size(); ++s)
+            {
+                if (_written[s] &&
+                    !(s < bindings.size() && bindings[s].isBound()) &&
+                    !(s < fallback.size() && fallback[s].isBound()))
+                    values[s] = BoxedValue(Math::Real(slot(s)[_lanes - 1]));
+            }
+        }
+        return true;
+    }
+
+    template <typename T>
+    bool BasicBatchEvaluator<T>::execute(const Program&  program,
+                                         BoxedArray&     values,
+                                         const Bindings& bindings,
+                                         const Fallback& fallback,
+                                         const size_t    rows,
+                                         T*              results,
+                                         ErrorMask*      errors)
+    {
+        _status = {};
+        if (errors != nullptr)
+            errors->reset(rows);
+
+        prepare(program);
+        if (!executeImpl(values, bindings, fallback, rows, results, errors))
+        {
+            _top = 0;
+            return false;
+        }
+        return true;
+    }
+
+    template class BasicBatchEvaluator<Math::Real>;
+    template class BasicBatchEvaluator<float>;
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,185 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include <type_traits>
+#include "Expression/BoxedValue.h"
+#include "Expression/ExecutionStatus.h"
+#include "Expression/Program.h"
+#include "Expression/StackValue.h"
+#include "Expression/StridedView.h"
+
+namespace Rt2::Eq
+{
+    // One ErrorMask word per block.
+    constexpr size_t BatchLanes = 64;
+
+    using LaneIds       = SimpleArray<size_t>;
+    using SlotMask      = SimpleArray<U8>;
+    using ArgumentLanes = SimpleArray<const Math::Real*>;
+
+    /// <summary>
+    /// Evaluates a program over blocks of BatchLanes rows.
+    /// Each stack entry is a block of lanes, so an instruction is
+    /// dispatched once per block and its body runs as a tight loop
+    /// over contiguous memory that the compiler can vectorize.
+    /// Rows are independent; unbound variables that are read before
+    /// they are assigned see the context's value from before the call.
+    /// T is the lane type, float lanes are half the size of double
+    /// lanes and so fit twice as many in a vector register.
+    /// </summary>
+    template <typename T>
+    class BasicBatchEvaluator
+    {
+    public:
+        using Other     = std::conditional_t<std::is_same_v<T, float>, Math::Real, float>;
+        using LaneArray = SimpleArray<T>;
+        using Bindings  = SimpleArray<BasicStridedView<T>>;
+        using Fallback  = SimpleArray<BasicStridedView<Other>>;
+        using Fn1       = T (*)(T);
+        using Fn2       = T (*)(T, T);
+
+    private:
+        const Program*  _program{nullptr};
+        LaneArray       _stack;
+        LaneIds         _ids;
+        LaneArray       _slots;
+        ValueList       _args;
+        ArgumentLanes   _argLanes;
+        SlotMask        _written;
+        size_t          _top{0};
+        size_t          _lanes{0};
+        ExecutionStatus _status;
+
+        T* lane(size_t idx);
+
+        T* slot(size_t idx);
+
+        const T* lane(size_t idx) const;
+
+        const T* slot(size_t idx) const;
+
+        void prepare(const Program& program);
+
+        void load(const BoxedArray& values,
+                  const Bindings&   bindings,
+                  const Fallback&   fallback,
+                  size_t            first);
+
+        void store(const Bindings& bindings, const Fallback& fallback, size_t first);
+
+        void fail(ErrorCode code, const char* op);
+
+        bool require(size_t nr, const char* op);
+
+        void push(T v);
+
+        void pushSlot(U32 idx);
+
+        void pushReference(U32 idx);
+
+        template <typename Op>
+        void binary(Op op, const char* name);
+
+        template <typename Op>
+        void unary(Op op, const char* name);
+
+        void select();
+        void assign();
+
+        void mathFncA1(Fn1 f);
+        void mathFncA2(Fn2 f);
+
+        void reduce(U8 op);
+
+        void call(U32 index);
+
+        void eval(const Instruction& ins);
+
+        U64 laneErrors() const;
+
+        bool executeImpl(BoxedArray&     values,
+                         const Bindings& bindings,
+                         const Fallback& fallback,
+                         size_t          rows,
+                         T*              results,
+                         ErrorMask*      errors);
+
+    public:
+        BasicBatchEvaluator() = default;
+
+        /// <summary>
+        /// Executes rows [0, rows) of the bound views. Assigned variables
+        /// that are bound are written in place; assigned variables that
+        /// are not bound receive the value of the last row. When results
+        /// is not null it receives the top of the stack for each row.
+        /// When errors is not null it receives a bit for every row whose
+        /// result or assigned values are NaN, and status() reports
+        /// ErrorDomain. A failure in the code itself marks every row.
+        /// Slots that are only bound in fallback, to views of the other
+        /// scalar type, are converted on the way in and out.
+        /// </summary>
+        /// <returns>false if the program could not be evaluated.</returns>
+        bool execute(const Program&  program,
+                     BoxedArray&     values,
+                     const Bindings& bindings,
+                     const Fallback& fallback,
+                     size_t          rows,
+                     T*              results,
+                     ErrorMask*      errors);
+
+        const ExecutionStatus& status() const;
+    };
+
+    using BatchEvaluator  = BasicBatchEvaluator<Math::Real>;
+    using BatchEvaluatorF = BasicBatchEvaluator<float>;
+
+    template <typename T>
+    T* BasicBatchEvaluator<T>::lane(const size_t idx)
+    {
+        return _stack.data() + idx * BatchLanes;
+    }
+
+    template <typename T>
+    T* BasicBatchEvaluator<T>::slot(const size_t idx)
+    {
+        return _slots.data() + idx * BatchLanes;
+    }
+
+    template <typename T>
+    const T* BasicBatchEvaluator<T>::lane(const size_t idx) const
+    {
+        return _stack.data() + idx * BatchLanes;
+    }
+
+    template <typename T>
+    const T* BasicBatchEvaluator<T>::slot(const size_t idx) const
+    {
+        return _slots.data() + idx * BatchLanes;
+    }
+
+    template <typename T>
+    const ExecutionStatus& BasicBatchEvaluator<T>::status() const
+    {
+        return _status;
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,152 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include <cstring>
+#include "Math/Scalar.h"
+#include "Utils/Array.h"
+#include "Utils/Stack.h"
+
+namespace Rt2::Eq
+{
+    /// <summary>
+    /// Eight byte stack value.
+    /// Numbers are stored as their IEEE-754 bits. Identifiers and lists
+    /// are stored in the payload of a negative quiet NaN whose upper
+    /// sixteen bits act as the tag, with the slot or list handle in the
+    /// low 32 bits. Incoming NaNs are canonicalized so that they can
+    /// never be mistaken for a tag.
+    /// </summary>
+    class BoxedValue
+    {
+    private:
+        static constexpr U64 TagMask      = 0xFFFF000000000000ull;
+        static constexpr U64 IdTag        = 0xFFF9000000000000ull;
+        static constexpr U64 ListTag      = 0xFFFA000000000000ull;
+        static constexpr U64 CanonicalNaN = 0x7FF8000000000000ull;
+
+        U64 _bits{0};
+
+        explicit BoxedValue(const U64 bits, int) :
+            _bits(bits) {}
+
+    public:
+        BoxedValue() = default;
+
+        explicit BoxedValue(Math::Real v);
+
+        static BoxedValue id(U32 slot);
+
+        static BoxedValue list(U32 handle);
+
+        /// <summary>
+        /// The value whose bits() are bits.
+        /// </summary>
+        static BoxedValue fromBits(U64 bits);
+
+        bool isList() const;
+        bool isValue() const;
+        bool isId() const;
+        I32  integer() const;
+
+        /// <summary>
+        /// The number for values, or the slot or handle as a number
+        /// for identifiers and lists.
+        /// </summary>
+        Math::Real value() const;
+
+        /// <summary>
+        /// The slot or list handle.
+        /// </summary>
+        U32 index() const;
+
+        U64 bits() const;
+    };
+
+    using BoxedStack = Stack<BoxedValue, AOP_SIMPLE_TYPE>;
+    using BoxedArray = SimpleArray<BoxedValue>;
+
+    static_assert(sizeof(BoxedValue) == 8);
+
+    inline BoxedValue::BoxedValue(const Math::Real v)
+    {
+        if (v != v)
+            _bits = CanonicalNaN;
+        else
+            memcpy(&_bits, &v, sizeof(U64));
+    }
+
+    inline BoxedValue BoxedValue::id(const U32 slot)
+    {
+        return BoxedValue(IdTag | slot, 0);
+    }
+
+    inline BoxedValue BoxedValue::list(const U32 handle)
+    {
+        return BoxedValue(ListTag | handle, 0);
+    }
+
+    inline BoxedValue BoxedValue::fromBits(const U64 bits)
+    {
+        return BoxedValue(bits, 0);
+    }
+
+    inline bool BoxedValue::isList() const
+    {
+        return (_bits & TagMask) == ListTag;
+    }
+
+    inline bool BoxedValue::isId() const
+    {
+        return (_bits & TagMask) == IdTag;
+    }
+
+    inline bool BoxedValue::isValue() const
+    {
+        return !isList() && !isId();
+    }
+
+    inline U32 BoxedValue::index() const
+    {
+        return U32(_bits);
+    }
+
+    inline U64 BoxedValue::bits() const
+    {
+        return _bits;
+    }
+
+    inline Math::Real BoxedValue::value() const
+    {
+        if (!isValue())
+            return Math::Real(index());
+
+        Math::Real v;
+        memcpy(&v, &_bits, sizeof(U64));
+        return v;
+    }
+
+    inline I32 BoxedValue::integer() const
+    {
+        return I32(value());
+    }
+
+}  // namespace Rt2::Eq
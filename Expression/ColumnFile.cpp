@@ -0,0 +1,329 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/ColumnFile.h"
+#include <cstring>
+#include "Expression/ExecutionContext.h"
+#include "Utils/StreamMethods.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define ColumnFile_MMAP 1
+#endif
+
+namespace Rt2::Eq
+{
+    namespace
+    {
+        constexpr char ColumnMagic[8] = {'E', 'Q', 'C', 'O', 'L', 'U', 'M', 'N'};
+
+        size_t alignUp(const size_t value)
+        {
+            return (value + ColumnAlignment - 1) & ~(ColumnAlignment - 1);
+        }
+
+        size_t elementSize(const ColumnType type)
+        {
+            return type == ColumnFloat32 ? sizeof(float) : sizeof(double);
+        }
+    }  // namespace
+
+    ColumnFile::~ColumnFile()
+    {
+        close();
+    }
+
+    bool ColumnFile::fail(const String& message)
+    {
+        _error = _path + ": " + message;
+        release();
+        return false;
+    }
+
+    void ColumnFile::release()
+    {
+#ifdef ColumnFile_MMAP
+        if (_mapped)
+            munmap(_base, _size);
+#endif
+        _buffer.clear();
+        _base     = nullptr;
+        _size     = 0;
+        _mapped   = false;
+        _writable = false;
+        _rows     = 0;
+        _data     = 0;
+        _stride   = 0;
+        _names.clear();
+    }
+
+    U8* ColumnFile::at(const size_t column) const
+    {
+        return _base + _data + column * _stride;
+    }
+
+    bool ColumnFile::readHeader()
+    {
+        if (_size < sizeof(ColumnHeader))
+            return fail("is not a column file");
+
+        ColumnHeader header;
+        std::memcpy(&header, _base, sizeof header);
+        if (std::memcmp(header.magic, ColumnMagic, sizeof ColumnMagic) != 0)
+            return fail("is not a column file");
+        if (header.version != ColumnVersion)
+            return fail("has an unsupported version or byte order");
+        if (header.type > ColumnFloat32)
+            return fail("has an unknown column type");
+        if (header.alignment != ColumnAlignment ||
+            header.data % ColumnAlignment != 0 ||
+            header.stride % ColumnAlignment != 0)
+            return fail("has misaligned columns");
+
+        _type   = (ColumnType)header.type;
+        _rows   = (size_t)header.rows;
+        _data   = (size_t)header.data;
+        _stride = (size_t)header.stride;
+
+        if (_rows > _stride / elementSize(_type) ||
+            _data > _size ||
+            (header.columns > 0 && _stride > (_size - _data) / header.columns))
+            return fail("is truncated");
+
+        size_t offset = sizeof(ColumnHeader);
+        for (U32 i = 0; i < header.columns; ++i)
+        {
+            U32 length;
+            if (offset + sizeof length > _data)
+                return fail("is truncated");
+            std::memcpy(&length, _base + offset, sizeof length);
+            offset += sizeof length;
+
+            if (length > _data - offset)
+                return fail("is truncated");
+            _names.push_back(String((const char*)_base + offset, length));
+            offset += length;
+        }
+        return true;
+    }
+
+    bool ColumnFile::open(const String& path)
+    {
+        close();
+        _path = path;
+        _error.clear();
+
+#ifdef ColumnFile_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return fail("cannot be opened");
+
+        struct stat st
+        {
+        };
+        if (fstat(fd, &st) != 0 || st.st_size <= 0)
+        {
+            ::close(fd);
+            return fail("is not a column file");
+        }
+
+        // private, so that bound programs may write to the columns
+        _size       = (size_t)st.st_size;
+        void* items = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (items == MAP_FAILED)
+            return fail("cannot be mapped");
+
+        _base   = (U8*)items;
+        _mapped = true;
+#else
+        InputFileStream in(path, std::ios::binary);
+        if (!in.is_open())
+            return fail("cannot be opened");
+
+        in.seekg(0, std::ios::end);
+        _size = (size_t)in.tellg();
+        in.seekg(0, std::ios::beg);
+
+        _buffer.resizeFast((_size + sizeof(U64) - 1) / sizeof(U64));
+        _base = (U8*)_buffer.data();
+        in.read((char*)_base, (std::streamsize)_size);
+        if (!in)
+            return fail("cannot be read");
+#endif
+        return readHeader();
+    }
+
+    bool ColumnFile::create(const String&              path,
+                            const SimpleArray<String>& names,
+                            const size_t               rows,
+                            const ColumnType           type)
+    {
+        close();
+        _path = path;
+        _error.clear();
+
+        size_t end = sizeof(ColumnHeader);
+        for (const String& name : names)
+            end += sizeof(U32) + name.size();
+
+        _type   = type;
+        _rows   = rows;
+        _data   = alignUp(end);
+        _stride = alignUp(rows * elementSize(type));
+        _size   = _data + names.size() * _stride;
+
+#ifdef ColumnFile_MMAP
+        const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return fail("cannot be created");
+
+        // the extended file reads as zero
+        if (ftruncate(fd, (off_t)_size) != 0)
+        {
+            ::close(fd);
+            return fail("cannot be resized");
+        }
+
+        void* items = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (items == MAP_FAILED)
+            return fail("cannot be mapped");
+
+        _base   = (U8*)items;
+        _mapped = true;
+#else
+        _buffer.resizeFast((_size + sizeof(U64) - 1) / sizeof(U64));
+        std::memset(_buffer.data(), 0, _buffer.size() * sizeof(U64));
+        _base = (U8*)_buffer.data();
+#endif
+        _writable = true;
+
+        ColumnHeader header{};
+        std::memcpy(header.magic, ColumnMagic, sizeof ColumnMagic);
+        header.version   = ColumnVersion;
+        header.type      = (U32)type;
+        header.rows      = (U64)rows;
+        header.columns   = (U32)names.size();
+        header.alignment = (U32)ColumnAlignment;
+        header.data      = (U64)_data;
+        header.stride    = (U64)_stride;
+        std::memcpy(_base, &header, sizeof header);
+
+        size_t offset = sizeof(ColumnHeader);
+        for (const String& name : names)
+        {
+            const U32 length = (U32)name.size();
+            std::memcpy(_base + offset, &length, sizeof length);
+            offset += sizeof length;
+            std::memcpy(_base + offset, name.data(), length);
+            offset += length;
+            _names.push_back(name);
+        }
+        return true;
+    }
+
+    bool ColumnFile::flush()
+    {
+        if (!_writable)
+            return true;
+
+#ifdef ColumnFile_MMAP
+        if (msync(_base, _size, MS_SYNC) != 0)
+            return fail("cannot be written");
+#else
+        OutputFileStream out(_path, std::ios::binary);
+        out.write((const char*)_base, (std::streamsize)_size);
+        if (!out)
+            return fail("cannot be written");
+#endif
+        return true;
+    }
+
+    bool ColumnFile::close()
+    {
+        if (_base == nullptr)
+            return true;
+
+        bool result = true;
+#ifndef ColumnFile_MMAP
+        // unmapping a shared mapping already leaves the
+        // values in the file, a buffer has to be written
+        result = flush();
+#endif
+        release();
+        return result;
+    }
+
+    size_t ColumnFile::find(const String& name) const
+    {
+        for (size_t i = 0; i < _names.size(); ++i)
+        {
+            if (_names[i] == name)
+                return i;
+        }
+        return Npos;
+    }
+
+    Math::Real* ColumnFile::column(const size_t column) const
+    {
+        if (_type != ColumnFloat64 || column >= _names.size())
+            return nullptr;
+        return (Math::Real*)at(column);
+    }
+
+    float* ColumnFile::columnF(const size_t column) const
+    {
+        if (_type != ColumnFloat32 || column >= _names.size())
+            return nullptr;
+        return (float*)at(column);
+    }
+
+    bool ColumnFile::bind(ExecutionContext& context)
+    {
+        const Precision precision = context.program().precision();
+        if ((_type == ColumnFloat32) != (precision == PrecisionFloat32))
+        {
+            _error = _path + ": the column type does not match the program's precision";
+            return false;
+        }
+
+        for (size_t i = 0; i < _names.size(); ++i)
+        {
+            const VInt slot = context.indexOf(_names[i]);
+            if (_type == ColumnFloat32)
+                context.bind(slot, StridedViewF::column(columnF(i)));
+            else
+                context.bind(slot, StridedView::column(column(i)));
+        }
+        return true;
+    }
+
+    void ColumnFile::unbind(ExecutionContext& context) const
+    {
+        for (const String& name : _names)
+            context.unbind(context.indexOf(name));
+    }
+
+}  // namespace Rt2::Eq
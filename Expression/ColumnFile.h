@@ -0,0 +1,201 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Expression/Program.h"
+#include "Expression/StridedView.h"
+
+namespace Rt2::Eq
+{
+    class ExecutionContext;
+
+    enum ColumnType
+    {
+        ColumnFloat64,
+        ColumnFloat32,
+    };
+
+    /// <summary>
+    /// Fixed part of a column file. All fields are in the byte order of
+    /// the machine that wrote the file; a file from the other order fails
+    /// the version check.
+    ///
+    /// The header is followed by the column names, each a U32 length and
+    /// that many bytes, and then by the columns. Column i holds rows values
+    /// of the file's type and starts at data + i * stride. Both are
+    /// multiples of ColumnAlignment, so every column can be handed to the
+    /// batch evaluator where it lies.
+    /// </summary>
+    struct ColumnHeader
+    {
+        char magic[8];
+        U32  version;
+        U32  type;
+        U64  rows;
+        U32  columns;
+        U32  alignment;
+        U64  data;
+        U64  stride;
+    };
+
+    constexpr U32    ColumnVersion   = 1;
+    constexpr size_t ColumnAlignment = 64;
+
+    /// <summary>
+    /// Maps a column file into memory. Opened files are mapped copy on
+    /// write, so binding their columns to a program that assigns to one
+    /// of the variables never changes the file. Created files are mapped
+    /// shared, so values written to their columns, by the caller or by
+    /// bound programs, are the contents of the file.
+    /// Where memory mapping is not available the file is read into and
+    /// written from a buffer instead.
+    /// </summary>
+    class ColumnFile
+    {
+    private:
+        String              _path;
+        U8*                 _base{nullptr};
+        size_t              _size{0};
+        bool                _mapped{false};
+        bool                _writable{false};
+        SimpleArray<U64>    _buffer;
+        ColumnType          _type{ColumnFloat64};
+        size_t              _rows{0};
+        SimpleArray<String> _names;
+        size_t              _data{0};
+        size_t              _stride{0};
+        String              _error;
+
+        bool fail(const String& message);
+
+        bool readHeader();
+
+        void release();
+
+        U8* at(size_t column) const;
+
+    public:
+        ColumnFile() = default;
+        ~ColumnFile();
+
+        ColumnFile(const ColumnFile&)            = delete;
+        ColumnFile& operator=(const ColumnFile&) = delete;
+
+        /// <summary>
+        /// Maps an existing file. Returns false and describes the
+        /// failure with error when it can not be read or is not
+        /// a column file.
+        /// </summary>
+        bool open(const String& path);
+
+        /// <summary>
+        /// Creates, or truncates, a file with one column per name and
+        /// maps it. The columns read as zero until they are written.
+        /// </summary>
+        bool create(const String&              path,
+                    const SimpleArray<String>& names,
+                    size_t                     rows,
+                    ColumnType                 type = ColumnFloat64);
+
+        /// <summary>
+        /// Writes the columns of a created file back to disk.
+        /// </summary>
+        bool flush();
+
+        /// <summary>
+        /// Flushes a created file and releases the mapping. Column
+        /// pointers and bindings into the file are invalid afterwards.
+        /// </summary>
+        bool close();
+
+        bool isOpen() const;
+
+        ColumnType type() const;
+
+        size_t rows() const;
+
+        size_t columns() const;
+
+        const String& name(size_t column) const;
+
+        /// <summary>
+        /// The index of the named column, or Npos.
+        /// </summary>
+        size_t find(const String& name) const;
+
+        /// <summary>
+        /// The values of a ColumnFloat64 column, or null.
+        /// </summary>
+        Math::Real* column(size_t column) const;
+
+        /// <summary>
+        /// The values of a ColumnFloat32 column, or null.
+        /// </summary>
+        float* columnF(size_t column) const;
+
+        /// <summary>
+        /// Binds every column that names a variable of the context's
+        /// program to that variable. The file's type must match the
+        /// program's precision. Binding an output file after the input
+        /// file makes the variables that the program assigns land in
+        /// the output's columns.
+        /// </summary>
+        bool bind(ExecutionContext& context);
+
+        /// <summary>
+        /// Releases the bindings made by bind.
+        /// </summary>
+        void unbind(ExecutionContext& context) const;
+
+        const String& error() const;
+    };
+
+    inline bool ColumnFile::isOpen() const
+    {
+        return _base != nullptr;
+    }
+
+    inline ColumnType ColumnFile::type() const
+    {
+        return _type;
+    }
+
+    inline size_t ColumnFile::rows() const
+    {
+        return _rows;
+    }
+
+    inline size_t ColumnFile::columns() const
+    {
+        return _names.size();
+    }
+
+    inline const String& ColumnFile::name(const size_t column) const
+    {
+        return _names.at(column);
+    }
+
+    inline const String& ColumnFile::error() const
+    {
+        return _error;
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,287 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/CorpusGenerator.h"
+#include "Utils/StreamMethods.h"
+
+namespace Rt2::Eq
+{
+    namespace
+    {
+        const char* const Unary[]  = {"sin", "cos", "sqrt", "abs", "exp", "log", "tanh", "floor"};
+        const char* const Binary[] = {"atan2", "pow", "fmod"};
+        const char* const Varying[] = {"min", "max", "sum", "mean"};
+        const char* const Reduce[] = {"sum", "mean", "norm"};
+
+        constexpr U32 UnaryCount   = sizeof Unary / sizeof Unary[0];
+        constexpr U32 BinaryCount  = sizeof Binary / sizeof Binary[0];
+        constexpr U32 VaryingCount = sizeof Varying / sizeof Varying[0];
+        constexpr U32 ReduceCount  = sizeof Reduce / sizeof Reduce[0];
+
+        bool isOperator(const char c)
+        {
+            switch (c)
+            {
+            case '+':
+            case '-':
+            case '*':
+            case '/':
+            case '%':
+            case '^':
+            case '<':
+            case '>':
+            case '=':
+            case '!':
+            case '&':
+            case '|':
+            case '?':
+                return true;
+            default:
+                return false;
+            }
+        }
+    }  // namespace
+
+    CorpusGenerator::CorpusGenerator(const CorpusOptions& options) :
+        _options(options)
+    {
+        for (const char c : _options.operators)
+        {
+            if (isOperator(c))
+                _operators.push_back(c);
+        }
+        if (_operators.empty())
+            _operators = "+";
+        if (_options.variables == 0)
+            _options.variables = 1;
+        if (_options.listSize == 0)
+            _options.listSize = 1;
+    }
+
+    String CorpusGenerator::input(const U32 n)
+    {
+        return "x" + std::to_string(n);
+    }
+
+    U64 CorpusGenerator::next()
+    {
+        // SplitMix64, which unlike the standard distributions
+        // gives the same sequence with every library.
+        U64 z = _state += 0x9E3779B97F4A7C15ull;
+        z     = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z     = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    U32 CorpusGenerator::below(const U32 range)
+    {
+        return range > 0 ? U32(next() % range) : 0;
+    }
+
+    bool CorpusGenerator::chance(const double p)
+    {
+        return double(next() >> 11) * (1.0 / 9007199254740992.0) < p;
+    }
+
+    void CorpusGenerator::operand(OStream& out, const U32 depth)
+    {
+        if (depth > 0 && chance(_options.calls))
+        {
+            call(out, depth);
+            return;
+        }
+
+        switch (below(4))
+        {
+        case 0:
+            out << below(1000) << '.' << below(100);
+            break;
+        case 1:
+            if (_statement > 0)
+            {
+                out << 'v' << below(_statement);
+                break;
+            }
+            [[fallthrough]];
+        default:
+            out << input(below(_options.variables));
+            break;
+        }
+    }
+
+    void CorpusGenerator::call(OStream& out, const U32 depth)
+    {
+        const U32 user = _options.functions;
+        U32       pick = below(UnaryCount + BinaryCount + VaryingCount + user + (_lists > 0));
+
+        if (pick < UnaryCount)
+        {
+            out << Unary[pick] << '(';
+            expression(out, depth - 1, false);
+            out << ')';
+            return;
+        }
+        pick -= UnaryCount;
+
+        U32 args;
+        if (pick < BinaryCount)
+        {
+            out << Binary[pick];
+            args = 2;
+        }
+        else if ((pick -= BinaryCount) < VaryingCount)
+        {
+            out << Varying[pick];
+            args = 2 + below(3);
+        }
+        else if ((pick -= VaryingCount) < user)
+        {
+            // f<n> takes n % 3 + 1 parameters, as write defines them
+            out << 'f' << pick;
+            args = pick % 3 + 1;
+        }
+        else
+        {
+            out << Reduce[below(ReduceCount)] << "(l" << below(_lists) << ')';
+            return;
+        }
+
+        out << '(';
+        for (U32 i = 0; i < args; ++i)
+        {
+            if (i > 0)
+                out << ", ";
+            expression(out, depth - 1, false);
+        }
+        out << ')';
+    }
+
+    void CorpusGenerator::expression(OStream& out, const U32 depth, const bool nested)
+    {
+        // Leaves are likelier near the root too, so that trees
+        // vary in shape rather than always being full.
+        if (depth == 0 || chance(0.25))
+        {
+            operand(out, depth);
+            return;
+        }
+
+        const char op = _operators[below((U32)_operators.size())];
+
+        // Comparisons and logic do not chain, and conditionals bind
+        // loosest, so every operator but the root one is grouped.
+        if (nested)
+            out << '(';
+
+        expression(out, depth - 1, true);
+        switch (op)
+        {
+        case '?':
+            out << " < ";
+            expression(out, depth - 1, true);
+            out << " ? ";
+            expression(out, depth - 1, true);
+            out << " : ";
+            break;
+        case '=':
+            out << " == ";
+            break;
+        case '!':
+            out << " != ";
+            break;
+        case '&':
+            out << " && ";
+            break;
+        case '|':
+            out << " || ";
+            break;
+        case '*':
+        case '/':
+        case '^':
+            out << op;
+            break;
+        default:
+            out << ' ' << op << ' ';
+            break;
+        }
+        expression(out, depth - 1, true);
+
+        if (nested)
+            out << ')';
+    }
+
+    void CorpusGenerator::write(OStream& out)
+    {
+        _state     = _options.seed;
+        _statement = 0;
+        _lists     = 0;
+
+        out << "# generated, seed " << _options.seed << '\n';
+
+        for (U32 f = 0; f < _options.functions; ++f)
+        {
+            const U32 params = f % 3 + 1;
+
+            out << 'f' << f << '(';
+            for (U32 p = 0; p < params; ++p)
+                out << (p > 0 ? ", " : "") << 'p' << p;
+            out << ") = ";
+
+            // the body uses each of its parameters
+            for (U32 p = 0; p < params; ++p)
+            {
+                if (p > 0)
+                    out << (p % 2 ? " * " : " + ");
+                out << 'p' << p;
+            }
+            out << " + " << below(100) << '.' << below(100) << '\n';
+        }
+
+        for (U32 s = 0; s < _options.statements; ++s)
+        {
+            if (chance(_options.lists))
+            {
+                out << 'l' << _lists++ << " = {";
+                for (U32 i = 0; i < _options.listSize; ++i)
+                {
+                    if (i > 0)
+                        out << ", ";
+                    operand(out, 0);
+                }
+                out << "}\n";
+                continue;
+            }
+
+            out << 'v' << _statement << " = ";
+            expression(out, _options.depth, false);
+            out << '\n';
+            ++_statement;
+        }
+    }
+
+    String CorpusGenerator::generate()
+    {
+        OutputStringStream out;
+        write(out);
+        return out.str();
+    }
+
+}  // namespace Rt2::Eq
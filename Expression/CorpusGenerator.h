@@ -0,0 +1,111 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Utils/Definitions.h"
+#include "Utils/String.h"
+
+namespace Rt2::Eq
+{
+    /// <summary>
+    /// Shape of a generated source.
+    /// </summary>
+    struct CorpusOptions
+    {
+        // The same seed and options always produce the same source.
+        U64 seed{1};
+
+        // Number of top-level assignments, v0, v1, ...
+        U32 statements{100};
+
+        // Number of input variables, x0, x1, ..., that the
+        // statements read along with the earlier statements.
+        U32 variables{8};
+
+        // Maximum depth of an expression tree. The parser bounds the
+        // rules it applies per statement, so sources much deeper
+        // than the default need a StatementParser with a larger
+        // maxDepth.
+        U32 depth{4};
+
+        // The binary operators to draw from, where repeating a
+        // character weights it. '=', '!', '&' and '|' stand for
+        // '==', '!=', '&&' and '||', and '?' for a conditional.
+        String operators{"+-*/"};
+
+        // Probability that an operand is a function call.
+        double calls{0.2};
+
+        // Probability that a statement assigns a list literal
+        // instead, which later statements reduce with sum, mean
+        // or norm.
+        double lists{0};
+
+        // Elements per list literal.
+        U32 listSize{4};
+
+        // Number of user functions defined ahead of the statements,
+        // f0, f1, ..., which then take part in the calls.
+        U32 functions{0};
+    };
+
+    /// <summary>
+    /// Writes deterministic, random sources in the grammar of
+    /// StatementParser, for benchmarks and scale tests. The output
+    /// parses, and executes without errors when every input
+    /// variable is set; the values are not meaningful and may
+    /// be NaN or infinite.
+    /// </summary>
+    class CorpusGenerator
+    {
+    private:
+        CorpusOptions _options;
+        U64           _state{0};
+        U32           _statement{0};
+        U32           _lists{0};
+        String        _operators;
+
+        U64 next();
+
+        U32 below(U32 range);
+
+        bool chance(double p);
+
+        void operand(OStream& out, U32 depth);
+
+        void call(OStream& out, U32 depth);
+
+        void expression(OStream& out, U32 depth, bool nested);
+
+    public:
+        explicit CorpusGenerator(const CorpusOptions& options);
+
+        void write(OStream& out);
+
+        String generate();
+
+        /// <summary>
+        /// The name of the nth input variable.
+        /// </summary>
+        static String input(U32 n);
+    };
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,698 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/CsvPipeline.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <thread>
+#include "Expression/ExecutionContext.h"
+
+namespace Rt2::Eq
+{
+    /// <summary>
+    /// Blocking FIFO of blocks between two pipeline threads.
+    /// </summary>
+    class CsvQueue
+    {
+    private:
+        std::mutex              _lock;
+        std::condition_variable _ready;
+        std::deque<void*>       _items;
+        bool                    _closed{false};
+        bool                    _aborted{false};
+
+    public:
+        void push(void* item)
+        {
+            {
+                std::lock_guard guard(_lock);
+                _items.push_back(item);
+            }
+            _ready.notify_one();
+        }
+
+        /// <summary>
+        /// Waits for the next item. Returns null once the queue is
+        /// closed and drained, or as soon as it is aborted.
+        /// </summary>
+        void* pop()
+        {
+            std::unique_lock guard(_lock);
+            _ready.wait(guard, [this]
+                        { return _aborted || _closed || !_items.empty(); });
+            if (_aborted || _items.empty())
+                return nullptr;
+
+            void* item = _items.front();
+            _items.pop_front();
+            return item;
+        }
+
+        void close()
+        {
+            {
+                std::lock_guard guard(_lock);
+                _closed = true;
+            }
+            _ready.notify_all();
+        }
+
+        void abort()
+        {
+            {
+                std::lock_guard guard(_lock);
+                _aborted = true;
+            }
+            _ready.notify_all();
+        }
+    };
+
+    namespace
+    {
+        bool isBlank(const char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        void trim(const char*& first, const char*& last)
+        {
+            while (first < last && isBlank(*first))
+                ++first;
+            while (last > first && isBlank(last[-1]))
+                --last;
+        }
+
+        /// <summary>
+        /// Formats the rows as delimited text.
+        /// </summary>
+        class CsvText final : public CsvSink
+        {
+        private:
+            OStream&   _out;
+            const char _delimiter;
+            size_t     _columns{0};
+            String     _text;
+
+        public:
+            CsvText(OStream& out, const char delimiter) :
+                _out(out),
+                _delimiter(delimiter)
+            {
+            }
+
+            bool begin(const SimpleArray<String>& names) override
+            {
+                _columns = names.size();
+                for (size_t i = 0; i < names.size(); ++i)
+                {
+                    if (i > 0)
+                        _out << _delimiter;
+                    _out << names[i];
+                }
+                _out << '\n';
+                return check();
+            }
+
+            bool write(const Math::Real* const* columns, const size_t rows) override
+            {
+                // formatted while the evaluate thread works on the next
+                // block and the parse thread fills the one after
+                char number[32];
+                _text.resize(0);
+                for (size_t r = 0; r < rows; ++r)
+                {
+                    for (size_t i = 0; i < _columns; ++i)
+                    {
+                        if (i > 0)
+                            _text.push_back(_delimiter);
+
+                        const auto res = std::to_chars(number, number + sizeof number, columns[i][r]);
+                        _text.append(number, res.ptr);
+                    }
+                    _text.push_back('\n');
+                }
+                _out.write(_text.data(), (std::streamsize)_text.size());
+                return check();
+            }
+
+            bool end() override
+            {
+                _out.flush();
+                return check();
+            }
+
+            bool check()
+            {
+                if (!_out)
+                    error = "failed to write the output";
+                return (bool)_out;
+            }
+        };
+    }  // namespace
+
+    CsvPipeline::CsvPipeline(const CsvOptions& options) :
+        _options(options)
+    {
+        _options.blockRows = std::max<size_t>(_options.blockRows, 1);
+        _options.readSize  = std::max<size_t>(_options.readSize, 64);
+        _options.blocks    = std::max<size_t>(_options.blocks, 2);
+        _options.threads   = std::max<size_t>(_options.threads, 1);
+    }
+
+    CsvPipeline::~CsvPipeline()
+    {
+        for (const Stage& stage : _stages)
+        {
+            for (const ExecutionContext* ctx : stage.contexts)
+                delete ctx;
+        }
+        release();
+    }
+
+    void CsvPipeline::release()
+    {
+        for (const Block* block : _pool)
+            delete block;
+        _pool.resizeFast(0);
+    }
+
+    void CsvPipeline::add(ProgramPtr program, const String& result)
+    {
+        Stage stage;
+        for (size_t t = 0; t < _options.threads; ++t)
+            stage.contexts.push_back(new ExecutionContext(program));
+        stage.result = result;
+        _stages.push_back(stage);
+    }
+
+    void CsvPipeline::output(const String& name)
+    {
+        _outputs.push_back(name);
+    }
+
+    void CsvPipeline::set(const String& name, const Math::Real value)
+    {
+        for (const Stage& stage : _stages)
+        {
+            for (ExecutionContext* ctx : stage.contexts)
+                ctx->set(name, value);
+        }
+    }
+
+    void CsvPipeline::fail(const String& message)
+    {
+        {
+            std::lock_guard guard(_errorLock);
+            if (_failed)
+                return;
+            _error  = message;
+            _failed = true;
+        }
+        for (CsvQueue* queue : _queues)
+        {
+            if (queue)
+                queue->abort();
+        }
+    }
+
+    Math::Real* CsvPipeline::column(Block& block, const size_t index) const
+    {
+        return block.values.data() + index * _options.blockRows;
+    }
+
+    float* CsvPipeline::columnF(const size_t index)
+    {
+        return _floats.data() + index * _options.blockRows;
+    }
+
+    bool CsvPipeline::readHeader(IStream& in, String& rest)
+    {
+        String text;
+        size_t end = String::npos;
+        while (end == String::npos)
+        {
+            const size_t size = text.size();
+            text.resize(size + 4096);
+            in.read(text.data() + size, 4096);
+            text.resize(size + (size_t)in.gcount());
+
+            end = text.find('\n');
+            if (end == String::npos && in.gcount() == 0)
+            {
+                end = text.size();
+                break;
+            }
+        }
+
+        rest  = end < text.size() ? text.substr(end + 1) : String();
+        _line = 1;
+
+        if (end == 0 && text.empty())
+        {
+            fail("the input is empty");
+            return false;
+        }
+
+        const char* p    = text.data();
+        const char* last = text.data() + end;
+        while (p <= last)
+        {
+            const char* next = std::find(p, last, _options.delimiter);
+
+            const char* a = p;
+            const char* b = next;
+            trim(a, b);
+            if (b - a >= 2 && *a == '"' && b[-1] == '"')
+            {
+                ++a;
+                --b;
+            }
+            if (a == b)
+            {
+                fail("the header has an empty column name");
+                return false;
+            }
+            _columns.push_back(String(a, b));
+            p = next + 1;
+        }
+        return true;
+    }
+
+    void CsvPipeline::layout()
+    {
+        _inputs = _columns.size();
+
+        const auto find = [this](const String& name)
+        {
+            for (size_t i = 0; i < _columns.size(); ++i)
+            {
+                if (_columns[i] == name)
+                    return i;
+            }
+            return Npos;
+        };
+
+        _written.resizeFast(0);
+        if (_options.passThrough)
+        {
+            for (size_t i = 0; i < _inputs; ++i)
+                _written.push_back((U32)i);
+        }
+
+        for (const String& name : _outputs)
+        {
+            size_t idx = find(name);
+            if (idx == Npos)
+            {
+                idx = _columns.size();
+                _columns.push_back(name);
+            }
+            if (!_options.passThrough || idx >= _inputs)
+                _written.push_back((U32)idx);
+        }
+
+        // Variables assigned by a program get a column too, written or
+        // not, so that the programs after it read the assigned values.
+        for (size_t s = 0; s + 1 < _stages.size(); ++s)
+        {
+            const Program& program = _stages[s].contexts[0]->program();
+            for (size_t i = 0; i < program.graph().size(); ++i)
+            {
+                for (const U32 slot : program.graph().writes(i))
+                {
+                    const String& name = program.slots().name(slot);
+                    if (find(name) == Npos)
+                        _columns.push_back(name);
+                }
+            }
+        }
+
+        // results are not variables, so they are never bound
+        _variables = _columns.size();
+        for (Stage& stage : _stages)
+        {
+            stage.column = Npos;
+            if (!stage.result.empty())
+            {
+                stage.column = _columns.size();
+                _written.push_back((U32)_columns.size());
+                _columns.push_back(stage.result);
+            }
+
+            // the columns that a float program copies back
+            const Program& program = stage.contexts[0]->program();
+            stage.slots.resizeFast(0);
+            stage.assigned.resizeFast(0);
+            for (size_t c = 0; c < _variables; ++c)
+            {
+                const VInt slot = program.indexOf(_columns[c]);
+                stage.slots.push_back(slot);
+
+                bool assigned = false;
+                for (size_t i = 0; i < program.graph().size(); ++i)
+                {
+                    for (const U32 write : program.graph().writes(i))
+                        assigned = assigned || (slot != Npos && write == slot);
+                }
+                if (assigned)
+                    stage.assigned.push_back((U32)c);
+            }
+        }
+    }
+
+    bool CsvPipeline::parseLine(const char* first, const char* last, Block& block)
+    {
+        const size_t row = block.rows;
+
+        const char* p = first;
+        for (size_t c = 0; c < _inputs; ++c)
+        {
+            if (p > last)
+            {
+                fail("line " + std::to_string(_line) + " has " + std::to_string(c) +
+                     " fields, expected " + std::to_string(_inputs));
+                return false;
+            }
+
+            const char* next = std::find(p, last, _options.delimiter);
+            const char* a    = p;
+            const char* b    = next;
+            trim(a, b);
+
+            Math::Real value = Math::Real(NAN);
+            if (a < b)
+            {
+                if (*a == '+')
+                    ++a;
+                if (const auto [ptr, ec] = std::from_chars(a, b, value);
+                    ec != std::errc() || ptr != b)
+                {
+                    fail("line " + std::to_string(_line) + ", column '" + _columns[c] +
+                         "': '" + String(a, b) + "' is not a number");
+                    return false;
+                }
+            }
+            column(block, c)[row] = value;
+            p = next + 1;
+        }
+
+        if (p <= last)
+        {
+            fail("line " + std::to_string(_line) + " has more than " +
+                 std::to_string(_inputs) + " fields");
+            return false;
+        }
+
+        // outputs that no program assigns read as NaN
+        for (size_t c = _inputs; c < _columns.size(); ++c)
+            column(block, c)[row] = Math::Real(NAN);
+
+        block.rows++;
+        return true;
+    }
+
+    void CsvPipeline::parse(IStream& in, String rest, CsvQueue& free, CsvQueue& parsed)
+    {
+        Block* block = nullptr;
+        size_t row   = 0;
+
+        const auto line = [&](const char* first, const char* last)
+        {
+            ++_line;
+            const char* a = first;
+            const char* b = last;
+            trim(a, b);
+            if (a == b)
+                return true;
+
+            if (block == nullptr)
+            {
+                if ((block = (Block*)free.pop()) == nullptr)
+                    return false;
+                block->rows  = 0;
+                block->first = row;
+            }
+            if (!parseLine(first, last, *block))
+                return false;
+
+            ++row;
+            if (block->rows == _options.blockRows)
+            {
+                parsed.push(block);
+                block = nullptr;
+            }
+            return true;
+        };
+
+        // The chunk holds the unfinished line of the previous read
+        // followed by the next read. Only that tail is ever copied.
+        size_t size = rest.size();
+        _chunk.resizeFast(std::max(size, _options.readSize));
+        std::memcpy(_chunk.data(), rest.data(), size);
+
+        bool ok = true;
+        while (ok && !_failed)
+        {
+            _chunk.resizeFast(size + _options.readSize);
+            in.read(_chunk.data() + size, (std::streamsize)_options.readSize);
+            const size_t read = (size_t)in.gcount();
+            size += read;
+
+            const char* p   = _chunk.data();
+            const char* end = _chunk.data() + size;
+            while (ok)
+            {
+                const char* nl = (const char*)std::memchr(p, '\n', size_t(end - p));
+                if (nl == nullptr)
+                    break;
+                ok = line(p, nl);
+                p  = nl + 1;
+            }
+
+            if (read == 0)
+            {
+                if (ok && p < end)
+                    ok = line(p, end);
+                break;
+            }
+
+            size = size_t(end - p);
+            std::memmove(_chunk.data(), p, size);
+        }
+
+        if (ok && !_failed && in.bad())
+            fail("failed to read the input");
+
+        if (block != nullptr && block->rows > 0)
+            parsed.push(block);
+        parsed.close();
+    }
+
+    bool CsvPipeline::evaluate(Block& block, const size_t thread, const size_t first, const size_t rows)
+    {
+        for (const Stage& stage : _stages)
+        {
+            ExecutionContext* ctx = stage.contexts[thread];
+
+            bool ok;
+            if (ctx->program().precision() == PrecisionFloat32)
+            {
+                for (size_t c = 0; c < _variables; ++c)
+                {
+                    if (stage.slots[c] == Npos)
+                        continue;
+                    const Math::Real* src  = column(block, c) + first;
+                    float*            dest = columnF(c) + first;
+                    for (size_t r = 0; r < rows; ++r)
+                        dest[r] = (float)src[r];
+                    ctx->bind(stage.slots[c], StridedViewF::column(dest));
+                }
+
+                float* dest = stage.column != Npos ? columnF(stage.column) + first : nullptr;
+                ok          = ctx->executeBatch(rows, dest);
+
+                for (const U32 c : stage.assigned)
+                    std::copy_n(columnF(c) + first, rows, column(block, c) + first);
+                if (dest)
+                    std::copy_n(dest, rows, column(block, stage.column) + first);
+            }
+            else
+            {
+                for (size_t c = 0; c < _variables; ++c)
+                    ctx->bind(stage.slots[c], StridedView::column(column(block, c) + first));
+
+                Math::Real* dest = stage.column != Npos ? column(block, stage.column) + first : nullptr;
+                ok               = ctx->executeBatch(rows, dest);
+            }
+
+            if (!ok)
+            {
+                fail("rows " + std::to_string(block.first + first + 1) + " to " +
+                     std::to_string(block.first + first + rows) + ": " +
+                     ctx->status().message());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void CsvPipeline::evaluate(CsvQueue& parsed, CsvQueue& evaluated)
+    {
+        while (Block* block = (Block*)parsed.pop())
+        {
+            // Small blocks are not worth a thread each.
+            const size_t rows    = block->rows;
+            const size_t threads = std::min(_options.threads, std::max<size_t>(rows / 1024, 1));
+            const size_t per     = (rows + threads - 1) / threads;
+
+            if (threads == 1)
+                evaluate(*block, 0, 0, rows);
+            else
+            {
+                // Stages run back to back on each thread's rows, since
+                // a row only reads what earlier stages wrote to it.
+                std::unique_ptr<std::thread[]> workers(new std::thread[threads]);
+                for (size_t t = 0; t < threads; ++t)
+                {
+                    const size_t first = t * per;
+                    const size_t count = first < rows ? std::min(per, rows - first) : 0;
+                    workers[t]         = std::thread([this, block, t, first, count]
+                                             {
+                                                 if (count > 0)
+                                                     evaluate(*block, t, first, count);
+                                             });
+                }
+                for (size_t t = 0; t < threads; ++t)
+                    workers[t].join();
+            }
+            evaluated.push(block);
+        }
+        evaluated.close();
+    }
+
+    void CsvPipeline::write(CsvSink& sink, CsvQueue& evaluated, CsvQueue& free)
+    {
+        SimpleArray<const Math::Real*> columns;
+        columns.resizeFast(_written.size());
+
+        while (Block* block = (Block*)evaluated.pop())
+        {
+            for (size_t i = 0; i < _written.size(); ++i)
+                columns[i] = column(*block, _written[i]);
+
+            const bool ok = sink.write(columns.data(), block->rows);
+            _rows += block->rows;
+            free.push(block);
+
+            if (!ok)
+            {
+                fail(sink.error);
+                break;
+            }
+        }
+    }
+
+    bool CsvPipeline::run(IStream& in, OStream& out)
+    {
+        CsvText sink(out, _options.delimiter);
+        return run(in, sink);
+    }
+
+    bool CsvPipeline::run(IStream& in, CsvSink& sink)
+    {
+        _rows   = 0;
+        _failed = false;
+        _error.clear();
+        _columns.resizeFast(0);
+
+        if (_stages.empty())
+        {
+            fail("no program to evaluate");
+            return false;
+        }
+
+        String rest;
+        if (!readHeader(in, rest))
+            return false;
+        layout();
+
+        SimpleArray<String> names;
+        for (const U32 c : _written)
+            names.push_back(_columns[c]);
+        if (!sink.begin(names))
+        {
+            fail(sink.error);
+            return false;
+        }
+
+        const size_t values = _columns.size() * _options.blockRows;
+        _floats.resizeFast(0);
+        for (const Stage& stage : _stages)
+        {
+            if (stage.contexts[0]->program().precision() == PrecisionFloat32)
+                _floats.resizeFast(values);
+        }
+        while (_pool.size() < _options.blocks)
+            _pool.push_back(new Block);
+
+        CsvQueue free, parsed, evaluated;
+        for (Block* block : _pool)
+        {
+            block->values.resizeFast(values);
+            free.push(block);
+        }
+
+        _queues[0] = &free;
+        _queues[1] = &parsed;
+        _queues[2] = &evaluated;
+
+        std::thread parser([&]
+                           { parse(in, rest, free, parsed); });
+        std::thread evaluator([&]
+                              { evaluate(parsed, evaluated); });
+        write(sink, evaluated, free);
+
+        parser.join();
+        evaluator.join();
+
+        _queues[0] = _queues[1] = _queues[2] = nullptr;
+
+        // the bindings point into the blocks
+        for (const Stage& stage : _stages)
+        {
+            for (ExecutionContext* ctx : stage.contexts)
+            {
+                for (const VInt slot : stage.slots)
+                    ctx->unbind(slot);
+            }
+        }
+
+        if (!_failed && !sink.end())
+            fail(sink.error);
+        return !_failed;
+    }
+
+}  // namespace Rt2::Eq
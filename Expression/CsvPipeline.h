@@ -0,0 +1,213 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include <atomic>
+#include <mutex>
+#include "Expression/Program.h"
+
+namespace Rt2::Eq
+{
+    class ExecutionContext;
+    class CsvQueue;
+
+    struct CsvOptions
+    {
+        char delimiter{','};
+
+        // Rows per block. Blocks are the unit that moves between
+        // the parse, evaluate and write threads.
+        size_t blockRows{8192};
+
+        // Bytes requested from the input stream per read.
+        size_t readSize{size_t(1) << 20};
+
+        // Number of blocks in flight. Memory use is bounded by
+        // blocks * blockRows * columns values, whatever the input
+        // size. Three keeps every stage busy.
+        size_t blocks{3};
+
+        // Writes the input columns ahead of the outputs.
+        bool passThrough{false};
+
+        // Threads that the evaluate stage splits each block across.
+        size_t threads{1};
+    };
+
+    /// <summary>
+    /// Receives the written columns of a CsvPipeline run in place of
+    /// CSV text. Calls are made on the thread that called run. A call
+    /// that returns false sets error, which stops the run.
+    /// </summary>
+    class CsvSink
+    {
+    public:
+        virtual ~CsvSink() = default;
+
+        String error;
+
+        /// <summary>
+        /// Called once, before any rows, with the names of the columns.
+        /// </summary>
+        virtual bool begin(const SimpleArray<String>& names) = 0;
+
+        /// <summary>
+        /// Called per block in row order; columns[i] holds the rows
+        /// values of the i-th named column.
+        /// </summary>
+        virtual bool write(const Math::Real* const* columns, size_t rows) = 0;
+
+        /// <summary>
+        /// Called after the last block of a run that did not fail.
+        /// </summary>
+        virtual bool end() = 0;
+    };
+
+    /// <summary>
+    /// One row per line, one column per variable. The first line names
+    /// the columns. Fields are numbers; empty fields read as NaN.
+    ///
+    /// The pipeline evaluates its programs, in the order they were
+    /// added, over each row of a CSV stream and writes the requested
+    /// columns. A parse thread reads the input in large chunks and
+    /// parses it into blocks of columns, an evaluate thread runs each
+    /// block through the batch evaluator, and the calling thread
+    /// formats and writes the finished blocks, so that the three
+    /// overlap. Every column, and every variable that a program
+    /// assigns, is bound by name in every program, which lets a
+    /// program read the variables that an earlier one assigned.
+    /// PrecisionFloat32 programs run on a float copy of the columns
+    /// that they read and assign.
+    /// </summary>
+    class CsvPipeline
+    {
+    private:
+        struct Stage
+        {
+            String                         result;
+            size_t                         column{Npos};
+            SimpleArray<ExecutionContext*> contexts;
+            SimpleArray<VInt>              slots;
+            SimpleArray<U32>               assigned;
+        };
+
+        struct Block
+        {
+            SimpleArray<Math::Real> values;
+            size_t                  rows{0};
+            size_t                  first{0};
+        };
+
+        CsvOptions          _options;
+        SimpleArray<Stage>  _stages;
+        SimpleArray<String> _outputs;
+        SimpleArray<String> _columns;
+        SimpleArray<U32>    _written;
+        SimpleArray<Block*> _pool;
+        size_t              _inputs{0};
+        size_t              _variables{0};
+        CsvQueue*           _queues[3]{};
+        size_t              _rows{0};
+        std::atomic<bool>   _failed{false};
+        String              _error;
+        std::mutex          _errorLock;
+        SimpleArray<char>   _chunk;
+        SimpleArray<float>  _floats;
+        size_t              _line{0};
+
+        void fail(const String& message);
+
+        bool readHeader(IStream& in, String& rest);
+
+        void layout();
+
+        bool parseLine(const char* first, const char* last, Block& block);
+
+        void parse(IStream& in, String rest, CsvQueue& free, CsvQueue& parsed);
+
+        bool evaluate(Block& block, size_t thread, size_t first, size_t rows);
+
+        void evaluate(CsvQueue& parsed, CsvQueue& evaluated);
+
+        void write(CsvSink& sink, CsvQueue& evaluated, CsvQueue& free);
+
+        Math::Real* column(Block& block, size_t index) const;
+
+        float* columnF(size_t index);
+
+        void release();
+
+    public:
+        explicit CsvPipeline(const CsvOptions& options = {});
+        ~CsvPipeline();
+
+        CsvPipeline(const CsvPipeline&)            = delete;
+        CsvPipeline& operator=(const CsvPipeline&) = delete;
+
+        /// <summary>
+        /// Adds a program to evaluate per row. When result is not
+        /// empty the program's result is written to a column of
+        /// that name.
+        /// </summary>
+        void add(ProgramPtr program, const String& result = "");
+
+        /// <summary>
+        /// Writes the variable name, as assigned by the programs
+        /// or read from the input, to a column of the same name.
+        /// </summary>
+        void output(const String& name);
+
+        /// <summary>
+        /// Sets a variable in every program, for the variables
+        /// that are not columns of the input.
+        /// </summary>
+        void set(const String& name, Math::Real value);
+
+        /// <summary>
+        /// Streams in to out. Returns false when the input is not
+        /// well formed or a program fails, see error.
+        /// </summary>
+        bool run(IStream& in, OStream& out);
+
+        /// <summary>
+        /// Streams in to sink, see run(IStream&, OStream&).
+        /// </summary>
+        bool run(IStream& in, CsvSink& sink);
+
+        const String& error() const;
+
+        /// <summary>
+        /// The number of rows written by the last run.
+        /// </summary>
+        size_t rows() const;
+    };
+
+    inline const String& CsvPipeline::error() const
+    {
+        return _error;
+    }
+
+    inline size_t CsvPipeline::rows() const
+    {
+        return _rows;
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,107 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/DependencyGraph.h"
+#include "Expression/Program.h"
+
+namespace Rt2::Eq
+{
+    void DependencyGraph::clear()
+    {
+        _statements.resizeFast(0);
+        _readerOffsets.resizeFast(0);
+        _readers.resizeFast(0);
+        _writeOffsets.resizeFast(0);
+        _writes.resizeFast(0);
+        _incremental = true;
+    }
+
+    void DependencyGraph::build(const InstructionArray& code,
+                                const IndexArray&       ends,
+                                const size_t            slots)
+    {
+        clear();
+
+        // (statement, slot) pairs, each recorded once per statement
+        IndexArray readPairs;
+        IndexArray seen;
+        seen.resizeFast(slots);
+        for (U32& s : seen)
+            s = 0;
+
+        U32 first = 0;
+        _writeOffsets.push_back(0);
+        for (const U32 last : ends)
+        {
+            const U32 stmt = (U32)_statements.size();
+            _statements.push_back({first, last});
+
+            for (U32 i = first; i < last; ++i)
+            {
+                const U32 slot = code[i].arg;
+                if (code[i].op == Identifier && seen[slot] != stmt + 1)
+                {
+                    seen[slot] = stmt + 1;
+                    readPairs.push_back(stmt);
+                    readPairs.push_back(slot);
+                }
+                else if (code[i].op == Reference)
+                    _writes.push_back(slot);
+            }
+            _writeOffsets.push_back((U32)_writes.size());
+            first = last;
+        }
+
+        // Invert the pairs into per slot reader lists. The pairs are
+        // already in statement order, so each list is as well.
+        _readerOffsets.resizeFast(slots + 1);
+        for (U32& o : _readerOffsets)
+            o = 0;
+        for (size_t i = 0; i < readPairs.size(); i += 2)
+            ++_readerOffsets[readPairs[i + 1] + 1];
+        for (size_t s = 0; s < slots; ++s)
+            _readerOffsets[s + 1] += _readerOffsets[s];
+
+        IndexArray cursor;
+        cursor.resizeFast(slots);
+        for (size_t s = 0; s < slots; ++s)
+            cursor[s] = _readerOffsets[s];
+
+        _readers.resizeFast(readPairs.size() / 2);
+        for (size_t i = 0; i < readPairs.size(); i += 2)
+            _readers[cursor[readPairs[i + 1]]++] = readPairs[i];
+
+        // seen now records the writer of each slot
+        for (U32& s : seen)
+            s = 0;
+        for (U32 stmt = 0; stmt < _statements.size(); ++stmt)
+        {
+            for (const U32 slot : writes(stmt))
+            {
+                const IndexSpan rd = readers(slot);
+                if (seen[slot] != 0 || (rd.size > 0 && rd.data[0] <= stmt))
+                    _incremental = false;
+                seen[slot] = stmt + 1;
+            }
+        }
+    }
+
+}  // namespace Rt2::Eq
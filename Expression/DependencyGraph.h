@@ -0,0 +1,146 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Utils/Array.h"
+
+namespace Rt2::Eq
+{
+    struct Instruction;
+    using InstructionArray = SimpleArray<Instruction>;
+
+    using IndexArray = SimpleArray<U32>;
+
+    // Marks an unused entry of an IndexArray.
+    constexpr U32 NoIndex = 0xFFFFFFFF;
+
+    /// <summary>
+    /// Read only, non-owning view of a run of indices.
+    /// </summary>
+    struct IndexSpan
+    {
+        const U32* data{nullptr};
+        size_t     size{0};
+
+        const U32* begin() const { return data; }
+
+        const U32* end() const { return data + size; }
+    };
+
+    /// <summary>
+    /// Range of code [first, last) that makes up one top-level statement.
+    /// </summary>
+    struct StatementRange
+    {
+        U32 first{0};
+        U32 last{0};
+    };
+
+    using StatementRanges = SimpleArray<StatementRange>;
+
+    /// <summary>
+    /// Which statements read and write which variable slots.
+    /// Both directions are stored as offset tables into a single
+    /// index array, so that walking the statements downstream of a
+    /// changed slot only touches the entries that are affected.
+    /// </summary>
+    class DependencyGraph
+    {
+    private:
+        StatementRanges _statements;
+        IndexArray      _readerOffsets;
+        IndexArray      _readers;
+        IndexArray      _writeOffsets;
+        IndexArray      _writes;
+        bool            _incremental{true};
+
+    public:
+        DependencyGraph() = default;
+
+        void clear();
+
+        /// <summary>
+        /// Builds the graph. Each entry of ends is one past the last
+        /// instruction of a statement.
+        /// </summary>
+        void build(const InstructionArray& code,
+                   const IndexArray&       ends,
+                   size_t                  slots);
+
+        size_t size() const;
+
+        const StatementRange& statement(size_t idx) const;
+
+        /// <summary>
+        /// The statements that load the slot, in program order.
+        /// </summary>
+        IndexSpan readers(size_t slot) const;
+
+        /// <summary>
+        /// The slots the statement assigns to.
+        /// </summary>
+        IndexSpan writes(size_t statement) const;
+
+        /// <summary>
+        /// True when every slot is assigned by at most one statement and
+        /// is only read by statements after it. Otherwise a statement's
+        /// inputs depend on where it sits relative to the other writers,
+        /// and only a full execution gives the right values.
+        /// </summary>
+        bool incremental() const;
+    };
+
+    inline size_t DependencyGraph::size() const
+    {
+        return _statements.size();
+    }
+
+    inline bool DependencyGraph::incremental() const
+    {
+        return _incremental;
+    }
+
+    inline const StatementRange& DependencyGraph::statement(const size_t idx) const
+    {
+        return _statements[idx];
+    }
+
+    inline IndexSpan DependencyGraph::readers(const size_t slot) const
+    {
+        if (slot + 1 < _readerOffsets.size())
+        {
+            const U32 first = _readerOffsets[slot];
+            return {_readers.data() + first, _readerOffsets[slot + 1] - first};
+        }
+        return {};
+    }
+
+    inline IndexSpan DependencyGraph::writes(const size_t statement) const
+    {
+        if (statement + 1 < _writeOffsets.size())
+        {
+            const U32 first = _writeOffsets[statement];
+            return {_writes.data() + first, _writeOffsets[statement + 1] - first};
+        }
+        return {};
+    }
+
+}  // namespace Rt2::Eq
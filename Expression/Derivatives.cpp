@@ -0,0 +1,226 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/Derivatives.h"
+#include "Expression/Operators.h"
+#include "Expression/Symbol.h"
+
+namespace Rt2::Eq
+{
+    Math::Real unaryRule(const U8 op, const Math::Real x, Math::Real& g)
+    {
+        using R = Math::Real;
+
+        switch (op)
+        {
+        case Neg:
+            g = -1;
+            return -x;
+        case Not:
+            g = 0;
+            return NotOp()(x);
+        case BitwiseNot:
+            g = 0;
+            return BitwiseNotOp()(x);
+        case MathAbs:
+        case MathFabs:
+            g = x < 0 ? -1 : x > 0 ? 1 : 0;
+            return std::fabs(x);
+        case MathCeil:
+            g = 0;
+            return std::ceil(x);
+        case MathFloor:
+            g = 0;
+            return std::floor(x);
+        case MathSin:
+            g = std::cos(x);
+            return std::sin(x);
+        case MathCos:
+            g = -std::sin(x);
+            return std::cos(x);
+        case MathTan:
+        {
+            const R v = std::tan(x);
+            g         = 1 + v * v;
+            return v;
+        }
+        case MathAsin:
+            g = 1 / std::sqrt(1 - x * x);
+            return std::asin(x);
+        case MathAcos:
+            g = -1 / std::sqrt(1 - x * x);
+            return std::acos(x);
+        case MathAtan:
+            g = 1 / (1 + x * x);
+            return std::atan(x);
+        case MathSinh:
+            g = std::cosh(x);
+            return std::sinh(x);
+        case MathCosh:
+            g = std::sinh(x);
+            return std::cosh(x);
+        case MathTanh:
+        {
+            const R v = std::tanh(x);
+            g         = 1 - v * v;
+            return v;
+        }
+        case MathExp:
+            g = std::exp(x);
+            return g;
+        case MathLog:
+            g = 1 / x;
+            return std::log(x);
+        case MathLog10:
+            g = 1 / (x * std::log(R(10)));
+            return std::log10(x);
+        case MathSqrt:
+        {
+            const R v = std::sqrt(x);
+            g         = R(0.5) / v;
+            return v;
+        }
+        default:
+            g = 0;
+            return R(NAN);
+        }
+    }
+
+    Math::Real binaryRule(const U8 op, const Math::Real x, const Math::Real y, Math::Real& gx, Math::Real& gy)
+    {
+        using R = Math::Real;
+
+        switch (op)
+        {
+        case Add:
+            gx = 1, gy = 1;
+            return x + y;
+        case Sub:
+            gx = 1, gy = -1;
+            return x - y;
+        case Mul:
+            gx = y, gy = x;
+            return x * y;
+        case Div:
+            gx = 1 / y, gy = -x / (y * y);
+            return DivOp()(x, y);
+        case Pow:
+        case MathPow:
+        {
+            const R v = std::pow(x, y);
+            gx        = y * std::pow(x, y - 1);
+            gy        = v * std::log(x);
+            return v;
+        }
+        case Mod:
+            gx = 1, gy = -std::trunc(x / y);
+            return std::fmod(x, y);
+        case MathFmod:
+        {
+            const R v = lMod(x, y);
+            gx = 1, gy = -(x - v) / y;
+            return v;
+        }
+        case Less:
+            gx = 0, gy = 0;
+            return LessOp()(x, y);
+        case LessEqual:
+            gx = 0, gy = 0;
+            return LessEqualOp()(x, y);
+        case Greater:
+            gx = 0, gy = 0;
+            return GreaterOp()(x, y);
+        case GreaterEqual:
+            gx = 0, gy = 0;
+            return GreaterEqualOp()(x, y);
+        case Equal:
+            gx = 0, gy = 0;
+            return EqualOp()(x, y);
+        case NotEqual:
+            gx = 0, gy = 0;
+            return NotEqualOp()(x, y);
+        case And:
+            gx = 0, gy = 0;
+            return AndOp()(x, y);
+        case Or:
+            gx = 0, gy = 0;
+            return OrOp()(x, y);
+        case MathAtan2:
+        {
+            const R r = x * x + y * y;
+            gx = y / r, gy = -x / r;
+            return std::atan2(x, y);
+        }
+        default:
+            gx = 0, gy = 0;
+            return R(NAN);
+        }
+    }
+
+    U8 ruleArity(const U8 op)
+    {
+        switch (op)
+        {
+        case Neg:
+        case Not:
+        case BitwiseNot:
+        case MathAbs:
+        case MathFabs:
+        case MathCeil:
+        case MathFloor:
+        case MathSin:
+        case MathCos:
+        case MathTan:
+        case MathAsin:
+        case MathAcos:
+        case MathAtan:
+        case MathSinh:
+        case MathCosh:
+        case MathTanh:
+        case MathExp:
+        case MathLog:
+        case MathLog10:
+        case MathSqrt:
+            return 1;
+        case Add:
+        case Sub:
+        case Mul:
+        case Div:
+        case Pow:
+        case Mod:
+        case MathPow:
+        case MathFmod:
+        case MathAtan2:
+        case Less:
+        case LessEqual:
+        case Greater:
+        case GreaterEqual:
+        case Equal:
+        case NotEqual:
+        case And:
+        case Or:
+            return 2;
+        default:
+            return 0;
+        }
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,60 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Math/Scalar.h"
+
+namespace Rt2::Eq
+{
+    // Values and partial derivatives of the scalar operations,
+    // shared by the automatic differentiation engines.
+    // Comparisons and logical operators are piecewise constant,
+    // so their partial derivatives are zero.
+
+    /// <summary>
+    /// Returns op(x) and sets g to its derivative. Returns NaN
+    /// and sets g to zero when op is not a unary operation.
+    /// </summary>
+    Math::Real unaryRule(U8 op, Math::Real x, Math::Real& g);
+
+    /// <summary>
+    /// Returns op(x, y) and sets gx and gy to its partial derivatives.
+    /// Returns NaN and sets both to zero when op is not a binary operation.
+    /// </summary>
+    Math::Real binaryRule(U8 op, Math::Real x, Math::Real y, Math::Real& gx, Math::Real& gy);
+
+    /// <summary>
+    /// The number of arguments of op when it is differentiable,
+    /// not counting the argument count of math functions, otherwise 0.
+    /// </summary>
+    U8 ruleArity(U8 op);
+
+    /// <summary>
+    /// The contribution of one operand along one direction. Operands
+    /// that do not vary along it contribute nothing, even where the
+    /// partial derivative is not finite, e.g. d/db a^b at a = 0.
+    /// </summary>
+    inline Math::Real term(const Math::Real g, const Math::Real t)
+    {
+        return t != 0 ? g * t : 0;
+    }
+
+}  // namespace Rt2::Eq
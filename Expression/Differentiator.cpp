@@ -0,0 +1,611 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/Differentiator.h"
+#include <cmath>
+#include "Expression/Derivatives.h"
+#include "Math/Math.h"
+
+namespace Rt2::Eq
+{
+    Differentiator::~Differentiator()
+    {
+        clear();
+    }
+
+    void Differentiator::clear()
+    {
+        for (const auto& symbol : _symbols)
+            delete symbol;
+        _symbols.resizeFast(0);
+        _nodes.resizeFast(0);
+        _roots.resizeFast(0);
+        _derived.clear();
+        _emitted.clear();
+        _hidden = 0;
+        _error.clear();
+    }
+
+    bool Differentiator::fail(const String& message)
+    {
+        if (_error.empty())
+            _error = message;
+        return false;
+    }
+
+    String Differentiator::derivativeName(const String& name, const String& variable)
+    {
+        return "d" + name + "/d" + variable;
+    }
+
+    U32 Differentiator::node(const U8 op, const U32 a, const U32 b, const U8 args)
+    {
+        ExprNode n;
+        n.op   = op;
+        n.a    = a;
+        n.b    = b;
+        n.args = args;
+        _nodes.push_back(n);
+        return (U32)_nodes.size() - 1;
+    }
+
+    U32 Differentiator::constant(const Math::Real v)
+    {
+        ExprNode n;
+        n.op    = Numerical;
+        n.value = v;
+        _nodes.push_back(n);
+        return (U32)_nodes.size() - 1;
+    }
+
+    U32 Differentiator::variable(const String& name)
+    {
+        ExprNode n;
+        n.op   = Identifier;
+        n.name = name;
+        _nodes.push_back(n);
+        return (U32)_nodes.size() - 1;
+    }
+
+    bool Differentiator::isConstant(const U32 n) const
+    {
+        return _nodes[n].op == Numerical;
+    }
+
+    bool Differentiator::isConstant(const U32 n, const Math::Real v) const
+    {
+        return _nodes[n].op == Numerical && _nodes[n].value == v;
+    }
+
+    U32 Differentiator::fold(const U8 op, const U32 a, const U32 b, const U8 args)
+    {
+        // evaluate operations on constants here, through the same
+        // rules the evaluators use, so the folded value matches
+        if (isConstant(a) && (b == NoIndex || isConstant(b)))
+        {
+            Math::Real gx, gy;
+            if (b == NoIndex)
+                return constant(unaryRule(op, _nodes[a].value, gx));
+            return constant(binaryRule(op, _nodes[a].value, _nodes[b].value, gx, gy));
+        }
+        return node(op, a, b, args);
+    }
+
+    U32 Differentiator::add(const U32 a, const U32 b)
+    {
+        if (isConstant(a, 0))
+            return b;
+        if (isConstant(b, 0))
+            return a;
+        if (_nodes[b].op == Neg)
+            return sub(a, _nodes[b].a);
+        return fold(Add, a, b, 0);
+    }
+
+    U32 Differentiator::sub(const U32 a, const U32 b)
+    {
+        if (isConstant(b, 0))
+            return a;
+        if (isConstant(a, 0))
+            return neg(b);
+        if (_nodes[b].op == Neg)
+            return add(a, _nodes[b].a);
+        return fold(Sub, a, b, 0);
+    }
+
+    U32 Differentiator::mul(const U32 a, const U32 b)
+    {
+        if (isConstant(a, 0) || isConstant(b, 0))
+            return constant(0);
+        if (isConstant(a, 1))
+            return b;
+        if (isConstant(b, 1))
+            return a;
+        if (isConstant(a, -1))
+            return neg(b);
+        if (isConstant(b, -1))
+            return neg(a);
+        if (isConstant(b) && !isConstant(a))
+            return mul(b, a);
+
+        // gather constant factors on the left: c1 * (c2 * x) = (c1 * c2) * x
+        if (isConstant(a) && _nodes[b].op == Mul && isConstant(_nodes[b].a))
+            return mul(constant(_nodes[a].value * _nodes[_nodes[b].a].value), _nodes[b].b);
+        return fold(Mul, a, b, 0);
+    }
+
+    U32 Differentiator::div(const U32 a, const U32 b)
+    {
+        if (isConstant(a, 0) && !isConstant(b, 0))
+            return constant(0);
+        if (isConstant(b, 1))
+            return a;
+        return fold(Div, a, b, 0);
+    }
+
+    U32 Differentiator::pow(const U32 a, const U32 b)
+    {
+        if (isConstant(b, 0))
+            return constant(1);
+        if (isConstant(b, 1))
+            return a;
+        return fold(Pow, a, b, 0);
+    }
+
+    U32 Differentiator::neg(const U32 a)
+    {
+        if (_nodes[a].op == Neg)
+            return _nodes[a].a;
+        return fold(Neg, a, NoIndex, 0);
+    }
+
+    U32 Differentiator::fn(const U8 op, const U32 a, const U32 b)
+    {
+        return fold(op, a, b, b == NoIndex ? 1 : 2);
+    }
+
+    U32 Differentiator::select(const U32 c, const U32 a, const U32 b)
+    {
+        if (isConstant(c))
+            return _nodes[c].value != 0 ? a : b;
+        if (a == b || (isConstant(a) && isConstant(b) && _nodes[a].value == _nodes[b].value))
+            return a;
+
+        const U32 n = node(Select, c, a);
+        _nodes[n].c = b;
+        return n;
+    }
+
+    U32 Differentiator::hold(const U32 n)
+    {
+        if (isConstant(n) || _nodes[n].op == Identifier)
+            return n;
+
+        // '#' cannot start an identifier, so the name is never a user's
+        return node(Assignment, variable("#" + std::to_string(_hidden++)), n);
+    }
+
+    bool Differentiator::parse(const SymbolArray& symbols)
+    {
+        IndexArray stack;
+
+        const auto pop = [&stack]
+        {
+            const U32 top = stack[stack.size() - 1];
+            stack.resizeFast(stack.size() - 1);
+            return top;
+        };
+
+        for (const auto& symbol : symbols)
+        {
+            const U8 op = (U8)symbol->type();
+            switch (op)
+            {
+            case Numerical:
+                stack.push_back(constant(symbol->value()));
+                break;
+            case MathPi:
+                stack.push_back(constant(Math::Pi));
+                break;
+            case MathE:
+                stack.push_back(constant(Math::E));
+                break;
+            case Identifier:
+                stack.push_back(variable(symbol->name()));
+                break;
+            case Assignment:
+            case Add:
+            case Sub:
+            case Mul:
+            case Div:
+            case Pow:
+            case Mod:
+            case Less:
+            case LessEqual:
+            case Greater:
+            case GreaterEqual:
+            case Equal:
+            case NotEqual:
+            case And:
+            case Or:
+            {
+                if (stack.size() < 2)
+                    return fail("stack underflow");
+                const U32 b = pop();
+                const U32 a = pop();
+                if (op == Assignment && _nodes[a].op != Identifier)
+                    return fail("expected a variable on the left of an assignment");
+                stack.push_back(node(op, a, b));
+                break;
+            }
+            case Neg:
+            case Not:
+            case BitwiseNot:
+                if (stack.empty())
+                    return fail("stack underflow");
+                stack.push_back(node(op, pop()));
+                break;
+            case Select:
+            {
+                if (stack.size() < 3)
+                    return fail("stack underflow");
+                const U32 b = pop();
+                const U32 a = pop();
+                const U32 c = pop();
+                const U32 n = node(Select, c, a);
+                _nodes[n].c = b;
+                stack.push_back(n);
+                break;
+            }
+            case MathAbs:
+            case MathAcos:
+            case MathAsin:
+            case MathAtan:
+            case MathAtan2:
+            case MathCeil:
+            case MathCos:
+            case MathCosh:
+            case MathExp:
+            case MathFabs:
+            case MathFloor:
+            case MathFmod:
+            case MathLog:
+            case MathLog10:
+            case MathPow:
+            case MathSin:
+            case MathSinh:
+            case MathSqrt:
+            case MathTan:
+            case MathTanh:
+            case MathSum:
+            case MathMean:
+            case MathDot:
+            case MathNorm:
+            case MathMin:
+            case MathMax:
+            {
+                if (stack.empty() || _nodes[stack[stack.size() - 1]].op != Numerical)
+                    return fail("expected an argument count");
+
+                const size_t nr = (size_t)_nodes[pop()].value;
+                if (nr == 0 || stack.size() < nr)
+                    return fail("stack underflow");
+
+                IndexArray args;
+                args.resizeFast(nr);
+                for (size_t i = nr; i > 0; --i)
+                    args[i - 1] = pop();
+
+                if (op == MathSum || op == MathMean || op == MathNorm)
+                {
+                    // reductions over scalar arguments are written out
+                    // as the sums they compute
+                    U32 r = op == MathNorm ? node(Mul, args[0], args[0]) : args[0];
+                    for (size_t i = 1; i < nr; ++i)
+                        r = node(Add, r, op == MathNorm ? node(Mul, args[i], args[i]) : args[i]);
+                    if (op == MathMean)
+                        r = node(Div, r, constant(Math::Real(nr)));
+                    else if (op == MathNorm)
+                        r = node(MathSqrt, r, NoIndex, 1);
+                    stack.push_back(r);
+                }
+                else if (op == MathMin || op == MathMax)
+                {
+                    // the same pairwise selects the evaluators make;
+                    // each running result is read twice by the next one
+                    U32 r = args[0];
+                    for (size_t i = 1; i < nr; ++i)
+                    {
+                        r           = hold(r);
+                        const U32 n = node(Select, node(op == MathMin ? Less : Greater, args[i], r), args[i]);
+                        _nodes[n].c = r;
+                        r           = n;
+                    }
+                    stack.push_back(r);
+                }
+                else if (op == MathDot)
+                {
+                    if (nr != 2)
+                        return fail("dot expects two arguments");
+                    stack.push_back(node(Mul, args[0], args[1]));
+                }
+                else
+                {
+                    const U8 arity = ruleArity(op);
+                    if (nr != arity)
+                        return fail("wrong number of arguments");
+                    stack.push_back(node(op, args[0], nr > 1 ? args[1] : NoIndex, (U8)nr));
+                }
+                break;
+            }
+            case UserFunction:
+                return fail("native functions have no symbolic derivative");
+            case Grouping:
+                return fail("lists have no symbolic derivative");
+            default:
+                return fail("unsupported operation");
+            }
+        }
+
+        _roots = stack;
+        return true;
+    }
+
+    U32 Differentiator::derive(const U32 n)
+    {
+        // copied, since building the derivative grows _nodes
+        const ExprNode e = _nodes[n];
+
+        if (e.op == Numerical)
+            return constant(0);
+
+        if (e.op == Select)
+        {
+            const U32 da = derive(e.b);
+            const U32 db = da == NoIndex ? NoIndex : derive(e.c);
+            if (db == NoIndex)
+                return NoIndex;
+            return select(e.a, da, db);
+        }
+
+        // a hidden variable, see hold
+        if (e.op == Assignment && _nodes[e.a].name.front() == '#')
+            return derive(e.b);
+
+        if (e.op == Identifier)
+        {
+            if (_derived.find(e.name) != Npos)
+                return variable(derivativeName(e.name, _variable));
+            return constant(e.name == _variable ? 1 : 0);
+        }
+
+        const U32 da = derive(e.a);
+        if (da == NoIndex)
+            return NoIndex;
+
+        U32 db = NoIndex;
+        if (e.b != NoIndex)
+        {
+            db = derive(e.b);
+            if (db == NoIndex)
+                return NoIndex;
+        }
+
+        const U32 a = e.a, b = e.b;
+        switch (e.op)
+        {
+        case Add:
+            return add(da, db);
+        case Sub:
+            return sub(da, db);
+        case Mul:
+            return add(mul(da, b), mul(a, db));
+        case Div:
+            if (isConstant(db, 0))
+                return div(da, b);
+            return div(sub(mul(da, b), mul(a, db)), mul(b, b));
+        case Pow:
+        case MathPow:
+            if (isConstant(db, 0))
+                return mul(mul(b, pow(a, sub(b, constant(1)))), da);
+            return mul(pow(a, b),
+                       add(mul(db, fn(MathLog, a)),
+                           div(mul(b, da), a)));
+        case Mod:
+            if (!isConstant(db, 0))
+                return fail("the divisor of '%' must not depend on the variable"), NoIndex;
+            return da;
+        case MathFmod:
+            return sub(da, mul(db, div(sub(a, fn(MathFmod, a, b)), b)));
+        case MathAtan2:
+            return div(sub(mul(b, da), mul(a, db)),
+                       add(mul(a, a), mul(b, b)));
+        case Neg:
+            return neg(da);
+        case MathAbs:
+        case MathFabs:
+            // the sign of a, zero at zero
+            return mul(select(fold(Less, a, constant(0), 0),
+                              constant(-1),
+                              fold(Greater, a, constant(0), 0)),
+                       da);
+        case MathCeil:
+        case MathFloor:
+        case Less:
+        case LessEqual:
+        case Greater:
+        case GreaterEqual:
+        case Equal:
+        case NotEqual:
+        case And:
+        case Or:
+        case Not:
+        case BitwiseNot:
+            return constant(0);
+        case MathSin:
+            return mul(fn(MathCos, a), da);
+        case MathCos:
+            return neg(mul(fn(MathSin, a), da));
+        case MathTan:
+        {
+            const U32 t = fn(MathTan, a);
+            return mul(add(constant(1), mul(t, t)), da);
+        }
+        case MathAsin:
+            return div(da, fn(MathSqrt, sub(constant(1), mul(a, a))));
+        case MathAcos:
+            return neg(div(da, fn(MathSqrt, sub(constant(1), mul(a, a)))));
+        case MathAtan:
+            return div(da, add(constant(1), mul(a, a)));
+        case MathSinh:
+            return mul(fn(MathCosh, a), da);
+        case MathCosh:
+            return mul(fn(MathSinh, a), da);
+        case MathTanh:
+        {
+            const U32 t = fn(MathTanh, a);
+            return mul(sub(constant(1), mul(t, t)), da);
+        }
+        case MathExp:
+            return mul(fn(MathExp, a), da);
+        case MathLog:
+            return div(da, a);
+        case MathLog10:
+            return div(da, mul(a, constant(std::log(Math::Real(10)))));
+        case MathSqrt:
+            return div(da, mul(constant(2), fn(MathSqrt, a)));
+        default:
+            return fail("unsupported operation"), NoIndex;
+        }
+    }
+
+    bool Differentiator::deriveStatement(const U32 n, const bool last)
+    {
+        const ExprNode e = _nodes[n];
+        if (e.op != Assignment)
+        {
+            const U32 d = derive(n);
+            if (d == NoIndex)
+                return false;
+            emit(d);
+            return true;
+        }
+
+        // 'a = b = c' assigns b first, then a from b
+        U32 rhs = e.b;
+        if (_nodes[rhs].op == Assignment)
+        {
+            if (!deriveStatement(rhs, false))
+                return false;
+            rhs = variable(_nodes[_nodes[rhs].a].name);
+        }
+
+        const String name = _nodes[e.a].name;
+
+        const U32 d = derive(rhs);
+        if (d == NoIndex)
+            return false;
+
+        // The derivative is assigned first so that it reads
+        // the values that the right hand side reads.
+        const String dn = derivativeName(name, _variable);
+        emitAssignment(dn, d);
+        emitAssignment(name, rhs);
+        _derived.insert(name, (U32)_derived.size());
+
+        if (last)
+            emit(variable(dn));
+        return true;
+    }
+
+    Symbol* Differentiator::createSymbol(const SymbolType type)
+    {
+        Symbol* symbol = new Symbol(type);
+        symbol->setGeneration(_generation);
+        _symbols.push_back(symbol);
+        return symbol;
+    }
+
+    void Differentiator::emit(const U32 n)
+    {
+        const ExprNode& e = _nodes[n];
+        switch (e.op)
+        {
+        case Numerical:
+            createSymbol(Numerical)->setValue(e.value);
+            break;
+        case Identifier:
+            createSymbol(Identifier)->setName(e.name);
+            break;
+        case Assignment:
+            if (const String& name = _nodes[e.a].name; _emitted.find(name) != Npos)
+                createSymbol(Identifier)->setName(name);
+            else
+            {
+                _emitted.insert(name, (U32)_emitted.size());
+                emit(e.a);
+                emit(e.b);
+                createSymbol(Assignment);
+            }
+            break;
+        default:
+            emit(e.a);
+            if (e.b != NoIndex)
+                emit(e.b);
+            if (e.c != NoIndex)
+                emit(e.c);
+            if (e.args > 0)
+                createSymbol(Numerical)->setValue((I32)e.args);
+            createSymbol((SymbolType)e.op);
+            break;
+        }
+    }
+
+    void Differentiator::emitAssignment(const String& name, const U32 n)
+    {
+        createSymbol(Identifier)->setName(name);
+        emit(n);
+        createSymbol(Assignment);
+    }
+
+    bool Differentiator::derive(const SymbolArray& symbols, const String& variable)
+    {
+        clear();
+        _variable   = variable;
+        _generation = Symbol::nextGeneration();
+
+        if (!parse(symbols))
+            return false;
+
+        for (size_t i = 0; i < _roots.size(); ++i)
+        {
+            if (!deriveStatement(_roots[i], i + 1 == _roots.size()))
+            {
+                for (const auto& symbol : _symbols)
+                    delete symbol;
+                _symbols.resizeFast(0);
+                return false;
+            }
+        }
+        return true;
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,160 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Expression/DependencyGraph.h"
+#include "Expression/Symbol.h"
+#include "Utils/HashMap.h"
+#include "Utils/String.h"
+
+namespace Rt2::Eq
+{
+    /// <summary>
+    /// Node of an expression tree. Operators use their SymbolType and
+    /// leave args at zero; functions also record their argument count.
+    /// Only Select uses c.
+    /// </summary>
+    struct ExprNode
+    {
+        U8         op{None};
+        U8         args{0};
+        U32        a{NoIndex};
+        U32        b{NoIndex};
+        U32        c{NoIndex};
+        Math::Real value{0};
+        String     name;
+    };
+
+    using ExprNodes = SimpleArray<ExprNode>;
+    using NameSet   = HashTable<String, U32>;
+
+    /// <summary>
+    /// Symbolic differentiation of postfix symbols.
+    /// The symbols are rebuilt into expression trees, differentiated, and
+    /// written back out as postfix symbols that compile like any others.
+    /// Nodes are created through constructors that fold constants and
+    /// apply identities such as x*1, x+0 and x^1, which keeps the result
+    /// free of the dead terms the product and chain rules produce.
+    /// Comparisons have a zero derivative and a select differentiates
+    /// into a select of the derivatives of its operands. Min and max
+    /// expand into chains of selects whose running results are held in
+    /// hidden variables named '#n'.
+    ///
+    /// For each assignment 'v = e' the output computes the derivative
+    /// into the variable named derivativeName(v, x) before assigning v,
+    /// so later statements can apply the chain rule through v. The
+    /// result of the output is the derivative of the last statement.
+    /// </summary>
+    class Differentiator
+    {
+    private:
+        ExprNodes   _nodes;
+        IndexArray  _roots;
+        NameSet     _derived;
+        String      _variable;
+        String      _error;
+        SymbolArray _symbols;
+        NameSet     _emitted;
+        U32         _hidden{0};
+        U64         _generation{0};
+
+        void clear();
+
+        bool fail(const String& message);
+
+        U32 node(U8 op, U32 a, U32 b = NoIndex, U8 args = 0);
+
+        U32 constant(Math::Real v);
+
+        U32 variable(const String& name);
+
+        bool isConstant(U32 n) const;
+
+        bool isConstant(U32 n, Math::Real v) const;
+
+        U32 fold(U8 op, U32 a, U32 b, U8 args);
+
+        U32 add(U32 a, U32 b);
+        U32 sub(U32 a, U32 b);
+        U32 mul(U32 a, U32 b);
+        U32 div(U32 a, U32 b);
+        U32 pow(U32 a, U32 b);
+        U32 neg(U32 a);
+        U32 fn(U8 op, U32 a, U32 b = NoIndex);
+        U32 select(U32 c, U32 a, U32 b);
+
+        /// <summary>
+        /// Holds the value of n in a hidden variable, for nodes that are
+        /// read more than once. The variable is assigned where it is first
+        /// written out and read by name everywhere after that.
+        /// </summary>
+        U32 hold(U32 n);
+
+        bool parse(const SymbolArray& symbols);
+
+        U32 derive(U32 n);
+
+        bool deriveStatement(U32 n, bool last);
+
+        void emit(U32 n);
+
+        void emitAssignment(const String& name, U32 n);
+
+        Symbol* createSymbol(SymbolType type);
+
+    public:
+        Differentiator() = default;
+        ~Differentiator();
+
+        Differentiator(const Differentiator&)            = delete;
+        Differentiator& operator=(const Differentiator&) = delete;
+
+        /// <summary>
+        /// Differentiates the symbols with respect to variable.
+        /// </summary>
+        /// <returns>
+        /// false if the symbols use an operation that has no symbolic
+        /// derivative, in which case error() describes it.
+        /// </returns>
+        bool derive(const SymbolArray& symbols, const String& variable);
+
+        /// <summary>
+        /// The derivative, owned by the differentiator and
+        /// valid until the next call to derive.
+        /// </summary>
+        const SymbolArray& symbols() const;
+
+        const String& error() const;
+
+        static String derivativeName(const String& name, const String& variable);
+    };
+
+    inline const SymbolArray& Differentiator::symbols() const
+    {
+        return _symbols;
+    }
+
+    inline const String& Differentiator::error() const
+    {
+        return _error;
+    }
+
+}  // namespace Rt2::Eq
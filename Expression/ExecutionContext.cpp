@@ -0,0 +1,1121 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/ExecutionContext.h"
+#include <algorithm>
+#include <cstring>
+#include "Expression/Metrics.h"
+#include "Expression/Operators.h"
+#include "Expression/VectorKernels.h"
+#include "Math/Math.h"
+#include "Utils/StreamMethods.h"
+
+namespace Rt2::Eq
+{
+    ExecutionContext::ExecutionContext(ProgramPtr program) :
+        _ref(std::move(program))
+    {
+        attach(_ref.get());
+    }
+
+    void ExecutionContext::attach(const Program* program)
+    {
+        if (_program != program)
+        {
+            // variables keep their lists, whose handles are
+            // numbered after the program's constant lists
+            detach();
+
+            const U32 nr = U32(program->lists().size());
+            for (BoxedValue& v : _values)
+            {
+                if (v.isList())
+                    v = BoxedValue::list(v.index() + nr);
+            }
+            _stack.resizeFast(0);
+        }
+
+        _program = program;
+        _stale   = true;
+#ifdef Expression_PROFILE
+        _profiler.attach(_program->code().size());
+#endif
+
+        if (const size_t nr = _program->graph().size();
+            _pending.size() < nr)
+        {
+            _pending.resizeFast(nr);
+            for (U8& p : _pending)
+                p = 0;
+        }
+
+        // Slots are only ever appended to the layout,
+        // so existing values keep their position.
+        if (const size_t nr = _program->slots().size();
+            _values.size() < nr)
+        {
+            _values.reserve(nr);
+            _bindings.reserve(nr);
+            _bindingsF.reserve(nr);
+            while (_values.size() < nr)
+                _values.push_back({});
+            while (_bindings.size() < nr)
+                _bindings.push_back({});
+            while (_bindingsF.size() < nr)
+                _bindingsF.push_back({});
+            while (_changed.size() < nr)
+                _changed.push_back(0);
+        }
+    }
+
+    OStream& operator<<(OStream& out, const BoxedValue& v)
+    {
+        out << "{ ";
+        out << "b:" << Hex(v.bits());
+        out << ", ";
+        out << "v:" << SetD({v.value()}, sizeof(double) << 1, 14);
+        out << " }";
+        return out;
+    }
+
+    void trace(BoxedStack&   stack,
+               const String& message,
+               const bool    topToBottom = true)
+    {
+        const int iOffs = stack.sizeI();
+
+        Console::println(Tab(4), message);
+
+        for (int i = 0; i < iOffs; ++i)
+        {
+            int c = iOffs - i - 1;
+            if (!topToBottom)
+                c = i;
+            Console::println(Tab(4), SetI({i}), ':', ' ', stack[c]);
+        }
+    }
+
+    void ExecutionContext::push(const Math::Real v)
+    {
+        _stack.push(BoxedValue(v));
+    }
+
+    bool ExecutionContext::readBinding(const size_t slot, Math::Real& value) const
+    {
+        if (const StridedView& view = _bindings[slot];
+            view.isBound())
+        {
+            value = view.at(_row);
+            return true;
+        }
+        if (const StridedViewF& view = _bindingsF[slot];
+            view.isBound())
+        {
+            value = Math::Real(view.at(_row));
+            return true;
+        }
+        return false;
+    }
+
+    void ExecutionContext::writeBinding(const size_t slot, const Math::Real value) const
+    {
+        if (const StridedView& view = _bindings[slot];
+            view.isBound())
+            view.at(_row) = value;
+        else if (const StridedViewF& viewF = _bindingsF[slot];
+                 viewF.isBound())
+            viewF.at(_row) = float(value);
+    }
+
+    BoxedValue ExecutionContext::fetch(const U32 slot) const
+    {
+        if (Math::Real v; readBinding(slot, v))
+            return BoxedValue(v);
+        return _values[slot];
+    }
+
+    void ExecutionContext::load(const U32 slot)
+    {
+        _stack.push(fetch(slot));
+    }
+
+    void ExecutionContext::reference(const U32 slot)
+    {
+        _stack.push(BoxedValue::id(slot));
+    }
+
+    Math::Real ExecutionContext::valueOf(const size_t slot) const
+    {
+        if (Math::Real v; readBinding(slot, v))
+            return v;
+        return _values[slot].value();
+    }
+
+    ValueSpan ExecutionContext::operand(const BoxedValue& v, Math::Real& scratch) const
+    {
+        if (v.isList())
+            return span(v.index());
+        scratch = v.value();
+        return {&scratch, 1};
+    }
+
+    template <typename Op>
+    void ExecutionContext::elementWise(const BoxedValue a, Op op)
+    {
+        U32        index;
+        Math::Real sa;
+
+        Math::Real* dest = _lists.allocate((U32)operand(a, sa).size, index);
+        Vector::apply(dest, operand(a, sa), op);
+        list(U32(_program->lists().size()) + index);
+    }
+
+    template <typename Op>
+    void ExecutionContext::elementWise(const BoxedValue a, const BoxedValue b, Op op)
+    {
+        Math::Real sa, sb;
+
+        const size_t na = operand(a, sa).size;
+        const size_t nb = operand(b, sb).size;
+        if (!Vector::isBroadcastable(na, nb))
+        {
+            fail(ErrorListSize, "element-wise");
+            return;
+        }
+
+        // The spans are fetched after the allocation,
+        // because allocating may move the storage.
+        U32         index;
+        Math::Real* dest = _lists.allocate((U32)std::max(na, nb), index);
+        Vector::apply(dest, operand(a, sa), operand(b, sb), op);
+        list(U32(_program->lists().size()) + index);
+    }
+
+    template <typename Op>
+    void ExecutionContext::unary(Op op, const char* name)
+    {
+        if (_stack.isNotEmpty())
+        {
+            const BoxedValue a = _stack.popTop();
+            if (a.isList())
+                elementWise(a, op);
+            else
+                push(op(a.value()));
+        }
+        else
+            fail(ErrorStackUnderflow, name);
+    }
+
+    template <typename Op>
+    void ExecutionContext::binary(Op op, const char* name)
+    {
+        if (_stack.size() > 1)
+        {
+            const BoxedValue b = _stack.popTop();
+            const BoxedValue a = _stack.popTop();
+            if (a.isList() || b.isList())
+                elementWise(a, b, op);
+            else
+                push(op(a.value(), b.value()));
+        }
+        else
+            fail(ErrorStackUnderflow, name);
+    }
+
+    template <typename Op>
+    void ExecutionContext::fused(const BoxedValue a, const BoxedValue b, Op op)
+    {
+        if (a.isList() || b.isList())
+            elementWise(a, b, op);
+        else
+            push(op(a.value(), b.value()));
+    }
+
+    template <typename Op>
+    void ExecutionContext::fusedTop(const BoxedValue b, Op op, const char* name)
+    {
+        if (_stack.isNotEmpty())
+            fused(_stack.popTop(), b, op);
+        else
+            fail(ErrorStackUnderflow, name);
+    }
+
+    I32 ExecutionContext::count(const Instruction& ins)
+    {
+        // fused code carries the argument count inline
+        if (ins.aux != 0)
+            return (I32)ins.aux;
+        return _stack.isNotEmpty() ? _stack.popTop().integer() : -1;
+    }
+
+    void ExecutionContext::select()
+    {
+        if (_stack.size() > 2)
+        {
+            const BoxedValue b = _stack.popTop();
+            const BoxedValue a = _stack.popTop();
+            const BoxedValue c = _stack.popTop();
+            if (c.isList() || a.isList() || b.isList())
+                fail(ErrorUnsupported, "select");
+            else
+                push(SelectOp()(c.value(), a.value(), b.value()));
+        }
+        else
+            fail(ErrorStackUnderflow, "select");
+    }
+
+    void ExecutionContext::group()
+    {
+        if (_stack.size() > 1)
+        {
+            if (const U32 nr = (U32)_stack.popTop().integer();
+                _stack.size() >= nr && nr > 0)
+            {
+                // lists do not nest
+                const size_t first = _stack.size() - nr;
+                for (U32 i = 0; i < nr; ++i)
+                {
+                    if (_stack[first + i].isList())
+                    {
+                        fail(ErrorTypeMismatch, "group");
+                        return;
+                    }
+                }
+
+                U32         index;
+                Math::Real* dest = _lists.allocate(nr, index);
+                for (U32 i = 0; i < nr; ++i)
+                    dest[i] = _stack[first + i].value();
+                _stack.resizeFast(first);
+
+                // execution lists are numbered after the
+                // program's constant lists
+                list(U32(_program->lists().size()) + index);
+            }
+            else
+                fail(ErrorStackUnderflow, "group");
+        }
+        else
+            fail(ErrorStackUnderflow, "group");
+    }
+
+    void ExecutionContext::list(const U32 index)
+    {
+        _stack.push(BoxedValue::list(InitialHash + index));
+    }
+
+    void ExecutionContext::assign()
+    {
+        if (_stack.size() > 1)
+        {
+            const BoxedValue b = _stack.popTop();
+            const BoxedValue a = _stack.popTop();
+
+            // a = b, where b is either a value or a list handle
+            const BoxedValue c = b.isId() ? BoxedValue(0.0) : b;
+
+            if (a.isId())
+            {
+                if (a.index() < _values.size())
+                {
+                    _values[a.index()] = c;
+                    if (!c.isList())
+                        writeBinding(a.index(), c.value());
+                }
+            }
+
+            _stack.push(c);
+        }
+        else
+            fail(ErrorStackUnderflow, "assign");
+    }
+
+    void ExecutionContext::mathFncA1(WrapFuncA1 f, const I32 nr)
+    {
+        if (nr < 0)
+            fail(ErrorStackUnderflow, "math function");
+        else if (nr != 1)
+            fail(ErrorArgumentCount, "math function");
+        else
+            unary(f, "math function");
+    }
+
+    void ExecutionContext::mathFncA2(WrapFuncA2 f, const I32 nr)
+    {
+        if (nr < 0)
+            fail(ErrorStackUnderflow, "math function");
+        else if (nr != 2)
+            fail(ErrorArgumentCount, "math function");
+        else
+            binary(f, "math function");
+    }
+
+    void ExecutionContext::reduce(const U8 op, const I32 nr)
+    {
+        if (nr < 1 || _stack.sizeI() < nr)
+        {
+            fail(ErrorStackUnderflow, "reduction");
+            return;
+        }
+        if (op == MathDot && nr != 2)
+        {
+            fail(ErrorArgumentCount, "dot");
+            return;
+        }
+
+        // every argument, list or not, contributes all of its elements
+        const size_t first = _stack.size() - (size_t)nr;
+
+        Math::Real r = 0, s;
+        switch (op)
+        {
+        case MathSum:
+        case MathMean:
+        {
+            size_t count = 0;
+            for (size_t i = first; i < _stack.size(); ++i)
+            {
+                const ValueSpan a = operand(_stack[i], s);
+                r += Vector::sum(a);
+                count += a.size;
+            }
+            if (op == MathMean)
+                r /= Math::Real(count);
+            break;
+        }
+        case MathMin:
+            r = INFINITY;
+            for (size_t i = first; i < _stack.size(); ++i)
+                r = std::min(r, Vector::minimum(operand(_stack[i], s)));
+            break;
+        case MathMax:
+            r = -INFINITY;
+            for (size_t i = first; i < _stack.size(); ++i)
+                r = std::max(r, Vector::maximum(operand(_stack[i], s)));
+            break;
+        case MathNorm:
+            for (size_t i = first; i < _stack.size(); ++i)
+            {
+                const ValueSpan a = operand(_stack[i], s);
+                r += Vector::dot(a, a);
+            }
+            r = sqrt(r);
+            break;
+        case MathDot:
+        {
+            Math::Real      t;
+            const ValueSpan a = operand(_stack[first], s);
+            const ValueSpan b = operand(_stack[first + 1], t);
+            if (!Vector::isBroadcastable(a.size, b.size))
+            {
+                fail(ErrorListSize, "dot");
+                return;
+            }
+            r = Vector::dot(a, b);
+            break;
+        }
+        default:
+            break;
+        }
+
+        _stack.resizeFast(first);
+        push(r);
+    }
+
+    void ExecutionContext::call(const U32 index)
+    {
+        const NativeFunction& fn   = _program->functions()[index];
+        const char*           name = fn.name.c_str();
+
+        if (_stack.isNotEmpty())
+        {
+            const I32 nr = _stack.popTop().integer();
+            if (nr < 1 || _stack.sizeI() < nr)
+            {
+                fail(ErrorStackUnderflow, name);
+                return;
+            }
+            if (!fn.isResolved())
+            {
+                fail(ErrorUnknownFunction, name);
+                return;
+            }
+            if (fn.arity != AnyArity && fn.arity != nr)
+            {
+                fail(ErrorArgumentCount, name);
+                return;
+            }
+
+            const size_t first = _stack.size() - (size_t)nr;
+
+            _args.resizeFast((size_t)nr);
+            for (size_t i = 0; i < (size_t)nr; ++i)
+            {
+                const BoxedValue& a = _stack[first + i];
+                if (a.isList())
+                {
+                    fail(ErrorUnsupported, name);
+                    return;
+                }
+                _args[i] = a.value();
+            }
+
+            _stack.resizeFast(first);
+            push(fn.scalar(_args.data(), (U32)nr));
+        }
+        else
+            fail(ErrorStackUnderflow, name);
+    }
+
+    void ExecutionContext::eval(const Instruction& ins)
+    {
+        // clang-format off
+    switch (ins.op) {
+    case Numerical  : push(_program->constants()[ins.arg]); break;
+    case Identifier : load(ins.arg);    break;
+    case Reference  : reference(ins.arg); break;
+    case MathPi     : push(Math::Pi);   break;
+    case MathE      : push(Math::E);    break;
+    case Add        : binary(AddOp(), "add"); break;
+    case Sub        : binary(SubOp(), "sub"); break;
+    case Neg        : unary(NegOp(), "neg");  break;
+    case Mul        : binary(MulOp(), "mul"); break;
+    case Div        : binary(DivOp(), "div"); break;
+    case Pow        : binary(PowOp(), "pow"); break;
+    case Mod        : binary(ModOp(), "mod"); break;
+    case Less       : binary(LessOp(), "lt");         break;
+    case LessEqual  : binary(LessEqualOp(), "le");    break;
+    case Greater    : binary(GreaterOp(), "gt");      break;
+    case GreaterEqual: binary(GreaterEqualOp(), "ge"); break;
+    case Equal      : binary(EqualOp(), "eq");        break;
+    case NotEqual   : binary(NotEqualOp(), "ne");     break;
+    case And        : binary(AndOp(), "and");         break;
+    case Or         : binary(OrOp(), "or");           break;
+    case Not        : unary(NotOp(), "not");          break;
+    case BitwiseNot : unary(BitwiseNotOp(), "bnot");  break;
+    case Select     : select();         break;
+    case Assignment : assign();         break;
+    case Grouping   : group();          break;
+    case ConstantList: list(ins.arg);   break;
+    case MathSin    : mathFncA1(sin, count(ins));   break;
+    case MathAtan   : mathFncA1(atan, count(ins));  break;
+    case MathAbs    : mathFncA1(fabs, count(ins));  break;
+    case MathAcos   : mathFncA1(acos, count(ins));  break;
+    case MathAsin   : mathFncA1(asin, count(ins));  break;
+    case MathAtan2  : mathFncA2(atan2, count(ins)); break;
+    case MathCeil   : mathFncA1(ceil, count(ins));  break;
+    case MathCos    : mathFncA1(cos, count(ins));   break;
+    case MathCosh   : mathFncA1(cosh, count(ins));  break;
+    case MathExp    : mathFncA1(exp, count(ins));   break;
+    case MathFabs   : mathFncA1(fabs, count(ins));  break;
+    case MathFloor  : mathFncA1(floor, count(ins)); break;
+    case MathFmod   : mathFncA2(lMod, count(ins));  break;
+    case MathLog    : mathFncA1(log, count(ins));   break;
+    case MathLog10  : mathFncA1(log10, count(ins)); break;
+    case MathPow    : mathFncA2(::pow, count(ins)); break;
+    case MathSinh   : mathFncA1(sinh, count(ins));  break;
+    case MathSqrt   : mathFncA1(sqrt, count(ins));  break;
+    case MathTan    : mathFncA1(tan, count(ins));   break;
+    case MathTanh   : mathFncA1(tanh, count(ins));  break;
+    case MathSum    :
+    case MathMin    :
+    case MathMax    :
+    case MathMean   :
+    case MathDot    :
+    case MathNorm   : reduce(ins.op, count(ins)); break;
+    case UserFunction: call(ins.arg);   break;
+
+    // superinstructions, in the order Add, Sub, Mul, Div
+    case SlotConst    : fused(fetch(ins.arg), constant(ins.aux), AddOp()); break;
+    case SlotConst + 1: fused(fetch(ins.arg), constant(ins.aux), SubOp()); break;
+    case SlotConst + 2: fused(fetch(ins.arg), constant(ins.aux), MulOp()); break;
+    case SlotConst + 3: fused(fetch(ins.arg), constant(ins.aux), DivOp()); break;
+    case ConstSlot    : fused(constant(ins.arg), fetch(ins.aux), AddOp()); break;
+    case ConstSlot + 1: fused(constant(ins.arg), fetch(ins.aux), SubOp()); break;
+    case ConstSlot + 2: fused(constant(ins.arg), fetch(ins.aux), MulOp()); break;
+    case ConstSlot + 3: fused(constant(ins.arg), fetch(ins.aux), DivOp()); break;
+    case SlotSlot     : fused(fetch(ins.arg), fetch(ins.aux), AddOp());    break;
+    case SlotSlot + 1 : fused(fetch(ins.arg), fetch(ins.aux), SubOp());    break;
+    case SlotSlot + 2 : fused(fetch(ins.arg), fetch(ins.aux), MulOp());    break;
+    case SlotSlot + 3 : fused(fetch(ins.arg), fetch(ins.aux), DivOp());    break;
+    case TopSlot      : fusedTop(fetch(ins.arg), AddOp(), "add");       break;
+    case TopSlot + 1  : fusedTop(fetch(ins.arg), SubOp(), "sub");       break;
+    case TopSlot + 2  : fusedTop(fetch(ins.arg), MulOp(), "mul");       break;
+    case TopSlot + 3  : fusedTop(fetch(ins.arg), DivOp(), "div");       break;
+    case TopConst     : fusedTop(constant(ins.arg), AddOp(), "add");    break;
+    case TopConst + 1 : fusedTop(constant(ins.arg), SubOp(), "sub");    break;
+    case TopConst + 2 : fusedTop(constant(ins.arg), MulOp(), "mul");    break;
+    case TopConst + 3 : fusedTop(constant(ins.arg), DivOp(), "div");    break;
+    case None:
+    default:
+        break;
+    }
+        // clang-format on
+    }
+
+    void ExecutionContext::fail(const ErrorCode code, const char* op)
+    {
+        // Only the first failure is kept.
+        if (_status.code == ErrorNone)
+        {
+            _status.code = code;
+            _status.op   = op;
+        }
+    }
+
+    bool ExecutionContext::run(const U32 first, const U32 last)
+    {
+        const InstructionArray& code = _program->code();
+        for (U32 i = first; i < last; ++i)
+        {
+            step(code[i], i);
+
+            if (_status.code != ErrorNone)
+            {
+                _status.instruction = i;
+                _stack.resizeFast(0);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ExecutionContext::runFused()
+    {
+        // Failures are reported at the index in code()
+        // of the instruction that the fused one replaced.
+        const InstructionArray& code    = _program->fused();
+        const IndexArray&       origins = _program->origins();
+        for (U32 i = 0; i < code.size(); ++i)
+        {
+            step(code[i], origins[i]);
+
+            if (_status.code != ErrorNone)
+            {
+                _status.instruction = origins[i];
+                _stack.resizeFast(0);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void ExecutionContext::clean()
+    {
+        for (const U32 slot : _changes)
+            _changed[slot] = 0;
+        _changes.resizeFast(0);
+        _stale = false;
+    }
+
+    Math::Real ExecutionContext::execute()
+    {
+        MetricsShard* metrics  = Metrics::shard();
+        const U64     start    = metrics ? Metrics::now() : 0;
+        const size_t  capacity = _lists.capacity();
+
+        _stack.resizeFast(0);
+        _status = {};
+#ifdef Expression_PROFILE
+        _profiler.begin();
+#endif
+
+        const bool ok = runFused();
+        if (ok)
+            clean();
+        else
+            _stale = true;
+
+        if (metrics)
+        {
+            const size_t grown = _lists.capacity() - std::min(capacity, _lists.capacity());
+            metrics->executed(Metrics::now() - start, ok, grown * sizeof(Math::Real));
+        }
+
+        // The lists of the previous execute stay until here,
+        // since statements may read a variable before assigning it.
+        if (_lists.size() > 0)
+            keepLists(InitialHash + U32(_program->lists().size()), false);
+
+        // trace(_stack, "RESULTS");
+        if (!ok || _stack.empty())
+            return 0;
+        return _stack.top().value();
+    }
+
+    void ExecutionContext::invalidate(const VInt index)
+    {
+        if (index < _changed.size() && !_changed[index])
+        {
+            _changed[index] = 1;
+            _changes.push_back((U32)index);
+        }
+    }
+
+    size_t ExecutionContext::recompute()
+    {
+        const DependencyGraph& graph = _program->graph();
+
+        // Lists built by clean statements live in the arena
+        // until it is compacted, which only a full execute can do.
+        if (_stale || _lists.size() > 0 || !graph.incremental())
+        {
+            execute();
+            return graph.size();
+        }
+
+        // _changes grows while it is walked, as every statement
+        // that is reached changes the slots it assigns to.
+        _order.resizeFast(0);
+        for (size_t k = 0; k < _changes.size(); ++k)
+        {
+            for (const U32 stmt : graph.readers(_changes[k]))
+            {
+                if (_pending[stmt])
+                    continue;
+                _pending[stmt] = 1;
+                _order.push_back(stmt);
+
+                for (const U32 slot : graph.writes(stmt))
+                    invalidate(slot);
+            }
+        }
+        std::sort(_order.data(), _order.data() + _order.size());
+
+        MetricsShard* metrics = Metrics::shard();
+        const U64     start   = metrics ? Metrics::now() : 0;
+
+        _status   = {};
+        size_t nr = 0;
+#ifdef Expression_PROFILE
+        _profiler.begin();
+#endif
+        for (const U32 stmt : _order)
+        {
+            _pending[stmt] = 0;
+            if (_status.ok())
+            {
+                const StatementRange& range = graph.statement(stmt);
+
+                _stack.resizeFast(0);
+                if (run(range.first, range.last))
+                    ++nr;
+            }
+        }
+
+        const bool failed = !_status.ok();
+        clean();
+        _stale = failed;
+
+        if (metrics)
+            metrics->recomputed(Metrics::now() - start, graph.size() - _order.size(), nr);
+        return nr;
+    }
+
+    void ExecutionContext::set(const String& name, const Math::Real value)
+    {
+        set(indexOf(name), value);
+    }
+
+    void ExecutionContext::set(const VInt index, const Math::Real value)
+    {
+        if (index < _values.size())
+        {
+            _values[index] = BoxedValue(value);
+            writeBinding(index, value);
+            invalidate(index);
+        }
+    }
+
+    VInt ExecutionContext::indexOf(const String& name) const
+    {
+        return _program->indexOf(name);
+    }
+
+    Math::Real ExecutionContext::get(const String& name, const Math::Real def) const
+    {
+        return get(indexOf(name), def);
+    }
+
+    Math::Real ExecutionContext::get(const VInt index, const Math::Real def) const
+    {
+        if (index < _values.size())
+            return valueOf(index);
+        return def;
+    }
+
+    Math::Real ExecutionContext::peek(I32 idx) const
+    {
+        idx = (_stack.topI() - idx);
+        if (idx >= 0 && idx < _stack.sizeI())
+            return _stack[idx].value();
+        return 0;
+    }
+
+    void ExecutionContext::bind(const VInt index, const StridedView& view)
+    {
+        if (index < _bindings.size())
+        {
+            _bindings[index] = view;
+            invalidate(index);
+        }
+    }
+
+    void ExecutionContext::bind(const String& name, const StridedView& view)
+    {
+        bind(indexOf(name), view);
+    }
+
+    void ExecutionContext::bind(const VInt index, const StridedViewF& view)
+    {
+        if (index < _bindingsF.size())
+        {
+            _bindingsF[index] = view;
+            invalidate(index);
+        }
+    }
+
+    void ExecutionContext::bind(const String& name, const StridedViewF& view)
+    {
+        bind(indexOf(name), view);
+    }
+
+    void ExecutionContext::unbind(const VInt index)
+    {
+        if (index < _bindings.size())
+        {
+            _bindings[index]  = {};
+            _bindingsF[index] = {};
+            invalidate(index);
+        }
+    }
+
+    void ExecutionContext::select(const size_t row)
+    {
+        _row = row;
+        for (size_t s = 0; s < _bindings.size(); ++s)
+        {
+            if (_bindings[s].isBound() || _bindingsF[s].isBound())
+                invalidate(s);
+        }
+    }
+
+    Math::Real ExecutionContext::gradient(const VInt* variables,
+                                          const size_t nr,
+                                          Math::Real*  derivatives)
+    {
+        _inputs.resizeFast(_values.size());
+        for (size_t s = 0; s < _values.size(); ++s)
+            _inputs[s] = valueOf(s);
+
+        _seeds.resizeFast(nr);
+        for (size_t i = 0; i < nr; ++i)
+            _seeds[i] = variables[i] < _values.size() ? (U32)variables[i] : NoIndex;
+
+        for (size_t i = 0; i < nr; ++i)
+            derivatives[i] = 0;
+
+        if (!_forward.execute(*_program, _inputs, {_seeds.data(), nr}))
+        {
+            _status = _forward.status();
+            _stale  = true;
+            return 0;
+        }
+        _status = {};
+
+        for (size_t s = 0; s < _values.size(); ++s)
+        {
+            if (_forward.isWritten(s))
+            {
+                const Math::Real v = _forward.variable(s)[0];
+                _values[s]         = BoxedValue(v);
+                writeBinding(s, v);
+            }
+        }
+        clean();
+
+        const Math::Real* result = _forward.result();
+        if (result == nullptr)
+            return 0;
+
+        for (size_t i = 0; i < nr; ++i)
+            derivatives[i] = result[i + 1];
+        return result[0];
+    }
+
+    Math::Real ExecutionContext::gradient(ValueList& gradient)
+    {
+        _inputs.resizeFast(_values.size());
+        for (size_t s = 0; s < _values.size(); ++s)
+            _inputs[s] = valueOf(s);
+
+        if (!_reverse.execute(*_program, _inputs))
+        {
+            _status = _reverse.status();
+            _stale  = true;
+            gradient.resizeFast(_values.size());
+            for (Math::Real& g : gradient)
+                g = 0;
+            return 0;
+        }
+        _status = {};
+
+        for (size_t s = 0; s < _values.size(); ++s)
+        {
+            if (_reverse.isWritten(s))
+            {
+                const Math::Real v = _reverse.variable(s);
+                _values[s]         = BoxedValue(v);
+                writeBinding(s, v);
+            }
+        }
+        clean();
+
+        _reverse.backward(gradient);
+        return _reverse.result();
+    }
+
+    bool ExecutionContext::mismatch(const size_t rows, ErrorMask* errors)
+    {
+        _status = {};
+        fail(ErrorUnsupported, "precision");
+        if (errors != nullptr)
+        {
+            errors->reset(rows);
+            for (size_t r = 0; r < rows; r += BatchLanes)
+                errors->setWord(r, ~U64(0));
+        }
+        return false;
+    }
+
+    bool ExecutionContext::executeBatch(const size_t rows,
+                                        Math::Real*  results,
+                                        ErrorMask*   errors)
+    {
+        if (_program->precision() == PrecisionFloat32)
+        {
+            if (results != nullptr)
+                return mismatch(rows, errors);
+            return executeBatch(rows, (float*)nullptr, errors);
+        }
+
+        _stale            = true;
+        const bool result = _batch.execute(*_program, _values, _bindings, _bindingsF, rows, results, errors);
+        _status           = _batch.status();
+        return result;
+    }
+
+    bool ExecutionContext::executeBatch(const size_t rows,
+                                        float*       results,
+                                        ErrorMask*   errors)
+    {
+        if (_program->precision() != PrecisionFloat32)
+        {
+            if (results != nullptr)
+                return mismatch(rows, errors);
+            return executeBatch(rows, (Math::Real*)nullptr, errors);
+        }
+
+        _stale            = true;
+        const bool result = _batchF.execute(*_program, _values, _bindingsF, _bindings, rows, results, errors);
+        _status           = _batchF.status();
+        return result;
+    }
+
+    U64* ExecutionContext::saveLists(StateSnapshot& dest, const size_t values) const
+    {
+        const ListRanges& ranges = _lists.ranges();
+        const ValueList&  data   = _lists.data();
+
+        U64* lists = dest.reserve(values, ranges.size(), data.size());
+        U64* words = lists + (dest._delta ? 2 * values : values);
+        if (!ranges.empty())
+            std::memcpy(words, ranges.data(), ranges.size() * sizeof(ListRange));
+        if (!data.empty())
+            std::memcpy(words + ranges.size(), data.data(), data.size() * sizeof(Math::Real));
+        return lists;
+    }
+
+    void ExecutionContext::restoreLists(const StateSnapshot& snapshot, const U64* lists)
+    {
+        _lists.assign((const ListRange*)lists,
+                      snapshot._lists,
+                      (const Math::Real*)(lists + snapshot._lists),
+                      snapshot._elements);
+    }
+
+    void ExecutionContext::detach()
+    {
+        if (_program)
+            keepLists(InitialHash, true);
+        _program = nullptr;
+    }
+
+    void ExecutionContext::keepLists(const U32 first, const bool constants)
+    {
+        const U32 nr = U32(_program->lists().size());
+
+        _moved.resizeFast(nr + _lists.size());
+        for (U32& m : _moved)
+            m = NoIndex;
+
+        _kept.reset();
+        const auto keep = [&](BoxedValue& v)
+        {
+            const U32 idx = v.index() - InitialHash;
+            if (!v.isList() || idx >= _moved.size() || (idx < nr && !constants))
+                return;
+
+            // lists shared by several references are copied once
+            if (_moved[idx] == NoIndex)
+            {
+                const ValueSpan src = span(v.index());
+
+                Math::Real* dest = _kept.allocate((U32)src.size, _moved[idx]);
+                for (size_t i = 0; i < src.size; ++i)
+                    dest[i] = src[i];
+            }
+            v = BoxedValue::list(first + _moved[idx]);
+        };
+
+        for (BoxedValue& v : _values)
+            keep(v);
+        for (size_t i = 0; i < _stack.size(); ++i)
+            keep(_stack[i]);
+
+        _lists.assign(_kept.ranges().data(),
+                      _kept.size(),
+                      _kept.data().data(),
+                      _kept.data().size());
+    }
+
+    void ExecutionContext::snapshot(StateSnapshot& dest) const
+    {
+        static_assert(sizeof(ListRange) == sizeof(U64));
+
+        dest._program = _program->id();
+        dest._delta   = false;
+
+        U64* words = saveLists(dest, _values.size());
+        for (size_t i = 0; i < _values.size(); ++i)
+            words[i] = _values[i].bits();
+    }
+
+    bool ExecutionContext::snapshot(StateSnapshot& dest, const StateSnapshot& base) const
+    {
+        if (base._program != _program->id() || base._delta)
+            return false;
+
+        const U64*   from = base._block.data();
+        const size_t nr   = _values.size();
+
+        // counted first, so that the block is sized once
+        size_t changes = 0;
+        for (size_t i = 0; i < nr; ++i)
+            changes += i >= base._values || _values[i].bits() != from[i];
+
+        dest._program = _program->id();
+        dest._delta   = true;
+
+        U64* words = saveLists(dest, changes);
+        for (size_t i = 0; i < nr; ++i)
+        {
+            if (i >= base._values || _values[i].bits() != from[i])
+            {
+                *words++ = i;
+                *words++ = _values[i].bits();
+            }
+        }
+        return true;
+    }
+
+    bool ExecutionContext::restore(const StateSnapshot& snapshot)
+    {
+        if (snapshot._program != _program->id())
+            return false;
+
+        const U64* words = snapshot._block.data();
+        if (snapshot._delta)
+        {
+            for (size_t i = 0; i < snapshot._values; ++i)
+            {
+                const U64 slot = words[2 * i];
+                if (slot < _values.size())
+                {
+                    _values[slot] = BoxedValue::fromBits(words[2 * i + 1]);
+                    invalidate(slot);
+                }
+            }
+            restoreLists(snapshot, words + 2 * snapshot._values);
+        }
+        else
+        {
+            // Slots are only appended to the layout, so a snapshot
+            // taken before new names were added is a prefix.
+            const size_t nr = std::min(snapshot._values, _values.size());
+            for (size_t i = 0; i < nr; ++i)
+            {
+                if (_values[i].bits() != words[i])
+                    invalidate(i);
+            }
+            for (size_t i = 0; i < nr; ++i)
+                _values[i] = BoxedValue::fromBits(words[i]);
+            restoreLists(snapshot, words + snapshot._values);
+        }
+        return true;
+    }
+
+    ValueSpan ExecutionContext::span(const size_t handle) const
+    {
+        if (handle >= InitialHash)
+        {
+            const ListStorage& constants = _program->lists();
+
+            const size_t idx = handle - InitialHash;
+            if (idx < constants.size())
+                return constants.span(idx);
+            return _lists.span(idx - constants.size());
+        }
+        return {};
+    }
+
+    ValueSpan ExecutionContext::list(const VInt index) const
+    {
+        if (index < _values.size() && _values[index].isList())
+            return span(_values[index].index());
+        return {};
+    }
+
+    ValueSpan ExecutionContext::list(const String& name) const
+    {
+        return list(indexOf(name));
+    }
+
+    void ExecutionContext::get(const String& name, ValueList& dest) const
+    {
+        const ValueSpan values = list(name);
+
+        dest.resizeFast(values.size);
+        for (size_t i = 0; i < values.size; ++i)
+            dest[i] = values[i];
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,352 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Expression/BatchEvaluator.h"
+#include "Expression/BoxedValue.h"
+#include "Expression/ExecutionStatus.h"
+#include "Expression/ForwardEvaluator.h"
+#include "Expression/Program.h"
+#include "Expression/ReverseEvaluator.h"
+#ifdef Expression_PROFILE
+    #include "Expression/Profiler.h"
+#endif
+#include "Expression/StackValue.h"
+#include "Expression/StateSnapshot.h"
+#include "Expression/StridedView.h"
+
+namespace Rt2::Eq
+{
+    typedef double (*WrapFuncA1)(double a1);
+    typedef double (*WrapFuncA2)(double a1, double a2);
+
+    /// <summary>
+    /// Per-thread execution state for a shared Program.
+    /// The context owns the evaluation stack, the variable values
+    /// (one per program slot) and the list storage. Stack entries and
+    /// values are eight byte BoxedValues. Any slot may be
+    /// bound to caller owned memory, in which case it is read and
+    /// written in place instead of through the value table.
+    /// </summary>
+    class ExecutionContext
+    {
+    private:
+        ProgramPtr       _ref;
+        const Program*   _program{nullptr};
+        BoxedStack       _stack;
+        BoxedArray       _values;
+        BindingArray     _bindings;
+        BindingArrayF    _bindingsF;
+        size_t           _row{0};
+        ListStorage      _lists;
+        ListStorage      _kept;
+        IndexArray       _moved;
+        ExecutionStatus  _status;
+        BatchEvaluator   _batch;
+        BatchEvaluatorF  _batchF;
+        ValueList        _args;
+        ForwardEvaluator _forward;
+        ReverseEvaluator _reverse;
+        ValueList        _inputs;
+        IndexArray       _seeds;
+        SlotMask         _changed;
+        IndexArray       _changes;
+        SlotMask         _pending;
+        IndexArray       _order;
+        bool             _stale{true};
+#ifdef Expression_PROFILE
+        Profiler _profiler;
+#endif
+
+        friend class Statement;
+
+        ExecutionContext() = default;
+
+        void attach(const Program* program);
+
+        /// <summary>
+        /// Moves every list that a variable holds into the list storage,
+        /// so that the program can be rebuilt before the next attach.
+        /// </summary>
+        void detach();
+
+        void push(Math::Real v);
+
+        BoxedValue fetch(U32 slot) const;
+
+        BoxedValue constant(U32 index) const;
+
+        void load(U32 slot);
+
+        void reference(U32 slot);
+
+        Math::Real valueOf(size_t slot) const;
+
+        bool readBinding(size_t slot, Math::Real& value) const;
+
+        void writeBinding(size_t slot, Math::Real value) const;
+
+        bool mismatch(size_t rows, ErrorMask* errors);
+
+        ValueSpan span(size_t handle) const;
+
+        ValueSpan operand(const BoxedValue& v, Math::Real& scratch) const;
+
+        template <typename Op>
+        void elementWise(BoxedValue a, Op op);
+
+        template <typename Op>
+        void elementWise(BoxedValue a, BoxedValue b, Op op);
+
+        template <typename Op>
+        void unary(Op op, const char* name);
+
+        template <typename Op>
+        void binary(Op op, const char* name);
+
+        template <typename Op>
+        void fused(BoxedValue a, BoxedValue b, Op op);
+
+        template <typename Op>
+        void fusedTop(BoxedValue b, Op op, const char* name);
+
+        I32 count(const Instruction& ins);
+
+        void select();
+        void group();
+        void list(U32 index);
+        void assign();
+
+        void mathFncA1(WrapFuncA1 f, I32 nr);
+        void mathFncA2(WrapFuncA2 f, I32 nr);
+
+        void reduce(U8 op, I32 nr);
+
+        void call(U32 index);
+
+        void eval(const Instruction& ins);
+
+        void step(const Instruction& ins, U32 origin);
+
+        bool run(U32 first, U32 last);
+
+        bool runFused();
+
+        void clean();
+
+        void fail(ErrorCode code, const char* op);
+
+        U64* saveLists(StateSnapshot& dest, size_t values) const;
+
+        void restoreLists(const StateSnapshot& snapshot, const U64* lists);
+
+        /// <summary>
+        /// Drops the lists that neither a variable nor the stack refers
+        /// to, and renumbers the rest from first in the order that they
+        /// are referenced. Constant lists are copied too if constants
+        /// is true.
+        /// </summary>
+        void keepLists(U32 first, bool constants);
+
+    public:
+        explicit ExecutionContext(ProgramPtr program);
+        ~ExecutionContext() = default;
+
+        ExecutionContext(const ExecutionContext&)            = delete;
+        ExecutionContext& operator=(const ExecutionContext&) = delete;
+
+        const Program& program() const;
+
+        void set(const String& name, Math::Real value);
+        void set(VInt index, Math::Real value);
+
+        VInt indexOf(const String& name) const;
+
+        Math::Real get(const String& name, Math::Real def = 0) const;
+
+        Math::Real get(VInt index, Math::Real def = 0) const;
+
+        void get(const String& name, ValueList& dest) const;
+
+        /// <summary>
+        /// Returns the elements of a list variable without copying them.
+        /// Lists built during execution are valid until the next execute;
+        /// constant list literals live as long as the program.
+        /// </summary>
+        ValueSpan list(VInt index) const;
+
+        ValueSpan list(const String& name) const;
+
+        Math::Real peek(I32 idx) const;
+
+        /// <summary>
+        /// Binds a variable to caller owned memory. The memory must
+        /// outlive the binding or be released with unbind.
+        /// </summary>
+        void bind(VInt index, const StridedView& view);
+
+        void bind(const String& name, const StridedView& view);
+
+        /// <summary>
+        /// Binds a variable to caller owned float memory. These bindings
+        /// are what batch execution of a PrecisionFloat32 program reads
+        /// and writes.
+        /// </summary>
+        void bind(VInt index, const StridedViewF& view);
+
+        void bind(const String& name, const StridedViewF& view);
+
+        void unbind(VInt index);
+
+        /// <summary>
+        /// Selects the row of the bound views that execute reads and writes.
+        /// </summary>
+        void select(size_t row);
+
+        /// <summary>
+        /// Executes the program. Errors do not throw, instead zero is
+        /// returned and the failure is described by status().
+        /// </summary>
+        Math::Real execute();
+
+        /// <summary>
+        /// Marks a variable as changed, so that the next recompute
+        /// re-evaluates the statements that depend on it. set, bind
+        /// and select do this already; call it when bound memory is
+        /// written by the caller.
+        /// </summary>
+        void invalidate(VInt index);
+
+        /// <summary>
+        /// Re-evaluates, in program order, only the statements that
+        /// are downstream of the variables changed since the last
+        /// execute or recompute. The first call, and any call after a
+        /// failure or a batch execution, runs the whole program, as do
+        /// programs that build lists at run time and programs whose
+        /// graph is not incremental.
+        /// </summary>
+        /// <returns>The number of statements evaluated.</returns>
+        size_t recompute();
+
+        /// <summary>
+        /// Executes rows [0, rows) of the bound views in blocks.
+        /// See BatchEvaluator::execute. The engine is picked by the
+        /// program's precision; non-null results of the other scalar
+        /// type fail with ErrorUnsupported.
+        /// </summary>
+        bool executeBatch(size_t      rows,
+                          Math::Real* results = nullptr,
+                          ErrorMask*  errors  = nullptr);
+
+        bool executeBatch(size_t     rows,
+                          float*     results,
+                          ErrorMask* errors = nullptr);
+
+        /// <summary>
+        /// Executes the program on dual numbers. Returns the result and
+        /// writes its derivative with respect to each of the nr variables
+        /// to derivatives. Assigned variables are updated as by execute.
+        /// Lists and native functions fail with ErrorUnsupported.
+        /// </summary>
+        Math::Real gradient(const VInt* variables,
+                            size_t      nr,
+                            Math::Real* derivatives);
+
+        /// <summary>
+        /// Executes the program once on a tape, then back-propagates.
+        /// Returns the result and writes its derivative with respect to
+        /// every variable to gradient, in slot order. Prefer this form
+        /// when there are many inputs. Assigned variables are updated as
+        /// by execute. Lists and native functions fail with ErrorUnsupported.
+        /// </summary>
+        Math::Real gradient(ValueList& gradient);
+
+        /// <summary>
+        /// Saves the value of every variable, and the lists built by the
+        /// last execute, to dest. Reusing dest does not allocate once it
+        /// has grown to the size of the state.
+        /// </summary>
+        void snapshot(StateSnapshot& dest) const;
+
+        /// <summary>
+        /// Saves only the values that differ from base, a full snapshot
+        /// taken on a context of the same program, together with the
+        /// lists. Returns false when base is not such a snapshot.
+        /// </summary>
+        bool snapshot(StateSnapshot& dest, const StateSnapshot& base) const;
+
+        /// <summary>
+        /// Puts back the state saved by snapshot. A delta only writes the
+        /// values that it holds, so restore its base first, unless the
+        /// state already matches it. Returns false when the snapshot was
+        /// taken on a context of another program.
+        /// </summary>
+        bool restore(const StateSnapshot& snapshot);
+
+        /// <summary>
+        /// Describes the outcome of the last execute or executeBatch.
+        /// </summary>
+        const ExecutionStatus& status() const;
+
+#ifdef Expression_PROFILE
+        /// <summary>
+        /// Opcode counts and cycles of every execute and recompute
+        /// on this context since it was created or last reset.
+        /// </summary>
+        Profiler& profiler();
+#endif
+    };
+
+    inline const Program& ExecutionContext::program() const
+    {
+        return *_program;
+    }
+
+    inline BoxedValue ExecutionContext::constant(const U32 index) const
+    {
+        return BoxedValue(_program->constants()[index]);
+    }
+
+    inline const ExecutionStatus& ExecutionContext::status() const
+    {
+        return _status;
+    }
+
+    inline void ExecutionContext::step(const Instruction& ins, const U32 origin)
+    {
+#ifdef Expression_PROFILE
+        const U64 start = Profiler::now();
+        eval(ins);
+        _profiler.record(ins.op, origin, Profiler::now() - start, _stack.size());
+#else
+        (void)origin;
+        eval(ins);
+#endif
+    }
+
+#ifdef Expression_PROFILE
+    inline Profiler& ExecutionContext::profiler()
+    {
+        return _profiler;
+    }
+#endif
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,98 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/ExecutionStatus.h"
+
+namespace Rt2::Eq
+{
+    String ExecutionStatus::message() const
+    {
+        OutputStringStream stream;
+        switch (code)
+        {
+        case ErrorNone:
+            return {};
+        case ErrorStackUnderflow:
+            stream << "not enough arguments supplied to the '" << op << "' operation";
+            break;
+        case ErrorArgumentCount:
+            stream << "wrong number of arguments supplied to the '" << op << "' function";
+            break;
+        case ErrorListSize:
+            stream << "mismatched list sizes in the '" << op << "' operation";
+            break;
+        case ErrorUnsupported:
+            stream << "the '" << op << "' operation is not supported in this mode";
+            break;
+        case ErrorDomain:
+            stream << "the result is not a number";
+            break;
+        case ErrorUnknownFunction:
+            stream << "the function '" << op << "' is not defined";
+            break;
+        case ErrorTypeMismatch:
+            stream << "a list was supplied where the '" << op << "' operation expects a value";
+            break;
+        }
+        stream << " (instruction " << instruction << ")";
+        return stream.str();
+    }
+
+    void ErrorMask::reset(const size_t rows)
+    {
+        _rows = rows;
+        _bits.resizeFast((rows + 63) >> 6);
+        for (U64& word : _bits)
+            word = 0;
+    }
+
+    void ErrorMask::setWord(const size_t row, const U64 bits)
+    {
+        if (row < _rows)
+        {
+            // keep the bits past the last row clear
+            const size_t tail = _rows - (row & ~size_t(63));
+            _bits[row >> 6] |= tail < 64 ? bits & ((U64(1) << tail) - 1) : bits;
+        }
+    }
+
+    bool ErrorMask::any() const
+    {
+        for (const U64 word : _bits)
+        {
+            if (word != 0)
+                return true;
+        }
+        return false;
+    }
+
+    size_t ErrorMask::count() const
+    {
+        size_t nr = 0;
+        for (U64 word : _bits)
+        {
+            for (; word != 0; word &= word - 1)
+                ++nr;
+        }
+        return nr;
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,103 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Utils/Array.h"
+#include "Utils/String.h"
+
+namespace Rt2::Eq
+{
+    enum ErrorCode
+    {
+        ErrorNone = 0,
+        ErrorStackUnderflow,
+        ErrorArgumentCount,
+        ErrorListSize,
+        ErrorUnsupported,
+        ErrorDomain,
+        ErrorUnknownFunction,
+        ErrorTypeMismatch,
+    };
+
+    /// <summary>
+    /// Result of an execution. Only the failing operation's name is
+    /// recorded on failure; the message is formatted when message()
+    /// is called.
+    /// </summary>
+    struct ExecutionStatus
+    {
+        ErrorCode code{ErrorNone};
+
+        // index of the failing instruction in Program::code
+        U32 instruction{0};
+
+        // name of the failing operation, copied so that the status
+        // outlives the program that owns native function names
+        String op;
+
+        bool ok() const;
+
+        String message() const;
+    };
+
+    /// <summary>
+    /// One bit per row of a batch, set when the row failed.
+    /// Rows are grouped in words of 64 so that a full block of
+    /// BatchLanes rows is a single word.
+    /// </summary>
+    class ErrorMask
+    {
+    private:
+        SimpleArray<U64> _bits;
+        size_t           _rows{0};
+
+    public:
+        ErrorMask() = default;
+
+        void reset(size_t rows);
+
+        void setWord(size_t row, U64 bits);
+
+        bool test(size_t row) const;
+
+        bool any() const;
+
+        size_t count() const;
+
+        size_t rows() const;
+    };
+
+    inline bool ExecutionStatus::ok() const
+    {
+        return code == ErrorNone;
+    }
+
+    inline bool ErrorMask::test(const size_t row) const
+    {
+        return row < _rows && (_bits[row >> 6] >> (row & 63) & 1) != 0;
+    }
+
+    inline size_t ErrorMask::rows() const
+    {
+        return _rows;
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,405 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/ForwardEvaluator.h"
+#include <cassert>
+#include "Expression/Derivatives.h"
+#include "Math/Math.h"
+
+namespace Rt2::Eq
+{
+    namespace
+    {
+        const char* name(const U8 op)
+        {
+            switch (op)
+            {
+            case Add:
+                return "add";
+            case Sub:
+                return "sub";
+            case Mul:
+                return "mul";
+            case Div:
+                return "div";
+            case Pow:
+                return "pow";
+            case Mod:
+                return "mod";
+            case Neg:
+                return "neg";
+            case Less:
+            case LessEqual:
+            case Greater:
+            case GreaterEqual:
+            case Equal:
+            case NotEqual:
+                return "comparison";
+            case And:
+            case Or:
+            case Not:
+            case BitwiseNot:
+                return "logical";
+            default:
+                return "math function";
+            }
+        }
+    }  // namespace
+
+    void ForwardEvaluator::fail(const ErrorCode code, const char* op)
+    {
+        if (_status.code == ErrorNone)
+        {
+            _status.code = code;
+            _status.op   = op;
+        }
+    }
+
+    bool ForwardEvaluator::require(const size_t nr, const char* op)
+    {
+        if (_top < nr)
+        {
+            fail(ErrorStackUnderflow, op);
+            return false;
+        }
+        return true;
+    }
+
+    Math::Real* ForwardEvaluator::push()
+    {
+        // the stack is sized from Program::stackDepth
+        assert(_top < _ids.size());
+        _ids[_top] = NoIndex;
+        return entry(_top++);
+    }
+
+    void ForwardEvaluator::pushValue(const Math::Real v)
+    {
+        Math::Real* dest = push();
+        dest[0]          = v;
+        for (size_t k = 1; k < _width; ++k)
+            dest[k] = 0;
+    }
+
+    void ForwardEvaluator::pushSlot(const U32 idx)
+    {
+        Math::Real*       dest = push();
+        const Math::Real* src  = slot(idx);
+        for (size_t k = 0; k < _width; ++k)
+            dest[k] = src[k];
+    }
+
+    void ForwardEvaluator::pushReference(const U32 idx)
+    {
+        assert(_top < _ids.size());
+        _ids[_top++] = idx;
+    }
+
+    void ForwardEvaluator::unary(const U8 op)
+    {
+        if (!require(1, name(op)))
+            return;
+
+        Math::Real* a = entry(_top - 1);
+        Math::Real  g = 0;
+        a[0]          = unaryRule(op, a[0], g);
+        for (size_t k = 1; k < _width; ++k)
+            a[k] = term(g, a[k]);
+        _ids[_top - 1] = NoIndex;
+    }
+
+    void ForwardEvaluator::binary(const U8 op)
+    {
+        if (!require(2, name(op)))
+            return;
+
+        const Math::Real* b  = entry(--_top);
+        Math::Real*       a  = entry(_top - 1);
+        Math::Real        ga = 0, gb = 0;
+        a[0]                 = binaryRule(op, a[0], b[0], ga, gb);
+        for (size_t k = 1; k < _width; ++k)
+            a[k] = term(ga, a[k]) + term(gb, b[k]);
+        _ids[_top - 1] = NoIndex;
+    }
+
+    void ForwardEvaluator::select()
+    {
+        if (!require(3, "select"))
+            return;
+
+        // the derivative is that of the selected operand
+        const Math::Real* b    = entry(--_top);
+        const Math::Real* a    = entry(--_top);
+        Math::Real*       c    = entry(_top - 1);
+        const Math::Real* pick = c[0] != 0 ? a : b;
+        for (size_t k = 0; k < _width; ++k)
+            c[k] = pick[k];
+        _ids[_top - 1] = NoIndex;
+    }
+
+    bool ForwardEvaluator::arguments(const I32 expected)
+    {
+        if (!require((size_t)expected + 1, "math function"))
+            return false;
+        if (I32(entry(--_top)[0]) != expected)
+        {
+            fail(ErrorArgumentCount, "math function");
+            return false;
+        }
+        return true;
+    }
+
+    void ForwardEvaluator::assign()
+    {
+        if (!require(2, "assign"))
+            return;
+        const Math::Real* b  = entry(--_top);
+        Math::Real*       a  = entry(_top - 1);
+        const U32         id = _ids[_top - 1];
+
+        if (id != NoIndex)
+        {
+            Math::Real* dest = slot(id);
+            for (size_t k = 0; k < _width; ++k)
+                dest[k] = b[k];
+            _written[id] = 1;
+        }
+
+        for (size_t k = 0; k < _width; ++k)
+            a[k] = b[k];
+        _ids[_top - 1] = NoIndex;
+    }
+
+    void ForwardEvaluator::reduce(const U8 op)
+    {
+        if (!require(1, "reduction"))
+            return;
+        const size_t nr = (size_t)I32(entry(--_top)[0]);
+        if (nr < 1 || _top < nr)
+        {
+            fail(ErrorStackUnderflow, "reduction");
+            return;
+        }
+        if (op == MathDot && nr != 2)
+        {
+            fail(ErrorArgumentCount, "dot");
+            return;
+        }
+
+        const size_t first = _top - nr;
+        Math::Real*  a     = entry(first);
+
+        switch (op)
+        {
+        case MathSum:
+        case MathMean:
+            for (size_t i = first + 1; i < _top; ++i)
+            {
+                const Math::Real* b = entry(i);
+                for (size_t k = 0; k < _width; ++k)
+                    a[k] += b[k];
+            }
+            if (op == MathMean)
+            {
+                for (size_t k = 0; k < _width; ++k)
+                    a[k] /= Math::Real(nr);
+            }
+            break;
+        case MathMin:
+        case MathMax:
+        {
+            // the derivative is that of the selected argument
+            size_t pick = first;
+            for (size_t i = first + 1; i < _top; ++i)
+            {
+                const Math::Real v = entry(i)[0];
+                if (op == MathMin ? v < entry(pick)[0] : v > entry(pick)[0])
+                    pick = i;
+            }
+            const Math::Real* b = entry(pick);
+            for (size_t k = 0; k < _width; ++k)
+                a[k] = b[k];
+            break;
+        }
+        case MathDot:
+        {
+            const Math::Real* b = entry(first + 1);
+            for (size_t k = 1; k < _width; ++k)
+                a[k] = a[k] * b[0] + a[0] * b[k];
+            a[0] *= b[0];
+            break;
+        }
+        case MathNorm:
+        {
+            // d|x| = sum(x dx) / |x|
+            Math::Real n = 0;
+            for (size_t i = first; i < _top; ++i)
+                n += entry(i)[0] * entry(i)[0];
+            n = std::sqrt(n);
+
+            for (size_t k = 1; k < _width; ++k)
+            {
+                Math::Real d = 0;
+                for (size_t i = first; i < _top; ++i)
+                    d += entry(i)[0] * entry(i)[k];
+                a[k] = n > 0 ? d / n : 0;
+            }
+            a[0] = n;
+            break;
+        }
+        default:
+            break;
+        }
+
+        _top        = first + 1;
+        _ids[first] = NoIndex;
+    }
+
+    void ForwardEvaluator::eval(const Instruction& ins)
+    {
+        switch (ins.op)
+        {
+        case Numerical:
+            pushValue(_program->constants()[ins.arg]);
+            break;
+        case Identifier:
+            pushSlot(ins.arg);
+            break;
+        case Reference:
+            pushReference(ins.arg);
+            break;
+        case MathPi:
+            pushValue(Math::Pi);
+            break;
+        case MathE:
+            pushValue(Math::E);
+            break;
+        case Assignment:
+            assign();
+            break;
+        case Add:
+        case Sub:
+        case Mul:
+        case Div:
+        case Pow:
+        case Mod:
+        case Less:
+        case LessEqual:
+        case Greater:
+        case GreaterEqual:
+        case Equal:
+        case NotEqual:
+        case And:
+        case Or:
+            binary(ins.op);
+            break;
+        case Neg:
+        case Not:
+        case BitwiseNot:
+            unary(ins.op);
+            break;
+        case Select:
+            select();
+            break;
+        case MathSum:
+        case MathMin:
+        case MathMax:
+        case MathMean:
+        case MathDot:
+        case MathNorm:
+            reduce(ins.op);
+            break;
+        case Grouping:
+        case ConstantList:
+            fail(ErrorUnsupported, "list");
+            break;
+        case UserFunction:
+            fail(ErrorUnsupported, _program->functions()[ins.arg].name.c_str());
+            break;
+        default:
+            // math functions are preceded by their argument count
+            if (const U8 nr = ruleArity(ins.op); nr == 1)
+            {
+                if (arguments(1))
+                    unary(ins.op);
+            }
+            else if (nr == 2)
+            {
+                if (arguments(2))
+                    binary(ins.op);
+            }
+            break;
+        }
+    }
+
+    bool ForwardEvaluator::execute(const Program&   program,
+                                   const ValueList& inputs,
+                                   const IndexSpan& seeds)
+    {
+        _program = &program;
+        _width   = seeds.size + 1;
+        _top     = 0;
+        _status  = {};
+
+        const size_t depth = program.stackDepth() + 1;
+        const size_t nr    = program.slots().size();
+
+        _stack.resizeFast(depth * _width);
+        _ids.resizeFast(depth);
+        _slots.resizeFast(nr * _width);
+        _written.resizeFast(nr);
+
+        for (size_t s = 0; s < nr; ++s)
+        {
+            Math::Real* dest = slot(s);
+            dest[0]          = s < inputs.size() ? inputs[s] : 0;
+            for (size_t k = 1; k < _width; ++k)
+                dest[k] = 0;
+            _written[s] = 0;
+        }
+
+        for (size_t i = 0; i < seeds.size; ++i)
+        {
+            if (seeds.data[i] < nr)
+                slot(seeds.data[i])[i + 1] = 1;
+        }
+
+        const InstructionArray& code = program.code();
+        for (U32 i = 0; i < code.size(); ++i)
+        {
+            eval(code[i]);
+
+            if (_status.code != ErrorNone)
+            {
+                _status.instruction = i;
+                _top                = 0;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const Math::Real* ForwardEvaluator::result() const
+    {
+        return _top > 0 ? _stack.data() + (_top - 1) * _width : nullptr;
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,139 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Expression/DependencyGraph.h"
+#include "Expression/ExecutionStatus.h"
+#include "Expression/Program.h"
+
+namespace Rt2::Eq
+{
+    /// <summary>
+    /// Evaluates a program on dual numbers.
+    /// Every stack entry and slot is a value followed by its derivative
+    /// along each of the seed directions, stored contiguously so that
+    /// the rule for an operation runs as one loop over the directions.
+    /// A single pass gives the exact gradient of the result with respect
+    /// to every seeded variable.
+    /// </summary>
+    class ForwardEvaluator
+    {
+    private:
+        const Program*  _program{nullptr};
+        ValueList       _stack;
+        IndexArray      _ids;
+        ValueList       _slots;
+        SimpleArray<U8> _written;
+        size_t          _width{1};
+        size_t          _top{0};
+        ExecutionStatus _status;
+
+        Math::Real* entry(size_t idx);
+
+        Math::Real* slot(size_t idx);
+
+        void fail(ErrorCode code, const char* op);
+
+        bool require(size_t nr, const char* op);
+
+        Math::Real* push();
+
+        void pushValue(Math::Real v);
+
+        void pushSlot(U32 idx);
+
+        void pushReference(U32 idx);
+
+        void unary(U8 op);
+
+        void binary(U8 op);
+
+        void select();
+
+        bool arguments(I32 expected);
+
+        void assign();
+
+        void reduce(U8 op);
+
+        void eval(const Instruction& ins);
+
+    public:
+        ForwardEvaluator() = default;
+
+        /// <summary>
+        /// Evaluates the program. inputs holds the value of every slot
+        /// and seeds the slots to differentiate with respect to; seed i
+        /// starts with a derivative of one along direction i.
+        /// </summary>
+        /// <returns>false if the program could not be evaluated.</returns>
+        bool execute(const Program&   program,
+                     const ValueList& inputs,
+                     const IndexSpan& seeds);
+
+        size_t directions() const;
+
+        /// <summary>
+        /// The top of the stack: its value then one derivative per seed.
+        /// </summary>
+        const Math::Real* result() const;
+
+        bool isWritten(size_t idx) const;
+
+        /// <summary>
+        /// The value and derivatives of a slot after execution.
+        /// </summary>
+        const Math::Real* variable(size_t idx) const;
+
+        const ExecutionStatus& status() const;
+    };
+
+    inline Math::Real* ForwardEvaluator::entry(const size_t idx)
+    {
+        return _stack.data() + idx * _width;
+    }
+
+    inline Math::Real* ForwardEvaluator::slot(const size_t idx)
+    {
+        return _slots.data() + idx * _width;
+    }
+
+    inline const Math::Real* ForwardEvaluator::variable(const size_t idx) const
+    {
+        return _slots.data() + idx * _width;
+    }
+
+    inline size_t ForwardEvaluator::directions() const
+    {
+        return _width - 1;
+    }
+
+    inline bool ForwardEvaluator::isWritten(const size_t idx) const
+    {
+        return idx < _written.size() && _written[idx] != 0;
+    }
+
+    inline const ExecutionStatus& ForwardEvaluator::status() const
+    {
+        return _status;
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,51 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/FunctionRegistry.h"
+
+namespace Rt2::Eq
+{
+    U32 FunctionRegistry::add(const String&        name,
+                              const I32            arity,
+                              const ScalarFunction scalar,
+                              const BatchFunction  batch)
+    {
+        if (const size_t idx = find(name); idx != Npos)
+        {
+            _functions[idx] = {name, arity, scalar, batch};
+            return (U32)idx;
+        }
+
+        const U32 idx = (U32)_functions.size();
+        _lookup.insert(name, idx);
+        _functions.push_back({name, arity, scalar, batch});
+        return idx;
+    }
+
+    size_t FunctionRegistry::find(const String& name) const
+    {
+        if (const size_t idx = _lookup.find(name);
+            idx != Npos)
+            return _lookup.at(idx);
+        return Npos;
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,109 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Math/Scalar.h"
+#include "Utils/Array.h"
+#include "Utils/HashMap.h"
+#include "Utils/String.h"
+
+namespace Rt2::Eq
+{
+    /// <summary>
+    /// Row at a time callback. args holds nr values.
+    /// </summary>
+    using ScalarFunction = Math::Real (*)(const Math::Real* args, U32 nr);
+
+    /// <summary>
+    /// Block at a time callback. args holds nr pointers to lanes
+    /// values each, and the results are written to out. out never
+    /// aliases an argument.
+    /// </summary>
+    using BatchFunction = void (*)(Math::Real*              out,
+                                   const Math::Real* const* args,
+                                   U32                      nr,
+                                   size_t                   lanes);
+
+    // Accepts any number of arguments.
+    constexpr I32 AnyArity = -1;
+
+    struct NativeFunction
+    {
+        String         name;
+        I32            arity{AnyArity};
+        ScalarFunction scalar{nullptr};
+
+        // optional, batches fall back to calling scalar per lane
+        BatchFunction batch{nullptr};
+
+        bool isResolved() const;
+    };
+
+    using FunctionTable = SimpleArray<NativeFunction>;
+    using FunctionHash  = HashTable<String, U32>;
+
+    /// <summary>
+    /// Native functions that can be called by name from an expression.
+    /// Names are resolved once by Program::compile, which copies the
+    /// table into the program, so calls are indexed and the registry
+    /// does not need to outlive the programs compiled against it.
+    /// </summary>
+    class FunctionRegistry
+    {
+    private:
+        FunctionHash  _lookup;
+        FunctionTable _functions;
+
+    public:
+        FunctionRegistry() = default;
+
+        /// <summary>
+        /// Adds, or replaces, the function with the supplied name.
+        /// </summary>
+        /// <returns>The index of the function.</returns>
+        U32 add(const String&  name,
+                I32            arity,
+                ScalarFunction scalar,
+                BatchFunction  batch = nullptr);
+
+        size_t find(const String& name) const;
+
+        const FunctionTable& functions() const;
+
+        size_t size() const;
+    };
+
+    inline bool NativeFunction::isResolved() const
+    {
+        return scalar != nullptr;
+    }
+
+    inline const FunctionTable& FunctionRegistry::functions() const
+    {
+        return _functions;
+    }
+
+    inline size_t FunctionRegistry::size() const
+    {
+        return _functions.size();
+    }
+
+}  // namespace Rt2::Eq
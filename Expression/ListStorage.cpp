@@ -0,0 +1,50 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/ListStorage.h"
+#include <cstring>
+
+namespace Rt2::Eq
+{
+    Math::Real* ListStorage::allocate(const U32 size, U32& index)
+    {
+        const U32 offset = (U32)_data.size();
+        index            = (U32)_ranges.size();
+
+        _ranges.push_back({offset, size});
+        _data.resizeFast(_data.size() + size);
+        return _data.data() + offset;
+    }
+
+    void ListStorage::assign(const ListRange*  ranges,
+                             const size_t      nr,
+                             const Math::Real* data,
+                             const size_t      size)
+    {
+        _ranges.resizeFast(nr);
+        _data.resizeFast(size);
+        if (nr > 0)
+            std::memcpy(_ranges.data(), ranges, nr * sizeof(ListRange));
+        if (size > 0)
+            std::memcpy(_data.data(), data, size * sizeof(Math::Real));
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,133 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Math/Scalar.h"
+#include "Utils/Array.h"
+
+namespace Rt2::Eq
+{
+    using ValueList = SimpleArray<Math::Real>;
+
+    /// <summary>
+    /// Read only, non-owning view of a list's elements.
+    /// </summary>
+    struct ValueSpan
+    {
+        const Math::Real* data{nullptr};
+        size_t            size{0};
+
+        bool empty() const { return size == 0; }
+
+        const Math::Real* begin() const { return data; }
+
+        const Math::Real* end() const { return data + size; }
+
+        const Math::Real& operator[](const size_t i) const { return data[i]; }
+    };
+
+    struct ListRange
+    {
+        U32 offset{0};
+        U32 size{0};
+    };
+
+    using ListRanges = SimpleArray<ListRange>;
+
+    /// <summary>
+    /// Arena for list elements. Lists are appended to one contiguous
+    /// buffer and are all released at once by reset, which keeps the
+    /// reserved memory so that steady state execution does not allocate.
+    /// </summary>
+    class ListStorage
+    {
+    private:
+        ValueList  _data;
+        ListRanges _ranges;
+
+    public:
+        ListStorage() = default;
+
+        void reset();
+
+        /// <summary>
+        /// Reserves room for a list of size elements.
+        /// The returned pointer is only valid until the next allocation.
+        /// </summary>
+        Math::Real* allocate(U32 size, U32& index);
+
+        ValueSpan span(size_t index) const;
+
+        /// <summary>
+        /// Replaces every list with nr ranges into size elements,
+        /// as returned by ranges and data.
+        /// </summary>
+        void assign(const ListRange*  ranges,
+                    size_t            nr,
+                    const Math::Real* data,
+                    size_t            size);
+
+        const ListRanges& ranges() const;
+
+        const ValueList& data() const;
+
+        size_t size() const;
+
+        size_t capacity() const;
+    };
+
+    inline void ListStorage::reset()
+    {
+        _data.resizeFast(0);
+        _ranges.resizeFast(0);
+    }
+
+    inline size_t ListStorage::size() const
+    {
+        return _ranges.size();
+    }
+
+    inline const ListRanges& ListStorage::ranges() const
+    {
+        return _ranges;
+    }
+
+    inline const ValueList& ListStorage::data() const
+    {
+        return _data;
+    }
+
+    inline size_t ListStorage::capacity() const
+    {
+        return _data.capacity();
+    }
+
+    inline ValueSpan ListStorage::span(const size_t index) const
+    {
+        if (index < _ranges.size())
+        {
+            const auto& [offset, size] = _ranges[index];
+            return {_data.data() + offset, size};
+        }
+        return {};
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,295 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/Metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace Rt2::Eq
+{
+    namespace
+    {
+        std::atomic<Metrics*> Installed{nullptr};
+        std::atomic<U32>      NextShard{0};
+
+        U32 highBit(U64 v)
+        {
+            U32 r = 0;
+            while (v >>= 1)
+                ++r;
+            return r;
+        }
+
+        const char* const CounterNames[CountMax] = {
+            "compile_total",
+            "program_bytes_total",
+            "execute_total",
+            "execute_failures_total",
+            "recompute_total",
+            "cache_hits_total",
+            "cache_misses_total",
+            "list_bytes_total",
+        };
+
+        const char* const CounterKeys[CountMax] = {
+            "compiles",
+            "programBytes",
+            "executes",
+            "executeFailures",
+            "recomputes",
+            "cacheHits",
+            "cacheMisses",
+            "listBytes",
+        };
+
+        constexpr double Quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+        void textLatency(OStream& out, const char* name, const LatencySnapshot& latency)
+        {
+            for (const double q : Quantiles)
+            {
+                out << "expression_" << name << "_latency_ns{quantile=\"" << q << "\"} "
+                    << latency.percentile(q) << '\n';
+            }
+            out << "expression_" << name << "_latency_ns_sum " << latency.sum << '\n';
+            out << "expression_" << name << "_latency_ns_count " << latency.count << '\n';
+            out << "expression_" << name << "_latency_ns_max " << latency.max << '\n';
+        }
+
+        void jsonLatency(OStream& out, const LatencySnapshot& latency)
+        {
+            out << "{\"count\":" << latency.count
+                << ",\"sumNs\":" << latency.sum
+                << ",\"maxNs\":" << latency.max
+                << ",\"p50Ns\":" << latency.percentile(0.5)
+                << ",\"p90Ns\":" << latency.percentile(0.9)
+                << ",\"p99Ns\":" << latency.percentile(0.99)
+                << ",\"p999Ns\":" << latency.percentile(0.999) << '}';
+        }
+    }  // namespace
+
+    size_t latencyBucket(const U64 nanoseconds)
+    {
+        if (nanoseconds < LatencySubBuckets)
+            return (size_t)nanoseconds;
+
+        const U32    shift = highBit(nanoseconds) - LatencySubBits;
+        const size_t idx   = (size_t)(shift + 1) * LatencySubBuckets +
+                           (size_t)((nanoseconds >> shift) - LatencySubBuckets);
+        return std::min(idx, LatencyBuckets - 1);
+    }
+
+    U64 latencyBucketLimit(const size_t bucket)
+    {
+        if (bucket < LatencySubBuckets)
+            return bucket;
+
+        const U32 shift = U32(bucket / LatencySubBuckets) - 1;
+        const U64 first = U64(LatencySubBuckets + bucket % LatencySubBuckets) << shift;
+        return first + ((U64(1) << shift) - 1);
+    }
+
+    U64 LatencySnapshot::percentile(const double q) const
+    {
+        if (count == 0)
+            return 0;
+
+        const U64 rank = std::max<U64>(1, (U64)std::ceil(std::clamp(q, 0.0, 1.0) * double(count)));
+
+        U64 seen = 0;
+        for (size_t i = 0; i < LatencyBuckets; ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+                return std::min(latencyBucketLimit(i), max);
+        }
+        return max;
+    }
+
+    double LatencySnapshot::mean() const
+    {
+        return count > 0 ? double(sum) / double(count) : 0.0;
+    }
+
+    LatencyHistogram::LatencyHistogram()
+    {
+        reset();
+    }
+
+    void LatencyHistogram::record(const U64 nanoseconds)
+    {
+        _buckets[latencyBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+        U64 max = _max.load(std::memory_order_relaxed);
+        while (nanoseconds > max &&
+               !_max.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void LatencyHistogram::reset()
+    {
+        for (std::atomic<U64>& b : _buckets)
+            b.store(0, std::memory_order_relaxed);
+        _count.store(0, std::memory_order_relaxed);
+        _sum.store(0, std::memory_order_relaxed);
+        _max.store(0, std::memory_order_relaxed);
+    }
+
+    void LatencyHistogram::merge(LatencySnapshot& dest) const
+    {
+        for (size_t i = 0; i < LatencyBuckets; ++i)
+            dest.buckets[i] += _buckets[i].load(std::memory_order_relaxed);
+        dest.count += _count.load(std::memory_order_relaxed);
+        dest.sum += _sum.load(std::memory_order_relaxed);
+        dest.max = std::max(dest.max, _max.load(std::memory_order_relaxed));
+    }
+
+    void MetricsSnapshot::text(OStream& out) const
+    {
+        for (size_t i = 0; i < CountMax; ++i)
+            out << "expression_" << CounterNames[i] << ' ' << counters[i] << '\n';
+        textLatency(out, "compile", compile);
+        textLatency(out, "execute", execute);
+        textLatency(out, "recompute", recompute);
+    }
+
+    void MetricsSnapshot::json(OStream& out) const
+    {
+        out << '{';
+        for (size_t i = 0; i < CountMax; ++i)
+            out << '"' << CounterKeys[i] << "\":" << counters[i] << ',';
+        out << "\"compile\":";
+        jsonLatency(out, compile);
+        out << ",\"execute\":";
+        jsonLatency(out, execute);
+        out << ",\"recompute\":";
+        jsonLatency(out, recompute);
+        out << '}';
+    }
+
+    MetricsShard::MetricsShard()
+    {
+        for (std::atomic<U64>& c : _counters)
+            c.store(0, std::memory_order_relaxed);
+    }
+
+    void MetricsShard::compiled(const U64 nanoseconds, const U64 bytes)
+    {
+        add(CountCompile, 1);
+        add(CountProgramBytes, bytes);
+        _compile.record(nanoseconds);
+    }
+
+    void MetricsShard::executed(const U64 nanoseconds, const bool ok, const U64 listBytes)
+    {
+        add(CountExecute, 1);
+        if (!ok)
+            add(CountExecuteFailure, 1);
+        if (listBytes > 0)
+            add(CountListBytes, listBytes);
+        _execute.record(nanoseconds);
+    }
+
+    void MetricsShard::recomputed(const U64 nanoseconds, const U64 hits, const U64 misses)
+    {
+        add(CountRecompute, 1);
+        add(CountCacheHit, hits);
+        add(CountCacheMiss, misses);
+        _recompute.record(nanoseconds);
+    }
+
+    void Metrics::install(Metrics* metrics)
+    {
+        Installed.store(metrics, std::memory_order_release);
+    }
+
+    Metrics* Metrics::installed()
+    {
+        return Installed.load(std::memory_order_acquire);
+    }
+
+    MetricsShard* Metrics::shard()
+    {
+        if (Metrics* metrics = Installed.load(std::memory_order_acquire))
+            return &metrics->local();
+        return nullptr;
+    }
+
+    U64 Metrics::now()
+    {
+        return (U64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    MetricsShard& Metrics::local()
+    {
+        // Threads are dealt shards round robin on first use. With more
+        // threads than shards some share one, which the atomic adds
+        // keep correct at the cost of contention.
+        thread_local const U32 index = NextShard.fetch_add(1, std::memory_order_relaxed) % ShardCount;
+        return _shards[index];
+    }
+
+    void Metrics::snapshot(MetricsSnapshot& dest) const
+    {
+        dest = {};
+        for (const MetricsShard& shard : _shards)
+        {
+            for (size_t i = 0; i < CountMax; ++i)
+                dest.counters[i] += shard._counters[i].load(std::memory_order_relaxed);
+            shard._compile.merge(dest.compile);
+            shard._execute.merge(dest.execute);
+            shard._recompute.merge(dest.recompute);
+        }
+    }
+
+    void Metrics::reset()
+    {
+        for (MetricsShard& shard : _shards)
+        {
+            for (std::atomic<U64>& c : shard._counters)
+                c.store(0, std::memory_order_relaxed);
+            shard._compile.reset();
+            shard._execute.reset();
+            shard._recompute.reset();
+        }
+    }
+
+    void Metrics::text(OStream& out) const
+    {
+        MetricsSnapshot snap;
+        snapshot(snap);
+        snap.text(out);
+    }
+
+    void Metrics::json(OStream& out) const
+    {
+        MetricsSnapshot snap;
+        snapshot(snap);
+        snap.json(out);
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,230 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include <atomic>
+#include "Utils/Definitions.h"
+#include "Utils/String.h"
+
+namespace Rt2::Eq
+{
+    /// <summary>
+    /// Log-linear bucketing of nanosecond latencies. Values below
+    /// LatencySubBuckets have a bucket each; above that every power
+    /// of two is split into LatencySubBuckets equal buckets, which
+    /// bounds the error of a reported value to about six percent.
+    /// </summary>
+    constexpr U32    LatencySubBits    = 4;
+    constexpr U32    LatencySubBuckets = 1 << LatencySubBits;
+    constexpr U32    LatencyMaxBits    = 42;  // about 73 minutes
+    constexpr size_t LatencyBuckets    = LatencySubBuckets * (LatencyMaxBits - LatencySubBits + 1);
+
+    size_t latencyBucket(U64 nanoseconds);
+
+    /// <summary>
+    /// The largest value that falls in a bucket.
+    /// </summary>
+    U64 latencyBucketLimit(size_t bucket);
+
+    /// <summary>
+    /// Merged, plain copy of the latency histograms of every shard.
+    /// </summary>
+    struct LatencySnapshot
+    {
+        U64 buckets[LatencyBuckets]{};
+        U64 count{0};
+        U64 sum{0};
+        U64 max{0};
+
+        /// <summary>
+        /// The latency at or below which the fraction q
+        /// of the samples fall, for q in [0, 1].
+        /// </summary>
+        U64 percentile(double q) const;
+
+        double mean() const;
+    };
+
+    /// <summary>
+    /// Latency histogram that is safe to update from several threads
+    /// and to read while it is updated. Updates are relaxed atomic
+    /// adds, so a read may see a sample in some fields and not yet
+    /// in others.
+    /// </summary>
+    class LatencyHistogram
+    {
+    private:
+        std::atomic<U64> _buckets[LatencyBuckets];
+        std::atomic<U64> _count;
+        std::atomic<U64> _sum;
+        std::atomic<U64> _max;
+
+    public:
+        LatencyHistogram();
+
+        void record(U64 nanoseconds);
+
+        void reset();
+
+        /// <summary>
+        /// Adds the histogram to dest.
+        /// </summary>
+        void merge(LatencySnapshot& dest) const;
+    };
+
+    enum MetricsCounter
+    {
+        CountCompile,
+        CountProgramBytes,
+        CountExecute,
+        CountExecuteFailure,
+        CountRecompute,
+        CountCacheHit,
+        CountCacheMiss,
+        CountListBytes,
+        CountMax,
+    };
+
+    /// <summary>
+    /// Plain copy of a Metrics registry, merged over its shards.
+    /// </summary>
+    struct MetricsSnapshot
+    {
+        U64             counters[CountMax]{};
+        LatencySnapshot compile;
+        LatencySnapshot execute;
+        LatencySnapshot recompute;
+
+        U64 operator[](MetricsCounter counter) const;
+
+        /// <summary>
+        /// Writes one 'name value' line per metric, with latency
+        /// quantiles labeled in the Prometheus text style.
+        /// </summary>
+        void text(OStream& out) const;
+
+        void json(OStream& out) const;
+    };
+
+    /// <summary>
+    /// The counters and histograms that one thread records into.
+    /// Shards are cache line aligned so that threads on different
+    /// shards do not share lines.
+    /// </summary>
+    class alignas(64) MetricsShard
+    {
+    private:
+        std::atomic<U64> _counters[CountMax];
+        LatencyHistogram _compile;
+        LatencyHistogram _execute;
+        LatencyHistogram _recompute;
+
+        friend class Metrics;
+
+        void add(MetricsCounter counter, U64 value);
+
+    public:
+        MetricsShard();
+
+        /// <summary>
+        /// Records a Program build and the bytes of code and
+        /// constants that it produced.
+        /// </summary>
+        void compiled(U64 nanoseconds, U64 bytes);
+
+        /// <summary>
+        /// Records an ExecutionContext::execute, and the growth
+        /// in bytes of its list storage.
+        /// </summary>
+        void executed(U64 nanoseconds, bool ok, U64 listBytes);
+
+        /// <summary>
+        /// Records an incremental ExecutionContext::recompute, where
+        /// hits are the statements whose cached values were kept and
+        /// misses the statements that were evaluated. Its latency is
+        /// kept apart from the full executes.
+        /// </summary>
+        void recomputed(U64 nanoseconds, U64 hits, U64 misses);
+    };
+
+    /// <summary>
+    /// Registry of compile and execute metrics. Recording is lock free:
+    /// each thread writes to one of a fixed set of shards and readers
+    /// merge the shards. Nothing is recorded until a registry is
+    /// installed, and with none installed the cost of the hooks is one
+    /// atomic load per compile or execute.
+    /// </summary>
+    class Metrics
+    {
+    public:
+        static constexpr size_t ShardCount = 16;
+
+    private:
+        MetricsShard _shards[ShardCount];
+
+    public:
+        Metrics() = default;
+
+        Metrics(const Metrics&)            = delete;
+        Metrics& operator=(const Metrics&) = delete;
+
+        /// <summary>
+        /// Makes metrics the registry that compiles and executes in
+        /// this process record into, or stops recording when it is
+        /// null. The registry must outlive its installation.
+        /// </summary>
+        static void install(Metrics* metrics);
+
+        static Metrics* installed();
+
+        /// <summary>
+        /// The calling thread's shard of the installed
+        /// registry, or null when none is installed.
+        /// </summary>
+        static MetricsShard* shard();
+
+        /// <summary>
+        /// Monotonic time in nanoseconds.
+        /// </summary>
+        static U64 now();
+
+        MetricsShard& local();
+
+        void snapshot(MetricsSnapshot& dest) const;
+
+        void reset();
+
+        void text(OStream& out) const;
+
+        void json(OStream& out) const;
+    };
+
+    inline U64 MetricsSnapshot::operator[](const MetricsCounter counter) const
+    {
+        return counters[counter];
+    }
+
+    inline void MetricsShard::add(const MetricsCounter counter, const U64 value)
+    {
+        _counters[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+
+}  // namespace Rt2::Eq
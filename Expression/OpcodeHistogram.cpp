@@ -0,0 +1,161 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/OpcodeHistogram.h"
+#include <algorithm>
+#include <iomanip>
+
+namespace Rt2::Eq
+{
+    void OpcodeHistogram::bump(OpcodeTable& table, const U32 key)
+    {
+        if (const size_t idx = table.find(key); idx != Npos)
+            ++table.at(idx);
+        else
+            table.insert(key, 1);
+    }
+
+    U64 OpcodeHistogram::lookup(const OpcodeTable& table, const U32 key)
+    {
+        if (const size_t idx = table.find(key); idx != Npos)
+            return table.at(idx);
+        return 0;
+    }
+
+    void OpcodeHistogram::sorted(const OpcodeTable& table, OpcodeCounts& dest)
+    {
+        dest.resizeFast(0);
+        for (const auto& [key, count] : table)
+            dest.push_back({key, count});
+
+        std::sort(dest.data(),
+                  dest.data() + dest.size(),
+                  [](const OpcodeCount& a, const OpcodeCount& b)
+                  {
+                      return a.count != b.count ? a.count > b.count : a.key < b.key;
+                  });
+    }
+
+    void OpcodeHistogram::add(const Program& program)
+    {
+        const InstructionArray& code = program.code();
+
+        for (size_t i = 0; i < code.size(); ++i)
+        {
+            const U32 a = code[i].op;
+            ++_ops[a];
+
+            if (i + 1 < code.size())
+            {
+                const U32 b = code[i + 1].op;
+                bump(_pairs, a << 8 | b);
+
+                if (i + 2 < code.size())
+                    bump(_triples, a << 16 | b << 8 | code[i + 2].op);
+            }
+        }
+
+        _total += code.size();
+        _fused += program.fused().size();
+    }
+
+    void OpcodeHistogram::clear()
+    {
+        for (U64& c : _ops)
+            c = 0;
+        _pairs.clear();
+        _triples.clear();
+        _total = 0;
+        _fused = 0;
+    }
+
+    U64 OpcodeHistogram::count(const U8 a, const U8 b) const
+    {
+        return lookup(_pairs, U32(a) << 8 | b);
+    }
+
+    U64 OpcodeHistogram::count(const U8 a, const U8 b, const U8 c) const
+    {
+        return lookup(_triples, U32(a) << 16 | U32(b) << 8 | c);
+    }
+
+    void OpcodeHistogram::runs(const size_t length, OpcodeCounts& dest) const
+    {
+        sorted(length == 3 ? _triples : _pairs, dest);
+    }
+
+    void OpcodeHistogram::print(OStream& out, const size_t limit) const
+    {
+        const auto percent = [this](const U64 n)
+        {
+            return _total > 0 ? 100.0 * double(n) / double(_total) : 0.0;
+        };
+
+        const auto flags = out.flags();
+
+        out << "instructions " << _total << ", fused " << _fused
+            << std::fixed << std::setprecision(1)
+            << " (" << percent(_total - _fused) << "% fewer dispatches)\n";
+
+        OpcodeCounts ops;
+        for (U32 op = 0; op < 256; ++op)
+        {
+            if (_ops[op] > 0)
+                ops.push_back({op, _ops[op]});
+        }
+        std::sort(ops.data(),
+                  ops.data() + ops.size(),
+                  [](const OpcodeCount& a, const OpcodeCount& b)
+                  {
+                      return a.count > b.count;
+                  });
+
+        OpcodeCounts runs;
+        for (size_t length = 1; length <= 3; ++length)
+        {
+            const OpcodeCounts* src = &ops;
+            if (length > 1)
+            {
+                sorted(length == 3 ? _triples : _pairs, runs);
+                src = &runs;
+            }
+
+            out << (length == 1 ? "opcodes" : length == 2 ? "pairs" : "triples") << '\n';
+            for (size_t i = 0; i < src->size() && i < limit; ++i)
+            {
+                const OpcodeCount& e = (*src)[i];
+
+                String name;
+                for (size_t k = length; k-- > 0;)
+                {
+                    if (!name.empty())
+                        name.push_back(' ');
+                    name += opcodeName(U8(e.key >> (8 * k)));
+                }
+                out << "  " << std::left << std::setw(28) << name
+                    << std::right << std::setw(10) << e.count
+                    << std::setw(7) << percent(e.count) << "%\n";
+            }
+        }
+        out.flags(flags);
+    }
+
+}  // namespace Rt2::Eq
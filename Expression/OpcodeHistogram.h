@@ -0,0 +1,112 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Expression/Program.h"
+#include "Utils/HashMap.h"
+
+namespace Rt2::Eq
+{
+    /// <summary>
+    /// A run of up to three opcodes, packed one per byte
+    /// with the first in the highest, and its count.
+    /// </summary>
+    struct OpcodeCount
+    {
+        U32 key{0};
+        U64 count{0};
+    };
+
+    using OpcodeCounts = SimpleArray<OpcodeCount>;
+    using OpcodeTable  = HashTable<U32, U64>;
+
+    /// <summary>
+    /// Counts opcodes, and adjacent pairs and triples of opcodes, in
+    /// the code of any number of programs. The most frequent runs are
+    /// the candidates for superinstructions, and comparing the length
+    /// of the fused code with the reference code measures how many
+    /// dispatches the chosen ones save.
+    /// </summary>
+    class OpcodeHistogram
+    {
+    private:
+        U64         _ops[256]{};
+        OpcodeTable _pairs;
+        OpcodeTable _triples;
+        U64         _total{0};
+        U64         _fused{0};
+
+        static void bump(OpcodeTable& table, U32 key);
+
+        static U64 lookup(const OpcodeTable& table, U32 key);
+
+        static void sorted(const OpcodeTable& table, OpcodeCounts& dest);
+
+    public:
+        OpcodeHistogram() = default;
+
+        void add(const Program& program);
+
+        void clear();
+
+        /// <summary>
+        /// The number of instructions in the reference code.
+        /// </summary>
+        U64 total() const;
+
+        /// <summary>
+        /// The number of instructions in the fused code.
+        /// </summary>
+        U64 fused() const;
+
+        U64 count(U8 op) const;
+
+        U64 count(U8 a, U8 b) const;
+
+        U64 count(U8 a, U8 b, U8 c) const;
+
+        /// <summary>
+        /// Runs of length two or three, most frequent first.
+        /// </summary>
+        void runs(size_t length, OpcodeCounts& dest) const;
+
+        /// <summary>
+        /// Writes the limit most frequent opcodes, pairs and triples.
+        /// </summary>
+        void print(OStream& out, size_t limit = 10) const;
+    };
+
+    inline U64 OpcodeHistogram::total() const
+    {
+        return _total;
+    }
+
+    inline U64 OpcodeHistogram::fused() const
+    {
+        return _fused;
+    }
+
+    inline U64 OpcodeHistogram::count(const U8 op) const
+    {
+        return _ops[op];
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,164 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include <cmath>
+#include <limits>
+#include "Math/Scalar.h"
+
+namespace Rt2::Eq
+{
+    // Scalar operator bodies shared by every evaluator, so that
+    // the scalar, list and batch paths agree on edge cases.
+    // Each is templated on the scalar type of the evaluator.
+
+    struct AddOp
+    {
+        template <typename T>
+        T operator()(const T a, const T b) const { return a + b; }
+    };
+
+    struct SubOp
+    {
+        template <typename T>
+        T operator()(const T a, const T b) const { return a - b; }
+    };
+
+    struct MulOp
+    {
+        template <typename T>
+        T operator()(const T a, const T b) const { return a * b; }
+    };
+
+    // The zero divisor threshold is the double epsilon in every
+    // precision, so that both precisions reject the same divisors.
+    struct DivOp
+    {
+        template <typename T>
+        T operator()(const T a, const T b) const
+        {
+            return std::abs(b) > T(std::numeric_limits<double>::epsilon()) ? a * (T(1) / b) : T(NAN);
+        }
+    };
+
+    struct ModOp
+    {
+        template <typename T>
+        T operator()(const T a, const T b) const { return std::fmod(a, b); }
+    };
+
+    struct PowOp
+    {
+        template <typename T>
+        T operator()(const T a, const T b) const { return std::pow(a, b); }
+    };
+
+    struct NegOp
+    {
+        template <typename T>
+        T operator()(const T a) const { return -a; }
+    };
+
+    // Comparisons and logical operators yield 1 or 0 and are
+    // written without branches, so lane loops compile to vector
+    // compares. Any value other than zero is true.
+
+    struct LessOp
+    {
+        template <typename T>
+        T operator()(const T a, const T b) const { return T(a < b); }
+    };
+
+    struct LessEqualOp
+    {
+        template <typename T>
+        T operator()(const T a, const T b) const { return T(a <= b); }
+    };
+
+    struct GreaterOp
+    {
+        template <typename T>
+        T operator()(const T a, const T b) const { return T(a > b); }
+    };
+
+    struct GreaterEqualOp
+    {
+        template <typename T>
+        T operator()(const T a, const T b) const { return T(a >= b); }
+    };
+
+    struct EqualOp
+    {
+        template <typename T>
+        T operator()(const T a, const T b) const { return T(a == b); }
+    };
+
+    struct NotEqualOp
+    {
+        template <typename T>
+        T operator()(const T a, const T b) const { return T(a != b); }
+    };
+
+    struct AndOp
+    {
+        template <typename T>
+        T operator()(const T a, const T b) const { return T((a != 0) & (b != 0)); }
+    };
+
+    struct OrOp
+    {
+        template <typename T>
+        T operator()(const T a, const T b) const { return T((a != 0) | (b != 0)); }
+    };
+
+    struct NotOp
+    {
+        template <typename T>
+        T operator()(const T a) const { return T(a == 0); }
+    };
+
+    struct BitwiseNotOp
+    {
+        // the complement of the integer part; NaN where that
+        // does not fit in 63 bits
+        template <typename T>
+        T operator()(const T a) const
+        {
+            return std::abs(a) < T(4.6e18) ? T(~I64(a)) : T(NAN);
+        }
+    };
+
+    struct SelectOp
+    {
+        // both operands are already evaluated, so this is
+        // a blend rather than a branch
+        template <typename T>
+        T operator()(const T c, const T a, const T b) const { return c != 0 ? a : b; }
+    };
+
+    template <typename T>
+    T lMod(const T a, const T b)
+    {
+        const T r = std::remainder(a, b);
+        return r < 0 ? b + r : r;
+    }
+
+}  // namespace Rt2::Eq
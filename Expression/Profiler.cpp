@@ -0,0 +1,261 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include "Expression/Program.h"
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+namespace Rt2::Eq
+{
+    namespace
+    {
+        // opcodes that ran, most expensive first
+        SimpleArray<U8> ranked(const OpcodeProfile* ops)
+        {
+            SimpleArray<U8> order;
+            for (U32 op = 0; op < 256; ++op)
+            {
+                if (ops[op].count > 0)
+                    order.push_back(U8(op));
+            }
+            std::sort(order.data(),
+                      order.data() + order.size(),
+                      [ops](const U8 a, const U8 b)
+                      {
+                          return ops[a].cycles != ops[b].cycles
+                                     ? ops[a].cycles > ops[b].cycles
+                                     : a < b;
+                      });
+            return order;
+        }
+    }  // namespace
+
+    U64 Profiler::now()
+    {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return (U64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+#endif
+    }
+
+    void Profiler::attach(const size_t instructions)
+    {
+        _instructions.resizeFast(instructions);
+        for (OpcodeProfile& p : _instructions)
+            p = {};
+    }
+
+    void Profiler::reset()
+    {
+        for (OpcodeProfile& p : _ops)
+            p = {};
+        for (OpcodeProfile& p : _instructions)
+            p = {};
+        _executions = 0;
+        _stackHigh  = 0;
+    }
+
+    void Profiler::merge(const Profiler& other)
+    {
+        for (size_t i = 0; i < 256; ++i)
+        {
+            _ops[i].count += other._ops[i].count;
+            _ops[i].cycles += other._ops[i].cycles;
+        }
+
+        // profilers of the same program have the same size
+        const size_t nr = std::min(_instructions.size(), other._instructions.size());
+        for (size_t i = 0; i < nr; ++i)
+        {
+            _instructions[i].count += other._instructions[i].count;
+            _instructions[i].cycles += other._instructions[i].cycles;
+        }
+        _executions += other._executions;
+        _stackHigh = std::max(_stackHigh, other._stackHigh);
+    }
+
+    U64 Profiler::count() const
+    {
+        U64 r = 0;
+        for (const OpcodeProfile& p : _ops)
+            r += p.count;
+        return r;
+    }
+
+    U64 Profiler::cycles() const
+    {
+        U64 r = 0;
+        for (const OpcodeProfile& p : _ops)
+            r += p.cycles;
+        return r;
+    }
+
+    OpcodeProfile Profiler::statement(const Program& program, const size_t index) const
+    {
+        OpcodeProfile r;
+
+        const StatementRange& range = program.graph().statement(index);
+        for (U32 i = range.first; i < range.last && i < _instructions.size(); ++i)
+        {
+            r.count += _instructions[i].count;
+            r.cycles += _instructions[i].cycles;
+        }
+        return r;
+    }
+
+    void Profiler::print(OStream& out) const
+    {
+        const auto flags = out.flags();
+        const U64  total = std::max<U64>(cycles(), 1);
+
+        out << "executions " << _executions
+            << ", instructions " << count()
+            << ", cycles " << cycles()
+            << ", stack high-water " << _stackHigh << '\n';
+
+        out << "  " << std::left << std::setw(16) << "opcode"
+            << std::right << std::setw(12) << "count"
+            << std::setw(16) << "cycles"
+            << std::setw(10) << "cyc/op"
+            << std::setw(8) << "share" << '\n';
+
+        out << std::fixed;
+        for (const U8 op : ranked(_ops))
+        {
+            const OpcodeProfile& p = _ops[op];
+            out << "  " << std::left << std::setw(16) << opcodeName(op)
+                << std::right << std::setw(12) << p.count
+                << std::setw(16) << p.cycles
+                << std::setprecision(1)
+                << std::setw(10) << double(p.cycles) / double(p.count)
+                << std::setw(7) << 100.0 * double(p.cycles) / double(total) << "%\n";
+        }
+        out.flags(flags);
+    }
+
+    void Profiler::json(OStream& out) const
+    {
+        out << "{\"executions\":" << _executions
+            << ",\"instructions\":" << count()
+            << ",\"cycles\":" << cycles()
+            << ",\"stackHighWater\":" << _stackHigh
+            << ",\"opcodes\":[";
+
+        bool first = true;
+        for (const U8 op : ranked(_ops))
+        {
+            if (!first)
+                out << ',';
+            first = false;
+
+            const OpcodeProfile& p = _ops[op];
+            out << "{\"op\":\"" << opcodeName(op)
+                << "\",\"code\":" << U32(op)
+                << ",\"count\":" << p.count
+                << ",\"cycles\":" << p.cycles << '}';
+        }
+        out << "]}";
+    }
+
+    void Profiler::listing(OStream&       out,
+                           const Program& program,
+                           const String&  source) const
+    {
+        // totals per source line, where index zero
+        // collects the instructions without one
+        OpcodeProfiles    lines;
+        const IndexArray& origin = program.lines();
+        const size_t      nr     = std::min(origin.size(), _instructions.size());
+
+        for (size_t i = 0; i < nr; ++i)
+        {
+            if (origin[i] >= lines.size())
+            {
+                const size_t first = lines.size();
+                lines.resizeFast((size_t)origin[i] + 1);
+                for (size_t j = first; j < lines.size(); ++j)
+                    lines[j] = {};
+            }
+            lines[origin[i]].count += _instructions[i].count;
+            lines[origin[i]].cycles += _instructions[i].cycles;
+        }
+
+        const auto flags = out.flags();
+        const U64  total = std::max<U64>(cycles(), 1);
+
+        out << std::right << std::setw(12) << "count"
+            << std::setw(16) << "cycles"
+            << std::setw(8) << "share"
+            << std::setw(6) << "line" << '\n';
+        out << std::fixed << std::setprecision(1);
+
+        size_t line  = 1;
+        size_t first = 0;
+        for (size_t i = 0; i <= source.size(); ++i)
+        {
+            if (i < source.size() && source[i] != '\n')
+                continue;
+            if (i == source.size() && i == first && i > 0)
+                break;
+
+            size_t last = i;
+            if (last > first && source[last - 1] == '\r')
+                --last;
+
+            if (line < lines.size() && lines[line].count > 0)
+            {
+                const OpcodeProfile& p = lines[line];
+                out << std::setw(12) << p.count
+                    << std::setw(16) << p.cycles
+                    << std::setw(7) << 100.0 * double(p.cycles) / double(total) << '%';
+            }
+            else
+                out << std::setw(36) << ' ';
+
+            out << std::setw(6) << line << "  ";
+            out.write(source.c_str() + first, (std::streamsize)(last - first));
+            out << '\n';
+
+            first = i + 1;
+            ++line;
+        }
+
+        if (!lines.empty() && lines[0].count > 0)
+        {
+            out << std::setw(12) << lines[0].count
+                << std::setw(16) << lines[0].cycles
+                << std::setw(7) << 100.0 * double(lines[0].cycles) / double(total) << '%'
+                << std::setw(6) << '-' << "  (no source line)\n";
+        }
+        out.flags(flags);
+    }
+
+}  // namespace Rt2::Eq
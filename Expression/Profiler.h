@@ -0,0 +1,183 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Utils/Definitions.h"
+#include "Utils/Array.h"
+#include "Utils/String.h"
+
+namespace Rt2::Eq
+{
+    class Program;
+
+    /// <summary>
+    /// Totals for one opcode.
+    /// </summary>
+    struct OpcodeProfile
+    {
+        U64 count{0};
+        U64 cycles{0};
+    };
+
+    using OpcodeProfiles = SimpleArray<OpcodeProfile>;
+
+    /// <summary>
+    /// Per-opcode execution counts and cycle totals, and the stack
+    /// high-water mark, of the instructions an ExecutionContext
+    /// dispatches. The same totals are kept per instruction of
+    /// Program::code, which attributes them to source lines and
+    /// statements. The context only carries one, and only pays for
+    /// the time stamps, when the library is built with
+    /// Expression_PROFILE defined; otherwise none of it is compiled in.
+    ///
+    /// Cycles are time stamp counter ticks on x86 and nanoseconds
+    /// elsewhere. Each sample includes the cost of reading the
+    /// counter, so compare opcodes with each other rather than
+    /// reading the totals as absolute times.
+    /// </summary>
+    class Profiler
+    {
+    private:
+        OpcodeProfile  _ops[256];
+        OpcodeProfiles _instructions;
+        U64            _executions{0};
+        size_t         _stackHigh{0};
+
+    public:
+        Profiler() = default;
+
+        static U64 now();
+
+        /// <summary>
+        /// Sizes the per-instruction totals for a program
+        /// with the given number of instructions in its code.
+        /// </summary>
+        void attach(size_t instructions);
+
+        void begin();
+
+        /// <summary>
+        /// Records one dispatch of op, where origin is the index in
+        /// Program::code of the instruction that it executes.
+        /// </summary>
+        void record(U8 op, U32 origin, U64 cycles, size_t depth);
+
+        void reset();
+
+        /// <summary>
+        /// Adds the totals of another profiler, e.g.
+        /// to combine the contexts of several threads.
+        /// </summary>
+        void merge(const Profiler& other);
+
+        const OpcodeProfile& opcode(U8 op) const;
+
+        /// <summary>
+        /// The totals of an instruction in Program::code. A fused
+        /// instruction is charged to the last one that it replaces.
+        /// </summary>
+        const OpcodeProfile& instruction(U32 index) const;
+
+        const OpcodeProfiles& instructions() const;
+
+        /// <summary>
+        /// The totals of a top-level statement of the program,
+        /// see DependencyGraph::statement.
+        /// </summary>
+        OpcodeProfile statement(const Program& program, size_t index) const;
+
+        /// <summary>
+        /// The number of executions started since the last reset.
+        /// </summary>
+        U64 executions() const;
+
+        size_t stackHighWater() const;
+
+        U64 count() const;
+
+        U64 cycles() const;
+
+        /// <summary>
+        /// A table of the opcodes that ran, most expensive first.
+        /// </summary>
+        void print(OStream& out) const;
+
+        /// <summary>
+        /// The same report as a JSON object.
+        /// </summary>
+        void json(OStream& out) const;
+
+        /// <summary>
+        /// Writes the source of the program with each line prefixed by
+        /// the instructions executed and the cycles spent on it, and
+        /// its share of all cycles.
+        /// </summary>
+        void listing(OStream& out, const Program& program, const String& source) const;
+    };
+
+    inline void Profiler::begin()
+    {
+        ++_executions;
+    }
+
+    inline void Profiler::record(const U8     op,
+                                 const U32    origin,
+                                 const U64    cycles,
+                                 const size_t depth)
+    {
+        OpcodeProfile& p = _ops[op];
+        ++p.count;
+        p.cycles += cycles;
+
+        OpcodeProfile& i = _instructions[origin];
+        ++i.count;
+        i.cycles += cycles;
+
+        if (depth > _stackHigh)
+            _stackHigh = depth;
+    }
+
+    inline const OpcodeProfile& Profiler::opcode(const U8 op) const
+    {
+        return _ops[op];
+    }
+
+    inline const OpcodeProfile& Profiler::instruction(const U32 index) const
+    {
+        return _instructions[index];
+    }
+
+    inline const OpcodeProfiles& Profiler::instructions() const
+    {
+        return _instructions;
+    }
+
+    inline U64 Profiler::executions() const
+    {
+        return _executions;
+    }
+
+    inline size_t Profiler::stackHighWater() const
+    {
+        return _stackHigh;
+    }
+
+}  // namespace Rt2::Eq
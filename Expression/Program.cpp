@@ -0,0 +1,482 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/Program.h"
+#include <atomic>
+#include <cmath>
+#include "Expression/Metrics.h"
+
+namespace Rt2::Eq
+{
+    U32 SlotTable::insert(const String& name)
+    {
+        if (const size_t idx = _lookup.find(name);
+            idx != Npos)
+            return _lookup.at(idx);
+
+        const U32 slot = (U32)_names.size();
+        _lookup.insert(name, slot);
+        _names.push_back(name);
+        return slot;
+    }
+
+    size_t SlotTable::find(const String& name) const
+    {
+        if (const size_t idx = _lookup.find(name);
+            idx != Npos)
+            return _lookup.at(idx);
+        return Npos;
+    }
+
+    ProgramPtr Program::compile(const SymbolArray& symbols, const Precision precision)
+    {
+        const auto program  = std::make_shared<Program>();
+        program->_precision = precision;
+        program->build(symbols);
+        return program;
+    }
+
+    ProgramPtr Program::compile(const SymbolArray&      symbols,
+                                const FunctionRegistry& functions,
+                                const Precision         precision)
+    {
+        const auto program  = std::make_shared<Program>();
+        program->_precision = precision;
+        program->_registry  = &functions;
+        program->build(symbols);
+        program->_registry = nullptr;
+        return program;
+    }
+
+    U64 Program::nextId()
+    {
+        static std::atomic<U64> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Program::build(const SymbolArray& symbols)
+    {
+        MetricsShard* metrics = Metrics::shard();
+        const U64     start   = metrics ? Metrics::now() : 0;
+
+        // The slot table is intentionally kept so that
+        // a rebuild extends the existing layout.
+        _code.resizeFast(0);
+        _lines.resizeFast(0);
+        _constants.resizeFast(0);
+        _lists.reset();
+        _functions.resizeFast(0);
+        if (_registry)
+            _functions = _registry->functions();
+        _code.reserve(symbols.size());
+        _lines.reserve(symbols.size());
+
+        for (const Symbol* sy : symbols)
+        {
+            if (sy->type() == Grouping && foldList())
+                continue;
+
+            Instruction ins;
+            ins.op = (U8)sy->type();
+
+            switch (sy->type())
+            {
+            case Numerical:
+                ins.arg = (U32)_constants.size();
+                _constants.push_back(sy->value());
+                break;
+            case Identifier:
+                ins.arg = _slots.insert(sy->name());
+                break;
+            case UserFunction:
+                ins.arg = function(sy->name());
+                break;
+            default:
+                break;
+            }
+            _code.push_back(ins);
+            _lines.push_back((U32)std::max(sy->line(), 0));
+        }
+        analyze();
+        fuse();
+
+        _constantsF.resizeFast(_constants.size());
+        for (size_t i = 0; i < _constants.size(); ++i)
+            _constantsF[i] = float(_constants[i]);
+
+        if (metrics)
+        {
+            const size_t bytes = (_code.size() + _fused.size()) * sizeof(Instruction) +
+                                 (_origins.size() + _lines.size()) * sizeof(U32) +
+                                 _constants.size() * (sizeof(Math::Real) + sizeof(float));
+            metrics->compiled(Metrics::now() - start, bytes);
+        }
+    }
+
+    U32 Program::function(const String& name)
+    {
+        size_t first = 0;
+        if (_registry)
+        {
+            if (const size_t idx = _registry->find(name); idx != Npos)
+                return (U32)idx;
+            first = _registry->size();
+        }
+
+        // Unknown names get an entry so that the
+        // failure can report which one it was.
+        for (size_t i = first; i < _functions.size(); ++i)
+        {
+            if (_functions[i].name == name)
+                return (U32)i;
+        }
+        _functions.push_back({name});
+        return (U32)_functions.size() - 1;
+    }
+
+    bool Program::foldList()
+    {
+        // <Op3> ::= <SO> <OpL> <SC> emits the elements followed
+        // by their count, so when every element is a Numerical
+        // the whole list is known here.
+        const size_t nc = _code.size();
+        if (nc == 0 || _code[nc - 1].op != Numerical)
+            return false;
+
+        const size_t nr = (size_t)_constants[_code[nc - 1].arg];
+        if (nr == 0 || nr + 1 > nc)
+            return false;
+
+        const size_t first = nc - nr - 1;
+        for (size_t i = first; i < nc - 1; ++i)
+        {
+            if (_code[i].op != Numerical)
+                return false;
+        }
+
+        U32         index;
+        Math::Real* dest = _lists.allocate((U32)nr, index);
+        for (size_t i = 0; i < nr; ++i)
+            dest[i] = _constants[_code[first + i].arg];
+
+        // the elements and their count were the
+        // last values added to the constant pool
+        _constants.resizeFast(_code[first].arg);
+        _code.resizeFast(first);
+        _code.push_back({ConstantList, 0, index});
+        _lines.resizeFast(first + 1);
+        return true;
+    }
+
+    void Program::analyze()
+    {
+        // Simulates the stack, keeping the index of the instruction
+        // that produced each entry. This gives the maximum depth, and
+        // lets identifiers that are only written to by an assignment
+        // be marked as references rather than value loads.
+        SimpleArray<size_t> producers;
+        IndexArray          ends;
+        size_t              max   = 0;
+        bool                exact = true;
+
+        const auto pop = [&producers, &exact](const size_t nr)
+        {
+            if (producers.size() < nr)
+                exact = false;
+            producers.resizeFast(producers.size() > nr ? producers.size() - nr : 0);
+        };
+
+        for (size_t i = 0; i < _code.size(); ++i)
+        {
+            switch (_code[i].op)
+            {
+            case Numerical:
+            case Identifier:
+            case ConstantList:
+            case MathPi:
+            case MathE:
+                break;
+            case Assignment:
+                if (producers.size() > 1)
+                {
+                    if (Instruction& lhs = _code[producers[producers.size() - 2]];
+                        lhs.op == Identifier)
+                        lhs.op = Reference;
+                }
+                pop(2);
+
+                // 'a = b = c' emits its assignments back to back, so
+                // the last one in a run completes a top-level statement.
+                if (i + 1 == _code.size() || _code[i + 1].op != Assignment)
+                    ends.push_back((U32)i + 1);
+                break;
+            case Add:
+            case Sub:
+            case Mul:
+            case Div:
+            case Pow:
+            case Mod:
+            case Less:
+            case LessEqual:
+            case Greater:
+            case GreaterEqual:
+            case Equal:
+            case NotEqual:
+            case And:
+            case Or:
+                pop(2);
+                break;
+            case Select:
+                pop(3);
+                break;
+            case None:
+                continue;
+            case Neg:
+            case Not:
+            case BitwiseNot:
+                pop(1);
+                break;
+            default:
+                // Grouping, UserFunction and the Math functions
+                // pop an argument count followed by that many
+                // arguments, then push their result.
+                if (i > 0 && _code[i - 1].op == Numerical)
+                    pop(1 + (size_t)_constants[_code[i - 1].arg]);
+                else
+                    pop(1);
+                break;
+            }
+            producers.push_back(i);
+            max = std::max(max, producers.size());
+        }
+        // Code that underflows fails when it runs, but the simulation
+        // no longer matches it past that point. No instruction grows
+        // the stack by more than one entry, so the code size bounds
+        // the depth that the fixed size evaluator stacks need.
+        _stackDepth = exact ? max : _code.size();
+
+        // trailing code that is not an assignment
+        if (ends.empty() || ends.back() != _code.size())
+            ends.push_back((U32)_code.size());
+        if (_code.empty())
+            ends.resizeFast(0);
+
+        _graph.build(_code, ends, _slots.size());
+    }
+
+    void Program::fuse()
+    {
+        // Peephole pass over the reference code. The patterns are the
+        // most frequent pairs and triples in an OpcodeHistogram of
+        // typical formulas: operands feeding an arithmetic operator,
+        // and the argument count in front of a function. Second
+        // operands must fit in the 16 bits of Instruction::aux.
+        _fused.resizeFast(0);
+        _origins.resizeFast(0);
+        _fused.reserve(_code.size());
+
+        const size_t n = _code.size();
+        for (size_t i = 0; i < n;)
+        {
+            const Instruction& a = _code[i];
+
+            Instruction f   = a;
+            size_t      len = 1;
+
+            if (i + 2 < n && isFusable(_code[i + 2].op) && _code[i + 1].arg <= 0xFFFF)
+            {
+                const U8 b = _code[i + 1].op;
+
+                U8 family = None;
+                if (a.op == Identifier && b == Numerical)
+                    family = SlotConst;
+                else if (a.op == Numerical && b == Identifier)
+                    family = ConstSlot;
+                else if (a.op == Identifier && b == Identifier)
+                    family = SlotSlot;
+
+                if (family != None)
+                {
+                    f.op  = fusedCode(family, _code[i + 2].op);
+                    f.aux = (U16)_code[i + 1].arg;
+                    len   = 3;
+                }
+            }
+
+            if (len == 1 && i + 1 < n)
+            {
+                const Instruction& b = _code[i + 1];
+                if (isFusable(b.op) && (a.op == Identifier || a.op == Numerical))
+                {
+                    f.op = fusedCode(a.op == Identifier ? TopSlot : TopConst, b.op);
+                    len  = 2;
+                }
+                else if (a.op == Numerical && b.op >= MathAbs && b.op <= MathNorm)
+                {
+                    if (const Math::Real nr = _constants[a.arg];
+                        nr >= 1 && nr <= 0xFFFF && nr == std::floor(nr))
+                    {
+                        f     = b;
+                        f.aux = (U16)nr;
+                        len   = 2;
+                    }
+                }
+            }
+
+            _fused.push_back(f);
+            _origins.push_back(U32(i + len - 1));
+            i += len;
+        }
+    }
+
+    const char* opcodeName(const U8 op)
+    {
+        static const char* Fused[5][4] = {
+            {"slot.const.add", "slot.const.sub", "slot.const.mul", "slot.const.div"},
+            {"const.slot.add", "const.slot.sub", "const.slot.mul", "const.slot.div"},
+            { "slot.slot.add",  "slot.slot.sub",  "slot.slot.mul",  "slot.slot.div"},
+            {  "top.slot.add",   "top.slot.sub",   "top.slot.mul",   "top.slot.div"},
+            { "top.const.add",  "top.const.sub",  "top.const.mul",  "top.const.div"},
+        };
+        if (op >= SlotConst && op < ProgramCodeEnd)
+            return Fused[(op - SlotConst) / 4][(op - SlotConst) % 4];
+
+        switch (op)
+        {
+        case None:
+            return "none";
+        case Numerical:
+            return "const";
+        case Identifier:
+            return "load";
+        case UserFunction:
+            return "call";
+        case Assignment:
+            return "assign";
+        case Grouping:
+            return "group";
+        case Add:
+            return "add";
+        case Sub:
+            return "sub";
+        case Mul:
+            return "mul";
+        case Div:
+            return "div";
+        case Pow:
+            return "pow";
+        case Mod:
+            return "mod";
+        case Neg:
+            return "neg";
+        case Not:
+            return "not";
+        case BitwiseNot:
+            return "bnot";
+        case Less:
+            return "lt";
+        case LessEqual:
+            return "le";
+        case Greater:
+            return "gt";
+        case GreaterEqual:
+            return "ge";
+        case Equal:
+            return "eq";
+        case NotEqual:
+            return "ne";
+        case And:
+            return "and";
+        case Or:
+            return "or";
+        case Select:
+            return "select";
+        case MathAbs:
+            return "abs";
+        case MathAcos:
+            return "acos";
+        case MathAsin:
+            return "asin";
+        case MathAtan:
+            return "atan";
+        case MathAtan2:
+            return "atan2";
+        case MathCeil:
+            return "ceil";
+        case MathCos:
+            return "cos";
+        case MathCosh:
+            return "cosh";
+        case MathExp:
+            return "exp";
+        case MathFabs:
+            return "fabs";
+        case MathFloor:
+            return "floor";
+        case MathFmod:
+            return "fmod";
+        case MathLog:
+            return "log";
+        case MathLog10:
+            return "log10";
+        case MathPow:
+            return "pow";
+        case MathSin:
+            return "sin";
+        case MathSinh:
+            return "sinh";
+        case MathSqrt:
+            return "sqrt";
+        case MathTan:
+            return "tan";
+        case MathTanh:
+            return "tanh";
+        case MathSum:
+            return "sum";
+        case MathMin:
+            return "min";
+        case MathMax:
+            return "max";
+        case MathMean:
+            return "mean";
+        case MathDot:
+            return "dot";
+        case MathNorm:
+            return "norm";
+        case MathPi:
+            return "pi";
+        case MathE:
+            return "e";
+        case ConstantList:
+            return "list";
+        case Reference:
+            return "ref";
+        default:
+            return "?";
+        }
+    }
+
+    size_t Program::indexOf(const String& name) const
+    {
+        return _slots.find(name);
+    }
+
+}  // namespace Rt2::Eq
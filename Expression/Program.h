@@ -0,0 +1,330 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include <memory>
+#include "Expression/DependencyGraph.h"
+#include "Expression/FunctionRegistry.h"
+#include "Expression/ListStorage.h"
+#include "Expression/Symbol.h"
+#include "Utils/HashMap.h"
+
+namespace Rt2::Eq
+{
+    class Program;
+    using ProgramPtr = std::shared_ptr<const Program>;
+
+    // Instruction codes that only exist in compiled code.
+    enum ProgramCode
+    {
+        ProgramCodeStart = 0x80,
+        ConstantList     = ProgramCodeStart,
+        Reference,
+
+        // Superinstructions, see Program::fused. Each family has one
+        // code per operator, in the order Add, Sub, Mul, Div.
+        SlotConst,                  // Identifier Numerical <op>
+        ConstSlot = SlotConst + 4,  // Numerical Identifier <op>
+        SlotSlot  = ConstSlot + 4,  // Identifier Identifier <op>
+        TopSlot   = SlotSlot + 4,   // Identifier <op>
+        TopConst  = TopSlot + 4,    // Numerical <op>
+        ProgramCodeEnd = TopConst + 4,
+    };
+
+    /// <summary>
+    /// The code of a superinstruction family for a fusable operator.
+    /// </summary>
+    inline U8 fusedCode(const U8 family, const U8 op)
+    {
+        return U8(family + (op - Add));
+    }
+
+    inline bool isFusable(const U8 op)
+    {
+        return op >= Add && op <= Div;
+    }
+
+    /// <summary>
+    /// Short name of a SymbolType or ProgramCode, for listings.
+    /// </summary>
+    const char* opcodeName(U8 op);
+
+    // Scalar type of the batch evaluator.
+    enum Precision
+    {
+        PrecisionFloat64,
+        PrecisionFloat32,
+    };
+
+    struct Instruction
+    {
+        // One of the SymbolType or ProgramCode codes.
+        U8 op{None};
+
+        // Superinstructions : the second operand, a constant
+        //                     index or a variable slot.
+        // Math functions    : in fused code, the argument count
+        //                     when it is not on the stack.
+        U16 aux{0};
+
+        // Numerical    : index into the constant pool.
+        // Identifier   : variable slot.
+        // Reference    : variable slot that is the target of an assignment.
+        // ConstantList : index into the constant lists.
+        // UserFunction : index into the function table.
+        U32 arg{0};
+    };
+
+    using InstructionArray = SimpleArray<Instruction>;
+    using ConstantArray    = SimpleArray<Math::Real>;
+    using ConstantArrayF   = SimpleArray<float>;
+    using SlotNames        = SimpleArray<String>;
+    using SlotHash         = HashTable<String, U32>;
+
+    class SlotTable
+    {
+    private:
+        SlotHash  _lookup;
+        SlotNames _names;
+
+    public:
+        SlotTable() = default;
+
+        U32 insert(const String& name);
+
+        size_t find(const String& name) const;
+
+        const String& name(size_t slot) const;
+
+        size_t size() const;
+    };
+
+    /// <summary>
+    /// Immutable, compiled form of a SymbolArray.
+    /// A program holds the code, the constant pool and the variable
+    /// slot layout. It carries no execution state, so a single
+    /// program can be shared between any number of ExecutionContexts
+    /// on any number of threads.
+    /// </summary>
+    class Program
+    {
+    private:
+        InstructionArray _code;
+        InstructionArray _fused;
+        IndexArray       _origins;
+        IndexArray       _lines;
+        ConstantArray    _constants;
+        ConstantArrayF   _constantsF;
+        ListStorage      _lists;
+        SlotTable        _slots;
+        DependencyGraph  _graph;
+        FunctionTable    _functions;
+
+        const FunctionRegistry* _registry{nullptr};
+        size_t           _stackDepth{0};
+        Precision        _precision{PrecisionFloat64};
+        U64              _id{nextId()};
+
+        static U64 nextId();
+
+        friend class Statement;
+
+        void build(const SymbolArray& symbols);
+
+        U32 function(const String& name);
+
+        bool foldList();
+
+        void analyze();
+
+        void fuse();
+
+    public:
+        Program() = default;
+
+        /// <summary>
+        /// Compiles the symbols. With PrecisionFloat32 batch execution
+        /// runs on float lanes and float bindings; the constant pool is
+        /// rounded once here.
+        /// </summary>
+        static ProgramPtr compile(const SymbolArray& symbols,
+                                  Precision          precision = PrecisionFloat64);
+
+        /// <summary>
+        /// Compiles the symbols, resolving calls against the registry.
+        /// Calls to names that are not registered fail with
+        /// ErrorUnknownFunction when they are executed.
+        /// </summary>
+        static ProgramPtr compile(const SymbolArray&      symbols,
+                                  const FunctionRegistry& functions,
+                                  Precision               precision = PrecisionFloat64);
+
+        const InstructionArray& code() const;
+
+        /// <summary>
+        /// The code with common sequences fused into superinstructions
+        /// that carry their operands inline, which is what
+        /// ExecutionContext::execute dispatches. code() stays the
+        /// reference form for analysis, the differentiating evaluators
+        /// and the batch evaluator.
+        /// </summary>
+        const InstructionArray& fused() const;
+
+        /// <summary>
+        /// For each fused instruction, the index in code()
+        /// of the last instruction that it replaces.
+        /// </summary>
+        const IndexArray& origins() const;
+
+        /// <summary>
+        /// For each instruction in code(), the source line of the
+        /// statement that it was compiled from, or zero when the
+        /// symbols did not come from the parser.
+        /// </summary>
+        const IndexArray& lines() const;
+
+        const ConstantArray& constants() const;
+
+        /// <summary>
+        /// The constant pool in the scalar type T.
+        /// </summary>
+        template <typename T>
+        const SimpleArray<T>& constantPool() const;
+
+        Precision precision() const;
+
+        /// <summary>
+        /// The registry's functions followed by an unresolved
+        /// entry for each unknown name that is called.
+        /// </summary>
+        const FunctionTable& functions() const;
+
+        /// <summary>
+        /// List literals whose elements are all constant, materialized
+        /// once when the program is compiled.
+        /// </summary>
+        const ListStorage& lists() const;
+
+        const SlotTable& slots() const;
+
+        /// <summary>
+        /// The top-level statements and the slots they read and write.
+        /// </summary>
+        const DependencyGraph& graph() const;
+
+        /// <summary>
+        /// The maximum number of values that will be on
+        /// the stack at any one time while executing the code.
+        /// </summary>
+        size_t stackDepth() const;
+
+        size_t indexOf(const String& name) const;
+
+        /// <summary>
+        /// Identifies the program for as long as the process runs.
+        /// Ids are never reused, unlike the program's address.
+        /// </summary>
+        U64 id() const;
+    };
+
+    inline size_t SlotTable::size() const
+    {
+        return _names.size();
+    }
+
+    inline const String& SlotTable::name(const size_t slot) const
+    {
+        return _names.at(slot);
+    }
+
+    inline U64 Program::id() const
+    {
+        return _id;
+    }
+
+    inline const InstructionArray& Program::code() const
+    {
+        return _code;
+    }
+
+    inline const InstructionArray& Program::fused() const
+    {
+        return _fused;
+    }
+
+    inline const IndexArray& Program::origins() const
+    {
+        return _origins;
+    }
+
+    inline const IndexArray& Program::lines() const
+    {
+        return _lines;
+    }
+
+    inline const ConstantArray& Program::constants() const
+    {
+        return _constants;
+    }
+
+    template <>
+    inline const ConstantArray& Program::constantPool<Math::Real>() const
+    {
+        return _constants;
+    }
+
+    template <>
+    inline const ConstantArrayF& Program::constantPool<float>() const
+    {
+        return _constantsF;
+    }
+
+    inline const FunctionTable& Program::functions() const
+    {
+        return _functions;
+    }
+
+    inline Precision Program::precision() const
+    {
+        return _precision;
+    }
+
+    inline const ListStorage& Program::lists() const
+    {
+        return _lists;
+    }
+
+    inline const SlotTable& Program::slots() const
+    {
+        return _slots;
+    }
+
+    inline const DependencyGraph& Program::graph() const
+    {
+        return _graph;
+    }
+
+    inline size_t Program::stackDepth() const
+    {
+        return _stackDepth;
+    }
+
+}  // namespace Rt2::Eq
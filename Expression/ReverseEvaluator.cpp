@@ -0,0 +1,351 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/ReverseEvaluator.h"
+#include "Expression/Derivatives.h"
+#include "Math/Math.h"
+
+namespace Rt2::Eq
+{
+    void ReverseEvaluator::fail(const ErrorCode code, const char* op)
+    {
+        if (_status.code == ErrorNone)
+        {
+            _status.code = code;
+            _status.op   = op;
+        }
+    }
+
+    bool ReverseEvaluator::require(const size_t nr, const char* op)
+    {
+        if (_stack.size() < nr)
+        {
+            fail(ErrorStackUnderflow, op);
+            return false;
+        }
+        return true;
+    }
+
+    U32 ReverseEvaluator::record(const Math::Real v,
+                                 const U32        a,
+                                 const Math::Real ga,
+                                 const U32        b,
+                                 const Math::Real gb)
+    {
+        _tape.push_back({a, b, ga, gb});
+        _values.push_back(v);
+        return (U32)_tape.size() - 1;
+    }
+
+    void ReverseEvaluator::push(const U32 node, const U32 id)
+    {
+        _stack.push_back(node);
+        _ids.push_back(id);
+    }
+
+    U32 ReverseEvaluator::pop()
+    {
+        const U32 node = _stack.back();
+        _stack.resizeFast(_stack.size() - 1);
+        _ids.resizeFast(_ids.size() - 1);
+        return node;
+    }
+
+    void ReverseEvaluator::unary(const U8 op)
+    {
+        if (!require(1, "math function"))
+            return;
+        const U32  a = pop();
+        Math::Real g;
+        const Math::Real v = unaryRule(op, _values[a], g);
+        push(record(v, a, g));
+    }
+
+    U32 ReverseEvaluator::binary(const U8 op, const U32 a, const U32 b)
+    {
+        Math::Real       ga, gb;
+        const Math::Real v = binaryRule(op, _values[a], _values[b], ga, gb);
+        return record(v, a, ga, b, gb);
+    }
+
+    void ReverseEvaluator::binary(const U8 op)
+    {
+        if (!require(2, "operation"))
+            return;
+        const U32 b = pop();
+        const U32 a = pop();
+        push(binary(op, a, b));
+    }
+
+    void ReverseEvaluator::select()
+    {
+        if (!require(3, "select"))
+            return;
+        const U32 b = pop();
+        const U32 a = pop();
+        const U32 c = pop();
+
+        // adjoints only flow to the selected operand
+        push(_values[c] != 0 ? a : b);
+    }
+
+    bool ReverseEvaluator::arguments(const I32 expected)
+    {
+        if (!require((size_t)expected + 1, "math function"))
+            return false;
+        if (I32(_values[pop()]) != expected)
+        {
+            fail(ErrorArgumentCount, "math function");
+            return false;
+        }
+        return true;
+    }
+
+    void ReverseEvaluator::assign()
+    {
+        if (!require(2, "assign"))
+            return;
+        const U32 b  = pop();
+        const U32 id = _ids.back();
+        pop();
+
+        // Later loads of the slot read the assigned node, so
+        // adjoints flow through it to whatever it was computed from.
+        if (id != NoIndex)
+            _current[id] = b;
+        push(b);
+    }
+
+    void ReverseEvaluator::reduce(const U8 op)
+    {
+        if (!require(1, "reduction"))
+            return;
+        const size_t nr = (size_t)I32(_values[pop()]);
+        if (nr < 1 || _stack.size() < nr)
+        {
+            fail(ErrorStackUnderflow, "reduction");
+            return;
+        }
+        if (op == MathDot && nr != 2)
+        {
+            fail(ErrorArgumentCount, "dot");
+            return;
+        }
+
+        // Reductions are recorded as chains of binary nodes.
+        const size_t first = _stack.size() - nr;
+        U32          r     = _stack[first];
+
+        switch (op)
+        {
+        case MathSum:
+        case MathMean:
+            for (size_t i = first + 1; i < _stack.size(); ++i)
+                r = binary(Add, r, _stack[i]);
+            if (op == MathMean)
+                r = record(_values[r] / Math::Real(nr), r, 1 / Math::Real(nr));
+            break;
+        case MathMin:
+        case MathMax:
+            for (size_t i = first + 1; i < _stack.size(); ++i)
+            {
+                const Math::Real v = _values[_stack[i]];
+                if (op == MathMin ? v < _values[r] : v > _values[r])
+                    r = _stack[i];
+            }
+            break;
+        case MathDot:
+            r = binary(Mul, r, _stack[first + 1]);
+            break;
+        case MathNorm:
+        {
+            r = binary(Mul, r, r);
+            for (size_t i = first + 1; i < _stack.size(); ++i)
+                r = binary(Add, r, binary(Mul, _stack[i], _stack[i]));
+
+            Math::Real g;
+            const Math::Real v = unaryRule(MathSqrt, _values[r], g);
+            r                  = record(v, r, v > 0 ? g : 0);
+            break;
+        }
+        default:
+            break;
+        }
+
+        _stack.resizeFast(first);
+        _ids.resizeFast(first);
+        push(r);
+    }
+
+    void ReverseEvaluator::eval(const Instruction& ins)
+    {
+        switch (ins.op)
+        {
+        case Numerical:
+            push(record(_program->constants()[ins.arg]));
+            break;
+        case Identifier:
+            push(_current[ins.arg]);
+            break;
+        case Reference:
+            push(NoIndex, ins.arg);
+            break;
+        case MathPi:
+            push(record(Math::Pi));
+            break;
+        case MathE:
+            push(record(Math::E));
+            break;
+        case Assignment:
+            assign();
+            break;
+        case Add:
+        case Sub:
+        case Mul:
+        case Div:
+        case Pow:
+        case Mod:
+        case Less:
+        case LessEqual:
+        case Greater:
+        case GreaterEqual:
+        case Equal:
+        case NotEqual:
+        case And:
+        case Or:
+            binary(ins.op);
+            break;
+        case Neg:
+        case Not:
+        case BitwiseNot:
+            unary(ins.op);
+            break;
+        case Select:
+            select();
+            break;
+        case MathSum:
+        case MathMin:
+        case MathMax:
+        case MathMean:
+        case MathDot:
+        case MathNorm:
+            reduce(ins.op);
+            break;
+        case Grouping:
+        case ConstantList:
+            fail(ErrorUnsupported, "list");
+            break;
+        case UserFunction:
+            fail(ErrorUnsupported, _program->functions()[ins.arg].name.c_str());
+            break;
+        default:
+            // math functions are preceded by their argument count
+            if (const U8 nr = ruleArity(ins.op); nr == 1)
+            {
+                if (arguments(1))
+                    unary(ins.op);
+            }
+            else if (nr == 2)
+            {
+                if (arguments(2))
+                    binary(ins.op);
+            }
+            break;
+        }
+    }
+
+    bool ReverseEvaluator::execute(const Program& program, const ValueList& inputs)
+    {
+        _program = &program;
+        _status  = {};
+        _tape.resizeFast(0);
+        _values.resizeFast(0);
+        _stack.resizeFast(0);
+        _ids.resizeFast(0);
+
+        const size_t nr = program.slots().size();
+        _current.resizeFast(nr);
+        for (U32 s = 0; s < nr; ++s)
+            _current[s] = record(s < inputs.size() ? inputs[s] : 0);
+
+        const InstructionArray& code = program.code();
+        for (U32 i = 0; i < code.size(); ++i)
+        {
+            eval(code[i]);
+
+            if (_status.code != ErrorNone)
+            {
+                _status.instruction = i;
+                _stack.resizeFast(0);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void ReverseEvaluator::backward(ValueList& gradient)
+    {
+        _adjoints.resizeFast(_tape.size());
+        for (Math::Real& a : _adjoints)
+            a = 0;
+
+        if (!_stack.empty() && _stack.back() != NoIndex)
+            _adjoints[_stack.back()] = 1;
+
+        // Nodes only refer to earlier nodes, so one sweep from
+        // the end of the tape visits each after all of its uses.
+        for (size_t n = _tape.size(); n-- > 0;)
+        {
+            const Math::Real adj = _adjoints[n];
+            if (adj == 0)
+                continue;
+
+            const TapeNode& node = _tape[n];
+            if (node.a != NoIndex)
+                _adjoints[node.a] += term(node.ga, adj);
+            if (node.b != NoIndex)
+                _adjoints[node.b] += term(node.gb, adj);
+        }
+
+        const size_t nr = _current.size();
+        gradient.resizeFast(nr);
+        for (size_t s = 0; s < nr; ++s)
+            gradient[s] = _adjoints[s];
+    }
+
+    Math::Real ReverseEvaluator::result() const
+    {
+        if (_stack.empty() || _stack.back() == NoIndex)
+            return 0;
+        return _values[_stack.back()];
+    }
+
+    Math::Real ReverseEvaluator::variable(const size_t idx) const
+    {
+        return _values[_current[idx]];
+    }
+
+    bool ReverseEvaluator::isWritten(const size_t idx) const
+    {
+        return idx < _current.size() && _current[idx] != idx;
+    }
+
+}  // namespace Rt2::Eq
@@ -0,0 +1,134 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Expression/DependencyGraph.h"
+#include "Expression/ExecutionStatus.h"
+#include "Expression/Program.h"
+
+namespace Rt2::Eq
+{
+    /// <summary>
+    /// One recorded operation: the operands it was computed
+    /// from and its partial derivative with respect to each.
+    /// </summary>
+    struct TapeNode
+    {
+        U32        a{NoIndex};
+        U32        b{NoIndex};
+        Math::Real ga{0};
+        Math::Real gb{0};
+    };
+
+    using Tape = SimpleArray<TapeNode>;
+
+    /// <summary>
+    /// Reverse mode differentiation of a program.
+    /// execute runs the program once, recording every operation on a
+    /// tape, and backward then propagates the adjoint of the result to
+    /// every slot in a single sweep, so the cost does not grow with the
+    /// number of inputs. The first slots().size() nodes are the initial
+    /// slot values. The tape and its buffers are reused between calls,
+    /// so steady state use does not allocate.
+    /// </summary>
+    class ReverseEvaluator
+    {
+    private:
+        const Program*  _program{nullptr};
+        Tape            _tape;
+        ValueList       _values;
+        ValueList       _adjoints;
+        IndexArray      _stack;
+        IndexArray      _ids;
+        IndexArray      _current;
+        ExecutionStatus _status;
+
+        void fail(ErrorCode code, const char* op);
+
+        bool require(size_t nr, const char* op);
+
+        U32 record(Math::Real v,
+                   U32        a  = NoIndex,
+                   Math::Real ga = 0,
+                   U32        b  = NoIndex,
+                   Math::Real gb = 0);
+
+        void push(U32 node, U32 id = NoIndex);
+
+        U32 pop();
+
+        void unary(U8 op);
+
+        void binary(U8 op);
+
+        U32 binary(U8 op, U32 a, U32 b);
+
+        void select();
+
+        bool arguments(I32 expected);
+
+        void assign();
+
+        void reduce(U8 op);
+
+        void eval(const Instruction& ins);
+
+    public:
+        ReverseEvaluator() = default;
+
+        /// <summary>
+        /// Records the tape. inputs holds the value of every slot.
+        /// </summary>
+        /// <returns>false if the program could not be evaluated.</returns>
+        bool execute(const Program& program, const ValueList& inputs);
+
+        /// <summary>
+        /// Back-propagates from the result and writes the derivative of
+        /// the result with respect to the initial value of every slot to
+        /// gradient, in slot order.
+        /// </summary>
+        void backward(ValueList& gradient);
+
+        Math::Real result() const;
+
+        /// <summary>
+        /// The value of a slot after execution.
+        /// </summary>
+        Math::Real variable(size_t idx) const;
+
+        bool isWritten(size_t idx) const;
+
+        size_t size() const;
+
+        const ExecutionStatus& status() const;
+    };
+
+    inline size_t ReverseEvaluator::size() const
+    {
+        return _tape.size();
+    }
+
+    inline const ExecutionStatus& ReverseEvaluator::status() const
+    {
+        return _status;
+    }
+
+}  // namespace Rt2::Eq
@@ -20,6 +20,7 @@
 -------------------------------------------------------------------------------
 */
 #pragma once
+#include "Expression/ListStorage.h"
 #include "StatementParser.h"
 #include "Utils/Hash.h"
 #include "Utils/HashMap.h"
@@ -54,9 +55,7 @@ namespace Rt2::Eq
 
     using EvalStack     = Stack<StackValue, AOP_SIMPLE_TYPE>;
     using EvalHash      = HashTable<String, StackValue>;
-    using ValueGrouping = SimpleArray<StackValue>;
-    using EvalGroupHash = HashTable<U32, ValueGrouping*>;
-    using ValueList     = SimpleArray<Math::Real>;
+    using ValueArray    = SimpleArray<StackValue>;
 
     inline bool StackValue::isList() const
     {
@@ -0,0 +1,139 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Math/Scalar.h"
+#include "Utils/Array.h"
+
+namespace Rt2::Eq
+{
+    /// <summary>
+    /// Saved variable state of an ExecutionContext, taken with
+    /// ExecutionContext::snapshot and put back with restore.
+    ///
+    /// The state is one contiguous block of eight byte words in the
+    /// program's slot order, so that saving and restoring it are
+    /// copies rather than a lookup per name. A full snapshot holds
+    /// every value, followed by the ranges and elements of the lists
+    /// built at run time. A delta snapshot holds a slot and value
+    /// pair for each value that differs from a full base snapshot,
+    /// followed by the lists. Snapshots are tied to the program they
+    /// were taken on by its id. Variables bound to caller owned memory
+    /// live in that memory and are not part of the snapshot.
+    /// </summary>
+    class StateSnapshot
+    {
+    private:
+        U64              _program{0};
+        SimpleArray<U64> _block;
+        size_t           _values{0};
+        size_t           _lists{0};
+        size_t           _elements{0};
+        bool             _delta{false};
+
+        friend class ExecutionContext;
+
+        U64* reserve(size_t values, size_t lists, size_t elements);
+
+    public:
+        StateSnapshot() = default;
+
+        void clear();
+
+        bool empty() const;
+
+        bool isDelta() const;
+
+        /// <summary>
+        /// The number of values held, which for a delta
+        /// is the number that changed.
+        /// </summary>
+        size_t values() const;
+
+        /// <summary>
+        /// The number of run time lists held.
+        /// </summary>
+        size_t lists() const;
+
+        /// <summary>
+        /// The block, and its size in bytes, for callers that
+        /// keep snapshots elsewhere.
+        /// </summary>
+        const void* data() const;
+
+        size_t bytes() const;
+    };
+
+    inline U64* StateSnapshot::reserve(const size_t values,
+                                       const size_t lists,
+                                       const size_t elements)
+    {
+        _values   = values;
+        _lists    = lists;
+        _elements = elements;
+
+        // resized without clearing, so that reusing
+        // a snapshot does not allocate
+        _block.resizeFast((_delta ? 2 * values : values) + lists + elements);
+        return _block.data();
+    }
+
+    inline void StateSnapshot::clear()
+    {
+        _program  = 0;
+        _block.resizeFast(0);
+        _values   = 0;
+        _lists    = 0;
+        _elements = 0;
+        _delta    = false;
+    }
+
+    inline bool StateSnapshot::empty() const
+    {
+        return _program == 0;
+    }
+
+    inline bool StateSnapshot::isDelta() const
+    {
+        return _delta;
+    }
+
+    inline size_t StateSnapshot::values() const
+    {
+        return _values;
+    }
+
+    inline size_t StateSnapshot::lists() const
+    {
+        return _lists;
+    }
+
+    inline const void* StateSnapshot::data() const
+    {
+        return _block.data();
+    }
+
+    inline size_t StateSnapshot::bytes() const
+    {
+        return _block.size() * sizeof(U64);
+    }
+
+}  // namespace Rt2::Eq
@@ -1,52 +1,29 @@
 #pragma once
-#include "Expression/StackValue.h"
+#include "Expression/ExecutionContext.h"
 #include "Expression/StatementParser.h"
 
 namespace Rt2::Eq
 {
-    typedef  double (*WrapFuncA1)(double a1);
-    typedef  double (*WrapFuncA2)(double a1, double a2);
-
+    /// <summary>
+    /// Name keyed evaluator for loose symbol arrays.
+    /// The supplied symbols are compiled against a slot layout that
+    /// persists across calls and run in a private ExecutionContext.
+    /// The compiled program is kept until execute is given symbols of
+    /// another generation (see Symbol::generation), so repeated executes
+    /// of the same read do not recompile.
+    /// </summary>
     class Statement
     {
     private:
-        EvalStack     _stack;
-        EvalHash      _table;
-        EvalGroupHash _groups;
-        U32           _hashCount{InitialHash};
-
-        void push(const Math::Real&    v,
-                  const size_t& idx  = Npos,
-                  U8            flag = StackValue::Value);
-
-        void push(const Symbol* sy);
-
-        void store(const Symbol* sym);
-
-        void add();
-        void sub();
-        void neg();
-        void mul();
-        void div();
-        void mod();
-        void pow();
-        void group();
-        void assign();
-
-        void mathFncA1(WrapFuncA1 f);
-        void mathFncA2(WrapFuncA2 f);
-        
-        void eval(const Symbol* sy);
-
-        Math::Real executeImpl(const SymbolArray& val);
-
-        template <typename... Args>
-        [[noreturn]] void error(Args&&... args);
+        Program          _program;
+        ExecutionContext _context;
+        U64              _generation{0};
+        bool             _built{false};
 
-        [[noreturn]] void argError(const char*);
+        void prepare(const SymbolArray& val);
 
     public:
-        Statement() = default;
+        Statement();
         ~Statement();
 
         void set(const String& name, Math::Real value);
@@ -60,15 +37,41 @@ namespace Rt2::Eq
 
         void get(const String& name, ValueList& dest);
 
+        /// <summary>
+        /// Saves or restores every variable at once.
+        /// See ExecutionContext::snapshot.
+        /// </summary>
+        void snapshot(StateSnapshot& dest) const;
+
+        bool snapshot(StateSnapshot& dest, const StateSnapshot& base) const;
+
+        bool restore(const StateSnapshot& snapshot);
+
+        /// <summary>
+        /// Compiles the symbols now. Call this after editing symbols that
+        /// were executed before, since execute only notices symbols of a
+        /// different generation, not edits within one.
+        /// </summary>
+        void compile(const SymbolArray& val);
+
         Math::Real execute(const SymbolArray& val);
-    };
 
-    template <typename... Args>
-    void Statement::error(Args&&... args)
-    {
-        OutputStringStream stream;
-        ((stream << std::forward<Args>(args)), ...);
-        throw Exception(stream.str());
-    }
+        /// <summary>
+        /// Executes the symbols once on dual numbers.
+        /// See ExecutionContext::gradient.
+        /// </summary>
+        Math::Real gradient(const SymbolArray& val,
+                            const VInt*        variables,
+                            size_t             nr,
+                            Math::Real*        derivatives);
+
+        /// <summary>
+        /// Sets the registry that calls are resolved against by the
+        /// following executes. It must outlive those calls.
+        /// </summary>
+        void setFunctions(const FunctionRegistry* functions);
+
+        const ExecutionStatus& status() const;
+    };
 
 }  // namespace Jam::Eq
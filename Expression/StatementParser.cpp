@@ -37,6 +37,11 @@ namespace Rt2::Eq
     {
         for (const auto& symbol : _symbols)
             delete symbol;
+        for (const auto& def : _definitions)
+        {
+            for (const auto& symbol : def.body)
+                delete symbol;
+        }
 
         delete _scanner;
         _scanner = nullptr;
@@ -47,6 +52,11 @@ namespace Rt2::Eq
         return _symbols;
     }
 
+    const FunctionDefinitions& StatementParser::definitions() const
+    {
+        return _definitions;
+    }
+
     void StatementParser::reset()
     {
         for (const auto& symbol : _symbols)
@@ -58,10 +68,21 @@ namespace Rt2::Eq
     Symbol* StatementParser::createSymbol(const int8_t& type)
     {
         Symbol* node = new Symbol((SymbolType)type);
+        node->setLine(_line);
+        node->setGeneration(_generation);
         _symbols.push_back(node);
         return node;
     }
 
+    Symbol* StatementParser::cloneSymbol(const Symbol* symbol)
+    {
+        Symbol* node = createSymbol(symbol->type());
+        node->setName(symbol->name());
+        node->setValue(symbol->value());
+        node->setLine(symbol->line());
+        return node;
+    }
+
     String StatementParser::string(const size_t& idx) const
     {
         return _scanner->string(idx);
@@ -87,7 +108,9 @@ namespace Rt2::Eq
         return ((Eq::StatementScanner*)_scanner)->real(idx);
     }
 
-    void StatementParser::ruleCsv(CallState& state, const Parameter& r0)
+    void StatementParser::ruleCsv(CallState&       state,
+                                  const Parameter& r0,
+                                  SizeArray*       bounds)
     {
         state.depthGuard();
 
@@ -98,6 +121,8 @@ namespace Rt2::Eq
         do
         {
             (this->*r0)(state);
+            if (bounds)
+                bounds->push_back(_symbols.size());
             t0 = tokenType(0);
             if (t0 == TOK_COMMA)
             {
@@ -121,16 +146,34 @@ namespace Rt2::Eq
             error("expected an round open bracket.");
 
         advanceCursor(2);
-        ruleCsv(state, &StatementParser::ruleOp);
+
+        // TODO: allow parameter-less methods?
+        if (tokenType(0) == TOK_C_PAR)
+            error("expected at least one function argument.");
+
+        // the end of each argument's symbols
+        const size_t first = _symbols.size();
+        SizeArray    bounds;
+        ruleCsv(state, &StatementParser::ruleOp, &bounds);
 
         if (tokenType(0) != TOK_C_PAR)
             error("expected an round close bracket.");
         advanceCursor();
-        if (t0 == TOK_IDENTIFIER)
+        if (t0 == TOK_SELECT)
         {
-            // TODO: allow parameter-less methods?
-            if (state.commaCount() == 0)
-                error("TODO: allow parameter-less methods?");
+            // select(c, a, b) is the ternary operator, not a call
+            if (state.commaCount() != 2)
+                error("select expects three arguments");
+            createSymbol(Select);
+        }
+        else if (t0 == TOK_IDENTIFIER)
+        {
+            if (const size_t idx = _definitionLookup.find(string(s0));
+                idx != Npos)
+            {
+                inlineCall(_definitions[_definitionLookup.at(idx)], first, bounds);
+                return;
+            }
 
             createSymbol(Numerical)
                 ->setValue(state.commaCount() + 1);
@@ -150,7 +193,7 @@ namespace Rt2::Eq
     {
         state.depthGuard();
         // <Op3> ::= <Fnc>
-        //         | '(' <Op> ')'
+        //         | <SO> <OpL> <SC>
         //         | Id
         //         | Num
 
@@ -165,14 +208,29 @@ namespace Rt2::Eq
             return;
         }
 
-        // <Op3> ::= '(' <Op> ')'
-        if (t0 == TOK_O_PAR)
+        // <Op3> ::= <SO> <OpL> <SC>
+        // A list of one element is the element itself, which
+        // makes '(' <Op> ')' an ordinary parenthesised term.
+        if (isOpenToken(t0))
         {
             advanceCursor();
-            ruleOp(state);
-            if (tokenType(0) != TOK_C_PAR)
-                error("expected a group closure");
+            ruleCsv(state, &StatementParser::ruleOp);
+            if (!isMatchingCloseToken(t0, tokenType(0)))
+            {
+                if (t0 == TOK_O_PAR)
+                    error("expected a group closure");
+                else
+                    error("invalid matching close token",
+                          SetI({tokenType(0)}));
+            }
             advanceCursor();
+
+            if (state.commaCount() > 0)
+            {
+                createSymbol(Numerical)
+                    ->setValue(state.commaCount() + 1);
+                createSymbol(Grouping);
+            }
             return;
         }
 
@@ -279,96 +337,330 @@ namespace Rt2::Eq
         }
     }
 
-    void StatementParser::ruleOp(CallState& state)
+    void StatementParser::ruleUn(CallState& state)
     {
-        state.depthGuard();
-        // <Op> ::= '-' <Op>
-        //        | '!' <Op>
+        // <Un> ::= '-' <Un>
+        //        | '!' <Un>
+        //        | '~' <Un>
         //        | <Op1>
         const int8_t t0 = tokenType(0);
 
-        // <Op> ::= '-' <Op>
+        // <Un> ::= '-' <Un>
         if (t0 == TOK_MINUS)
         {
+            state.depthGuard();
             advanceCursor();
-            ruleOp(state);
+            ruleUn(state);
             createSymbol(Neg);
             return;
         }
 
-        // <Op> ::= '!' <Op>
+        // <Un> ::= '!' <Un>
         if (t0 == TOK_NOT)
         {
+            state.depthGuard();
             advanceCursor();
-            ruleOp(state);
+            ruleUn(state);
             createSymbol(Not);
             return;
         }
 
-        // Descending:<Op> ::= <Op1>
+        // <Un> ::= '~' <Un>
+        if (t0 == TOK_TILDE)
+        {
+            state.depthGuard();
+            advanceCursor();
+            ruleUn(state);
+            createSymbol(BitwiseNot);
+            return;
+        }
+
+        // Descending:<Un> ::= <Op1>
         ruleOp1(state);
     }
 
+    void StatementParser::ruleCmp(CallState& state)
+    {
+        // The precedence levels between <Op> and <Op1> only
+        // count against the guard when they match an operator.
+        // <Cmp> ::= <Un> '<' <Un>
+        //         | <Un> '<=' <Un>
+        //         | <Un> '>' <Un>
+        //         | <Un> '>=' <Un>
+        //         | <Un> '==' <Un>
+        //         | <Un> '!=' <Un>
+        //         | <Un>
+        ruleUn(state);
+
+        SymbolType op;
+        switch (tokenType(0))
+        {
+        case TOK_LESS:
+            op = Less;
+            break;
+        case TOK_LE:
+            op = LessEqual;
+            break;
+        case TOK_GREATER:
+            op = Greater;
+            break;
+        case TOK_GE:
+            op = GreaterEqual;
+            break;
+        case TOK_EQ:
+            op = Equal;
+            break;
+        case TOK_NE:
+            op = NotEqual;
+            break;
+        default:
+            return;
+        }
+
+        state.depthGuard();
+        advanceCursor();
+        ruleUn(state);
+        createSymbol(op);
+
+        // 'a < b < c' would compare a truth value with c
+        if (isComparisonToken(tokenType(0)))
+            error("comparisons do not chain");
+    }
+
+    void StatementParser::ruleAnd(CallState& state)
+    {
+        // <And> ::= <Cmp> '&&' <And>
+        //         | <Cmp>
+        ruleCmp(state);
+
+        if (tokenType(0) == TOK_LAND)
+        {
+            state.depthGuard();
+            advanceCursor();
+            ruleAnd(state);
+            createSymbol(And);
+        }
+        else if (tokenType(0) == TOK_AND)
+            error("'&' is not an operator, logical and is '&&'");
+    }
+
+    void StatementParser::ruleOr(CallState& state)
+    {
+        // <Or> ::= <And> '||' <Or>
+        //        | <And>
+        ruleAnd(state);
+
+        if (tokenType(0) == TOK_LOR)
+        {
+            state.depthGuard();
+            advanceCursor();
+            ruleOr(state);
+            createSymbol(Or);
+        }
+        else if (tokenType(0) == TOK_OR)
+            error("'|' is not an operator, logical or is '||'");
+    }
+
+    void StatementParser::ruleOp(CallState& state)
+    {
+        state.depthGuard();
+        // <Op> ::= <Or> '?' <Op> ':' <Op>
+        //        | <Or>
+        ruleOr(state);
+
+        // <Op> ::= <Or> '?' <Op> ':' <Op>
+        if (tokenType(0) == TOK_QUESTION)
+        {
+            advanceCursor();
+            ruleOp(state);
+            if (tokenType(0) != TOK_COLON)
+                error("expected ':' in a conditional");
+            advanceCursor();
+            ruleOp(state);
+            createSymbol(Select);
+        }
+    }
+
     void StatementParser::ruleAsn(CallState& state)
     {
         state.depthGuard();
-        // <Asn>  ::= Id '=' <SO> <OpL> <SC>
-        //          | Id '=' <Asn>
+        // <Asn>  ::= Id '=' <Asn>
         //          | <Op>
+        // List literals are terms of <Op>, see ruleOp3.
         const int8_t t0 = tokenType(0);
         const int8_t t1 = tokenType(1);
-        const int8_t t2 = tokenType(2);
+
+        // Each assignment is a statement, and its symbols
+        // are attributed to the line that it starts on.
+        const I32 line = _line = token(0).line();
 
         if (t0 == TOK_IDENTIFIER &&
-            t1 == TOK_EQUALS &&
-            isOpenToken(t2))
+            t1 == TOK_EQUALS)
         {
             createSymbol(Identifier)
                 ->setName(
                     stringToken(0));
-            advanceCursor(3);
+            advanceCursor(2);
+            ruleAsn(state);
+            _line = line;
+            createSymbol(Assignment);
+            return;
+        }
+        ruleOp(state);
+    }
 
-            ruleCsv(state, &StatementParser::ruleOp);
-            if (!isMatchingCloseToken(t2, tokenType(0)))
+    void StatementParser::inlineCall(const FunctionDefinition& def,
+                                     const size_t              first,
+                                     const SizeArray&          bounds)
+    {
+        if (bounds.size() != def.params.size())
+        {
+            error("wrong number of arguments supplied to '",
+                  def.name,
+                  "'");
+        }
+
+        SizeArray params;
+        size_t    size = 0;
+        for (const Symbol* sy : def.body)
+        {
+            size_t param = Npos;
+            if (sy->type() == Identifier)
             {
-                error("invalid matching close token",
-                      SetI({tokenType(0)}));
+                for (size_t p = 0; p < def.params.size() && param == Npos; ++p)
+                {
+                    if (def.params[p] == sy->name())
+                        param = p;
+                }
             }
+            params.push_back(param);
 
-            advanceCursor();
-            if (state.commaCount() > 0)
+            if (param == Npos)
+                ++size;
+            else
+                size += bounds[param] - (param > 0 ? bounds[param - 1] : first);
+        }
+
+        // Every use of a parameter copies its argument, so nested
+        // calls multiply in size. Stop before the copies are made.
+        if (size > MaxInlineSize)
+        {
+            error("the call to '",
+                  def.name,
+                  "' expands to more than ",
+                  MaxInlineSize,
+                  " symbols");
+        }
+
+        // Detach the argument symbols, then emit the body with
+        // each parameter replaced by a copy of its argument.
+        SymbolArray args;
+        for (size_t i = first; i < _symbols.size(); ++i)
+            args.push_back(_symbols[i]);
+        _symbols.resizeFast(first);
+
+        for (size_t b = 0; b < def.body.size(); ++b)
+        {
+            if (const size_t param = params[b]; param == Npos)
+                cloneSymbol(def.body[b]);
+            else
             {
-                createSymbol(Numerical)
-                    ->setValue(state.commaCount() + 1);
-                createSymbol(Grouping);
+                const size_t from = param > 0 ? bounds[param - 1] : first;
+                for (size_t i = from; i < bounds[param]; ++i)
+                    cloneSymbol(args[i - first]);
             }
-            createSymbol(Assignment);
-            return;
         }
 
-        if (t0 == TOK_IDENTIFIER &&
-            t1 == TOK_EQUALS &&
-            !isOpenToken(t2))
+        for (const Symbol* sy : args)
+            delete sy;
+    }
+
+    bool StatementParser::isDefinition()
+    {
+        // Id '(' Id {',' Id} ')' '='
+        if (tokenType(0) != TOK_IDENTIFIER || tokenType(1) != TOK_O_PAR)
+            return false;
+
+        int32_t i = 2;
+        while (tokenType(i) == TOK_IDENTIFIER)
         {
-            createSymbol(Identifier)
-                ->setName(
-                    stringToken(0));
-            advanceCursor(2);
-            ruleAsn(state);
-            createSymbol(Assignment);
-            return;
+            if (tokenType(i + 1) == TOK_C_PAR)
+                return tokenType(i + 2) == TOK_EQUALS;
+            if (tokenType(i + 1) != TOK_COMMA)
+                return false;
+            i += 2;
+        }
+        return false;
+    }
+
+    void StatementParser::ruleDef(CallState& state)
+    {
+        state.depthGuard();
+
+        // <Def> ::= Id '(' <IdL> ')' '=' <Op>
+        FunctionDefinition def;
+        def.name = stringToken(0);
+        advanceCursor(2);
+
+        while (tokenType(0) == TOK_IDENTIFIER)
+        {
+            def.params.push_back(stringToken(0));
+            advanceCursor();
+            if (tokenType(0) == TOK_COMMA)
+                advanceCursor();
         }
+        advanceCursor(2);
+
+        // The body is parsed in place, so calls to earlier
+        // definitions are already inlined, then moved out.
+        const size_t first = _symbols.size();
         ruleOp(state);
+
+        for (size_t i = first; i < _symbols.size(); ++i)
+            def.body.push_back(_symbols[i]);
+        _symbols.resizeFast(first);
+
+        if (const size_t idx = _definitionLookup.find(def.name);
+            idx != Npos)
+        {
+            FunctionDefinition& prev = _definitions[_definitionLookup.at(idx)];
+            for (const Symbol* sy : prev.body)
+                delete sy;
+            prev = def;
+        }
+        else
+        {
+            _definitionLookup.insert(def.name, (U32)_definitions.size());
+            _definitions.push_back(def);
+        }
     }
 
     void StatementParser::ruleEq(CallState& state)
     {
         state.resetGuard();
-        // <Eq> ::= <Asl>
+        _line = token(0).line();
+        // <Eq> ::= <Stl>
         //        | <Op>
         //        |
-        if (tokenType(1) == TOK_EQUALS)
-            ruleCsv(state, &StatementParser::ruleAsn);
+        if (isDefinition() || tokenType(1) == TOK_EQUALS)
+        {
+            // <Stl> ::= <Stl> ',' <Def>
+            //         | <Stl> ',' <Asn>
+            //         | <Def>
+            //         | <Asn>
+            // Each item is a statement with its own depth budget.
+            for (;;)
+            {
+                state.resetGuard();
+                if (isDefinition())
+                    ruleDef(state);
+                else
+                    ruleAsn(state);
+                if (tokenType(0) != TOK_COMMA)
+                    break;
+                advanceCursor();
+            }
+        }
         else
             ruleOp(state);
     }
@@ -379,7 +671,8 @@ namespace Rt2::Eq
         // initially and attach the input stream
         // to the scanner
         reset();
-        _cursor = 0;
+        _generation = Symbol::nextGeneration();
+        _cursor     = 0;
         _scanner->attach(&input, PathUtil(_file));
 
         CallState state = CallState{Clamp<I16>(_maxDepth, 0x10, 0x800)};
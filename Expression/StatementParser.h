@@ -22,6 +22,7 @@
 #pragma once
 #include "Expression/Symbol.h"
 #include "ParserBase/ParserBase.h"
+#include "Utils/HashMap.h"
 #include "Utils/String.h"
 
 namespace Rt2::Eq
@@ -29,12 +30,35 @@ namespace Rt2::Eq
     class StatementScanner;
     class CallState;
     using SymbolArray = SimpleArray<Symbol*>;
+    using StringArray = SimpleArray<String>;
+    using SizeArray   = SimpleArray<size_t>;
+
+    // Largest number of symbols that one inlined call may expand to.
+    constexpr size_t MaxInlineSize = 0x10000;
+
+    /// <summary>
+    /// Function defined in the source with Id '(' params ')' '=' body.
+    /// The body is kept in postfix form and copied into each call site.
+    /// </summary>
+    struct FunctionDefinition
+    {
+        String      name;
+        StringArray params;
+        SymbolArray body;
+    };
+
+    using FunctionDefinitions = SimpleArray<FunctionDefinition>;
+    using DefinitionHash      = HashTable<String, U32>;
 
     class StatementParser final : public ParserBase
     {
     private:
-        SymbolArray _symbols;
-        I16         _maxDepth{0x80};
+        SymbolArray         _symbols;
+        I16                 _maxDepth{0x80};
+        FunctionDefinitions _definitions;
+        DefinitionHash      _definitionLookup;
+        I32                 _line{0};
+        U64                 _generation{0};
 
         using Parameter = void (StatementParser::*)(CallState& state);
 
@@ -46,6 +70,8 @@ namespace Rt2::Eq
 
         Symbol* createSymbol(const int8_t& type);
 
+        Symbol* cloneSymbol(const Symbol* symbol);
+
         String string(const size_t& idx) const;
 
         String stringToken(const int32_t& idx);
@@ -56,7 +82,9 @@ namespace Rt2::Eq
 
         Math::Real real(const size_t& idx) const;
 
-        void ruleCsv(CallState& state, const Parameter& r0);
+        void ruleCsv(CallState&       state,
+                     const Parameter& r0,
+                     SizeArray*       bounds = nullptr);
 
         void ruleFnc(CallState& state);
 
@@ -66,12 +94,28 @@ namespace Rt2::Eq
 
         void ruleOp1(CallState& state);
 
+        void ruleUn(CallState& state);
+
+        void ruleCmp(CallState& state);
+
+        void ruleAnd(CallState& state);
+
+        void ruleOr(CallState& state);
+
         void ruleOp(CallState& state);
 
         void ruleAsn(CallState& state);
 
         void ruleEq(CallState& state);
 
+        bool isDefinition();
+
+        void ruleDef(CallState& state);
+
+        void inlineCall(const FunctionDefinition& def,
+                        size_t                    first,
+                        const SizeArray&          bounds);
+
         void reset();
 
     public:
@@ -79,6 +123,12 @@ namespace Rt2::Eq
         ~StatementParser() override;
 
         const SymbolArray& symbols() const;
+
+        /// <summary>
+        /// Functions defined by the sources read so far. Definitions
+        /// persist across reads, so a later source may call them.
+        /// </summary>
+        const FunctionDefinitions& definitions() const;
     };
 
 }  // namespace Jam::Eq
@@ -64,8 +64,11 @@ namespace Rt2::Eq
         if (ch > 0)
             _stream->putback((char)ch);
 
-        if (const TokenType rt = filterKeyword(_buf);
-            rt != TOK_NULL)
+        TokenType rt = filterKeyword(_buf);
+        if (isCallOnlyKeyword(rt) && !scanCallAhead())
+            rt = TOK_NULL;
+
+        if (rt != TOK_NULL)
         {
             tok.setType(rt);
         }
@@ -126,6 +129,29 @@ namespace Rt2::Eq
         }
     }
 
+    int8_t StatementScanner::scanPair(const int second, const int8_t pair, const int8_t single)
+    {
+        if (_stream->peek() == second)
+        {
+            _stream->get();
+            return pair;
+        }
+        return single;
+    }
+
+    bool StatementScanner::scanCallAhead()
+    {
+        // Blanks are skipped here rather than in scan, which
+        // would drop them anyway. Line breaks are left alone.
+        int ch = _stream->peek();
+        while (ch == ' ' || ch == '\t')
+        {
+            _stream->get();
+            ch = _stream->peek();
+        }
+        return ch == '(';
+    }
+
     void StatementScanner::scan(Token& tok)
     {
         if (_stream == nullptr)
@@ -150,7 +176,19 @@ namespace Rt2::Eq
                 scanNumber(tok);
                 return;
             case '=':
-                tok.setType(TOK_EQUALS);
+                tok.setType(scanPair('=', TOK_EQ, TOK_EQUALS));
+                return;
+            case '<':
+                tok.setType(scanPair('=', TOK_LE, TOK_LESS));
+                return;
+            case '>':
+                tok.setType(scanPair('=', TOK_GE, TOK_GREATER));
+                return;
+            case '?':
+                tok.setType(TOK_QUESTION);
+                return;
+            case ':':
+                tok.setType(TOK_COLON);
                 return;
             case '{':
                 tok.setType(TOK_O_BRACKET);
@@ -189,24 +227,29 @@ namespace Rt2::Eq
                 tok.setType(TOK_PERIOD);
                 return;
             case '!':
-                tok.setType(TOK_NOT);
+                tok.setType(scanPair('=', TOK_NE, TOK_NOT));
                 return;
             case ',':
                 tok.setType(TOK_COMMA);
                 return;
             case '%':
                 tok.setType(TOK_MOD);
-                break;
+                return;
             case '&':
-                tok.setType(TOK_AND);
-                break;
+                tok.setType(scanPair('&', TOK_LAND, TOK_AND));
+                return;
             case '~':
                 tok.setType(TOK_TILDE);
-                break;
+                return;
             case '|':
-                tok.setType(TOK_OR);
-                break;
+                tok.setType(scanPair('|', TOK_LOR, TOK_OR));
+                return;
             case '\r':
+                // a CRLF pair is a single line break
+                if (_stream->peek() == '\n')
+                    _stream->get();
+                _line++;
+                break;
             case '\n':
                 _line++;
                 break;
@@ -39,6 +39,10 @@ namespace Rt2::Eq
 
         void scanIdentifier(Token& tok);
 
+        int8_t scanPair(int second, int8_t pair, int8_t single);
+
+        bool scanCallAhead();
+
         size_t save(const double& val)
         {
             return _doubles.insert(val);
@@ -0,0 +1,87 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Math/Scalar.h"
+#include "Utils/Array.h"
+
+namespace Rt2::Eq
+{
+    /// <summary>
+    /// Caller owned view of a variable's storage.
+    /// The stride is the distance in bytes between consecutive rows,
+    /// which covers a single value (stride 0), a contiguous column in a
+    /// struct-of-arrays layout (stride sizeof(T)) and a field inside
+    /// an array-of-structs layout (stride sizeof(struct)).
+    /// </summary>
+    template <typename T>
+    struct BasicStridedView
+    {
+        T*     data{nullptr};
+        size_t stride{0};
+
+        bool isBound() const;
+
+        T& at(size_t row) const;
+
+        static BasicStridedView value(T* value);
+
+        static BasicStridedView column(T* values);
+
+        static BasicStridedView field(T* first, size_t structSize);
+    };
+
+    using StridedView   = BasicStridedView<Math::Real>;
+    using StridedViewF  = BasicStridedView<float>;
+    using BindingArray  = SimpleArray<StridedView>;
+    using BindingArrayF = SimpleArray<StridedViewF>;
+
+    template <typename T>
+    bool BasicStridedView<T>::isBound() const
+    {
+        return data != nullptr;
+    }
+
+    template <typename T>
+    T& BasicStridedView<T>::at(const size_t row) const
+    {
+        return *(T*)((U8*)data + row * stride);
+    }
+
+    template <typename T>
+    BasicStridedView<T> BasicStridedView<T>::value(T* value)
+    {
+        return {value, 0};
+    }
+
+    template <typename T>
+    BasicStridedView<T> BasicStridedView<T>::column(T* values)
+    {
+        return {values, sizeof(T)};
+    }
+
+    template <typename T>
+    BasicStridedView<T> BasicStridedView<T>::field(T* first, const size_t structSize)
+    {
+        return {first, structSize};
+    }
+
+}  // namespace Rt2::Eq
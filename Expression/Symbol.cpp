@@ -21,6 +21,7 @@
 */
 #include "Expression/Symbol.h"
 #include "Math/Print.h"
+#include <atomic>
 
 namespace Rt2::Eq
 {
@@ -31,6 +32,12 @@ namespace Rt2::Eq
 
     Symbol::~Symbol() = default;
 
+    U64 Symbol::nextGeneration()
+    {
+        static std::atomic<U64> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
     void Symbol::print() const
     {
         OutputStringStream oss;
@@ -81,6 +88,33 @@ namespace Rt2::Eq
         case BitwiseNot:
             out << "bNot";
             break;
+        case Less:
+            out << "LT";
+            break;
+        case LessEqual:
+            out << "LE";
+            break;
+        case Greater:
+            out << "GT";
+            break;
+        case GreaterEqual:
+            out << "GE";
+            break;
+        case Equal:
+            out << "CEQ";
+            break;
+        case NotEqual:
+            out << "CNE";
+            break;
+        case And:
+            out << "AND";
+            break;
+        case Or:
+            out << "OR";
+            break;
+        case Select:
+            out << "SEL";
+            break;
         case MathAbs:
             out << "abs";
             break;
@@ -141,6 +175,24 @@ namespace Rt2::Eq
         case MathTanh:
             out << "Tanh";
             break;
+        case MathSum:
+            out << "Sum";
+            break;
+        case MathMin:
+            out << "Min";
+            break;
+        case MathMax:
+            out << "Max";
+            break;
+        case MathMean:
+            out << "Mean";
+            break;
+        case MathDot:
+            out << "Dot";
+            break;
+        case MathNorm:
+            out << "Norm";
+            break;
         case UserFunction:
         case None:
         default:
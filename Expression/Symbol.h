@@ -45,6 +45,15 @@ namespace Rt2::Eq
         Neg,
         Not,
         BitwiseNot,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        Equal,
+        NotEqual,
+        And,
+        Or,
+        Select,
 
         // math
         MathAbs,
@@ -67,6 +76,15 @@ namespace Rt2::Eq
         MathSqrt,
         MathTan,
         MathTanh,
+
+        // reductions
+        MathSum,
+        MathMin,
+        MathMax,
+        MathMean,
+        MathDot,
+        MathNorm,
+
         MathPi,
         MathE
     };
@@ -77,6 +95,8 @@ namespace Rt2::Eq
         SymbolType _type{None};
         Math::Real _value{0};
         String     _name{};
+        I32        _line{0};
+        U64        _generation{0};
 
     public:
         Symbol() = default;
@@ -91,8 +111,25 @@ namespace Rt2::Eq
 
         void setType(SymbolType value);
 
+        /// <summary>
+        /// Sets the source line of the statement that the symbol
+        /// belongs to. Zero means the line is not known.
+        /// </summary>
+        void setLine(I32 line);
+
+        /// <summary>
+        /// Sets the generation of the source that created the symbol.
+        /// Owners stamp every symbol of one source with the same value
+        /// from nextGeneration. Zero means the symbol was not stamped.
+        /// </summary>
+        void setGeneration(U64 generation);
+
         SymbolType type() const;
 
+        I32 line() const;
+
+        U64 generation() const;
+
         const String& name() const;
 
         Math::Real value() const;
@@ -100,6 +137,11 @@ namespace Rt2::Eq
         void print() const;
 
         void print(OStream& out) const;
+
+        /// <summary>
+        /// Returns a generation that no earlier call returned.
+        /// </summary>
+        static U64 nextGeneration();
     };
 
     inline Math::Real Symbol::value() const
@@ -117,6 +159,26 @@ namespace Rt2::Eq
         _type = value;
     }
 
+    inline I32 Symbol::line() const
+    {
+        return _line;
+    }
+
+    inline void Symbol::setLine(const I32 line)
+    {
+        _line = line;
+    }
+
+    inline U64 Symbol::generation() const
+    {
+        return _generation;
+    }
+
+    inline void Symbol::setGeneration(const U64 generation)
+    {
+        _generation = generation;
+    }
+
     inline void Symbol::setName(const String& str)
     {
         _name = str;
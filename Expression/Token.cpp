@@ -48,6 +48,13 @@ namespace Rt2::Eq
         case TOK_SQRT:
         case TOK_TAN:
         case TOK_TANH:
+        case TOK_SUM:
+        case TOK_MIN:
+        case TOK_MAX:
+        case TOK_MEAN:
+        case TOK_DOT:
+        case TOK_NORM:
+        case TOK_SELECT:
             return true;
         default:
             return false;
@@ -115,6 +122,18 @@ namespace Rt2::Eq
             return MathTan;
         case TOK_TANH:
             return MathTanh;
+        case TOK_SUM:
+            return MathSum;
+        case TOK_MIN:
+            return MathMin;
+        case TOK_MAX:
+            return MathMax;
+        case TOK_MEAN:
+            return MathMean;
+        case TOK_DOT:
+            return MathDot;
+        case TOK_NORM:
+            return MathNorm;
         case TOK_PI:
             return MathPi;
         // case TOK_E:
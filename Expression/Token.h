@@ -27,7 +27,7 @@ namespace Rt2::Eq
 {
     enum TokenType
     {
-        TOK_KW_ST = -27,
+        TOK_KW_ST = -34,
         TOK_ABS,
         TOK_ACOS,
         TOK_ASIN,
@@ -48,6 +48,13 @@ namespace Rt2::Eq
         TOK_SQRT,
         TOK_TAN,
         TOK_TANH,
+        TOK_SUM,
+        TOK_MIN,
+        TOK_MAX,
+        TOK_MEAN,
+        TOK_DOT,
+        TOK_NORM,
+        TOK_SELECT,
         //TOK_E,
         TOK_PI,
         TOK_EPSILON,
@@ -57,6 +64,12 @@ namespace Rt2::Eq
         TOK_IDENTIFIER,
         TOK_INT,  // remove
         TOK_FLOAT,
+        TOK_LE,  // <=
+        TOK_GE,  // >=
+        TOK_EQ,  // ==
+        TOK_NE,  // !=
+        TOK_LAND,  // &&
+        TOK_LOR,   // ||
         TOK_EQUALS    = '=',
         TOK_O_BRACKET = '{',
         TOK_C_BRACKET = '}',
@@ -76,6 +89,10 @@ namespace Rt2::Eq
         TOK_PERIOD    = '.',
         TOK_NOT       = '!',
         TOK_COMMA     = ',',
+        TOK_LESS      = '<',
+        TOK_GREATER   = '>',
+        TOK_QUESTION  = '?',
+        TOK_COLON     = ':',
     };
 
     using Token = Rt2::TokenBase;
@@ -104,6 +121,9 @@ namespace Rt2::Eq
         { "sinh",  TOK_SINH, 4},
         { "sqrt",  TOK_SQRT, 4},
         { "tanh",  TOK_TANH, 4},
+        { "mean",  TOK_MEAN, 4},
+        { "norm",  TOK_NORM, 4},
+        {"select", TOK_SELECT, 6},
         {  "cos",   TOK_COS, 3},
         {  "exp",   TOK_EXP, 3},
         {  "log",   TOK_LOG, 3},
@@ -111,6 +131,10 @@ namespace Rt2::Eq
         {  "pow",   TOK_POW, 3},
         {  "sin",   TOK_SIN, 3},
         {  "tan",   TOK_TAN, 3},
+        {  "sum",   TOK_SUM, 3},
+        {  "min",   TOK_MIN, 3},
+        {  "max",   TOK_MAX, 3},
+        {  "dot",   TOK_DOT, 3},
         {   "pi",    TOK_PI, 2},
         //{    "e",     TOK_E, 1},
     };
@@ -120,6 +144,20 @@ namespace Rt2::Eq
         return c == TOK_O_PAR || c == TOK_O_BRACKET || c == TOK_O_BRACE;
     }
 
+    inline bool isCallOnlyKeyword(const int8_t c)
+    {
+        // The reductions and select came after variables with the
+        // same names were in use, so they stay usable as names.
+        return c >= TOK_SUM && c <= TOK_SELECT;
+    }
+
+    inline bool isComparisonToken(const int8_t c)
+    {
+        return c == TOK_LESS || c == TOK_GREATER ||
+               c == TOK_LE || c == TOK_GE ||
+               c == TOK_EQ || c == TOK_NE;
+    }
+
     inline bool isNumericalToken(const int8_t c)
     {
         return c == TOK_INT || c == TOK_FLOAT;
@@ -155,7 +193,7 @@ namespace Rt2::Eq
 
     inline bool isValidCharacter(const int ch)
     {
-        if (ch == '"' || ch == '<')
+        if (ch == '"')
             return false;
 
         return ch >= ' ' && ch <= 127;
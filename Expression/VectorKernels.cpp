@@ -0,0 +1,126 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Expression/VectorKernels.h"
+#include <cmath>
+
+namespace Rt2::Eq::Vector
+{
+    constexpr size_t Lanes         = 8;
+    constexpr size_t PairwiseBlock = 16 * Lanes;
+
+    template <typename Term>
+    Math::Real pairwise(const size_t n, Term term, const size_t offs = 0)
+    {
+        if (n <= PairwiseBlock)
+        {
+            Math::Real acc[Lanes] = {};
+
+            size_t i = 0;
+            for (; i + Lanes <= n; i += Lanes)
+            {
+                for (size_t k = 0; k < Lanes; ++k)
+                    acc[k] += term(offs + i + k);
+            }
+
+            Math::Real rem = 0;
+            for (; i < n; ++i)
+                rem += term(offs + i);
+
+            return ((acc[0] + acc[1]) + (acc[2] + acc[3])) +
+                   ((acc[4] + acc[5]) + (acc[6] + acc[7])) +
+                   rem;
+        }
+
+        // split on a lane boundary so that both
+        // halves keep the unit stride inner loop
+        const size_t half = (n / 2) & ~(Lanes - 1);
+        return pairwise(half, term, offs) +
+               pairwise(n - half, term, offs + half);
+    }
+
+    Math::Real sum(const ValueSpan& a)
+    {
+        const Math::Real* pa = a.data;
+        return pairwise(a.size, [pa](const size_t i)
+                        { return pa[i]; });
+    }
+
+    Math::Real minimum(const ValueSpan& a)
+    {
+        Math::Real acc[Lanes];
+        for (Math::Real& v : acc)
+            v = INFINITY;
+
+        const Math::Real* pa = a.data;
+
+        size_t i = 0;
+        for (; i + Lanes <= a.size; i += Lanes)
+        {
+            for (size_t k = 0; k < Lanes; ++k)
+                acc[k] = pa[i + k] < acc[k] ? pa[i + k] : acc[k];
+        }
+        for (; i < a.size; ++i)
+            acc[0] = pa[i] < acc[0] ? pa[i] : acc[0];
+
+        Math::Real r = acc[0];
+        for (size_t k = 1; k < Lanes; ++k)
+            r = acc[k] < r ? acc[k] : r;
+        return r;
+    }
+
+    Math::Real maximum(const ValueSpan& a)
+    {
+        Math::Real acc[Lanes];
+        for (Math::Real& v : acc)
+            v = -INFINITY;
+
+        const Math::Real* pa = a.data;
+
+        size_t i = 0;
+        for (; i + Lanes <= a.size; i += Lanes)
+        {
+            for (size_t k = 0; k < Lanes; ++k)
+                acc[k] = pa[i + k] > acc[k] ? pa[i + k] : acc[k];
+        }
+        for (; i < a.size; ++i)
+            acc[0] = pa[i] > acc[0] ? pa[i] : acc[0];
+
+        Math::Real r = acc[0];
+        for (size_t k = 1; k < Lanes; ++k)
+            r = acc[k] > r ? acc[k] : r;
+        return r;
+    }
+
+    Math::Real dot(const ValueSpan& a, const ValueSpan& b)
+    {
+        if (a.size == 1)
+            return a[0] * sum(b);
+        if (b.size == 1)
+            return b[0] * sum(a);
+
+        const Math::Real* pa = a.data;
+        const Math::Real* pb = b.data;
+        return pairwise(std::min(a.size, b.size), [pa, pb](const size_t i)
+                        { return pa[i] * pb[i]; });
+    }
+
+}  // namespace Rt2::Eq::Vector
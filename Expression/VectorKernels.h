@@ -0,0 +1,83 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Expression/ListStorage.h"
+
+namespace Rt2::Eq::Vector
+{
+    // Element-wise kernels over contiguous list storage.
+    // Operands are broadcast when one side has a single element,
+    // which keeps every loop a unit stride loop the compiler can
+    // vectorize when op is inlined.
+
+    template <typename Op>
+    void apply(Math::Real* dest, const ValueSpan& a, Op op)
+    {
+        const Math::Real* pa = a.data;
+        for (size_t i = 0; i < a.size; ++i)
+            dest[i] = op(pa[i]);
+    }
+
+    template <typename Op>
+    void apply(Math::Real* dest, const ValueSpan& a, const ValueSpan& b, Op op)
+    {
+        const Math::Real* pa = a.data;
+        const Math::Real* pb = b.data;
+
+        if (a.size == b.size)
+        {
+            for (size_t i = 0; i < a.size; ++i)
+                dest[i] = op(pa[i], pb[i]);
+        }
+        else if (a.size == 1)
+        {
+            const Math::Real sa = pa[0];
+            for (size_t i = 0; i < b.size; ++i)
+                dest[i] = op(sa, pb[i]);
+        }
+        else
+        {
+            const Math::Real sb = pb[0];
+            for (size_t i = 0; i < a.size; ++i)
+                dest[i] = op(pa[i], sb);
+        }
+    }
+
+    inline bool isBroadcastable(const size_t a, const size_t b)
+    {
+        return a == b || a == 1 || b == 1;
+    }
+
+    // Reductions. Sums use pairwise summation over blocks that are
+    // accumulated in independent lanes, so the result is both more
+    // accurate than a running sum and independent of the machine.
+
+    extern Math::Real sum(const ValueSpan& a);
+
+    extern Math::Real minimum(const ValueSpan& a);
+
+    extern Math::Real maximum(const ValueSpan& a);
+
+    // Broadcasts when either side has a single element.
+    extern Math::Real dot(const ValueSpan& a, const ValueSpan& b);
+
+}  // namespace Rt2::Eq::Vector
@@ -31,6 +31,26 @@ GTEST_TEST(Expression, Parse00c)
     EXPECT_DOUBLE_EQ((int)eval.peek(0), 2000.0);
 }
 
+GTEST_TEST(Expression, Parse00d)
+{
+    // a group that starts an assigned expression is not a list
+    StringStream ss;
+    ss << "y = (x + 1) * 2, z = (y) / 4, w = (1, 2)";
+
+    StatementParser code;
+    code.read(ss);
+
+    Statement eval;
+    eval.set("x", 2);
+    eval.execute(code.symbols());
+    EXPECT_DOUBLE_EQ(eval.get("y"), 6.0);
+    EXPECT_DOUBLE_EQ(eval.get("z"), 1.5);
+
+    ValueList w;
+    eval.get("w", w);
+    EXPECT_EQ(w.size(), 2);
+}
+
 GTEST_TEST(Expression, Parse00b)
 {
     StringStream ss;
@@ -0,0 +1,1493 @@
+#include <thread>
+#include "Expression/BoxedValue.h"
+#include "Expression/ColumnFile.h"
+#include "Expression/Differentiator.h"
+#include "Expression/CorpusGenerator.h"
+#include "Expression/CsvPipeline.h"
+#include "Expression/ExecutionContext.h"
+#include "Expression/FunctionRegistry.h"
+#include "Expression/Metrics.h"
+#include "Expression/OpcodeHistogram.h"
+#include "Expression/Profiler.h"
+#include "Expression/Program.h"
+#include "Expression/Statement.h"
+#include "Expression/StatementParser.h"
+#include "Expression/VectorKernels.h"
+#include "Utils/StreamMethods.h"
+#include "gtest/gtest.h"
+
+using namespace Rt2::Math;
+using namespace Rt2::Eq;
+using namespace Rt2;
+
+ProgramPtr compileString(const String& source, const Precision precision = PrecisionFloat64)
+{
+    StringStream ss;
+    ss << source;
+
+    StatementParser parse;
+    parse.read(ss);
+    return Program::compile(parse.symbols(), precision);
+}
+
+ProgramPtr compileString(const String& source, const FunctionRegistry& functions)
+{
+    StringStream ss;
+    ss << source;
+
+    StatementParser parse;
+    parse.read(ss);
+    return Program::compile(parse.symbols(), functions);
+}
+
+GTEST_TEST(Program, Compile000)
+{
+    const ProgramPtr program = compileString("y = 7+2*x");
+
+    EXPECT_EQ(program->code().size(), 7);
+    EXPECT_EQ(program->slots().size(), 2);
+    EXPECT_EQ(program->indexOf("y"), 0);
+    EXPECT_EQ(program->indexOf("x"), 1);
+    EXPECT_EQ(program->indexOf("z"), Npos);
+
+    ExecutionContext ctx(program);
+    ctx.set("x", 3);
+    EXPECT_DOUBLE_EQ(ctx.execute(), 13);
+    EXPECT_DOUBLE_EQ(ctx.get("y"), 13);
+
+    // unknown names are not part of the layout
+    ctx.set("z", 3);
+    EXPECT_DOUBLE_EQ(ctx.get("z", -1), -1);
+}
+
+GTEST_TEST(Program, Shared001)
+{
+    // The parser may go away once the program is compiled.
+    const ProgramPtr program = compileString("a=sin(x/2),b=a*x");
+
+    constexpr int Threads = 4;
+    constexpr int Steps   = 1000;
+
+    Real results[Threads] = {};
+
+    std::thread workers[Threads];
+    for (int t = 0; t < Threads; ++t)
+    {
+        workers[t] = std::thread([&program, &results, t]
+                                 {
+            ExecutionContext ctx(program);
+            const VInt x = ctx.indexOf("x");
+
+            Real sum = 0;
+            for (int i = 0; i < Steps; ++i)
+            {
+                ctx.set(x, Real(t + i) / Steps);
+                ctx.execute();
+                sum += ctx.get("b");
+            }
+            results[t] = sum; });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    ExecutionContext ctx(program);
+    for (int t = 0; t < Threads; ++t)
+    {
+        Real sum = 0;
+        for (int i = 0; i < Steps; ++i)
+        {
+            const Real x = Real(t + i) / Steps;
+            sum += sin(x / 2) * x;
+        }
+        EXPECT_DOUBLE_EQ(results[t], sum);
+    }
+}
+
+GTEST_TEST(Program, Bind002)
+{
+    const ProgramPtr program = compileString("y = 2*x + b");
+
+    struct Row
+    {
+        Real x, y;
+    };
+
+    Row rows[5];
+    for (int i = 0; i < 5; ++i)
+        rows[i] = {Real(i), -1};
+
+    ExecutionContext ctx(program);
+    ctx.set("b", 1);
+    ctx.bind("x", StridedView::field(&rows[0].x, sizeof(Row)));
+    ctx.bind("y", StridedView::field(&rows[0].y, sizeof(Row)));
+
+    for (int i = 0; i < 5; ++i)
+    {
+        ctx.select(i);
+        EXPECT_DOUBLE_EQ(ctx.execute(), 2 * i + 1);
+        EXPECT_DOUBLE_EQ(rows[i].y, 2 * i + 1);
+    }
+
+    // writes to a bound slot go to the caller's memory
+    Real b = 0;
+    ctx.bind("b", StridedView::value(&b));
+    ctx.set("b", 3);
+    EXPECT_DOUBLE_EQ(b, 3);
+    ctx.select(0);
+    EXPECT_DOUBLE_EQ(ctx.execute(), 3);
+}
+
+GTEST_TEST(Program, Batch003)
+{
+    const ProgramPtr program = compileString("a=sin(x/2),y=a*x+c");
+
+    constexpr int Rows = 200;
+
+    Real x[Rows], y[Rows], res[Rows];
+    for (int i = 0; i < Rows; ++i)
+    {
+        x[i] = Real(i) / Rows;
+        y[i] = 0;
+    }
+
+    ExecutionContext ctx(program);
+    ctx.set("c", 0.5);
+    ctx.bind("x", StridedView::column(x));
+    ctx.bind("y", StridedView::column(y));
+
+    EXPECT_TRUE(ctx.executeBatch(Rows, res));
+
+    for (int i = 0; i < Rows; ++i)
+    {
+        const Real e = sin(x[i] / 2) * x[i] + 0.5;
+        EXPECT_DOUBLE_EQ(y[i], e);
+        EXPECT_DOUBLE_EQ(res[i], e);
+    }
+
+    // the unbound output holds the last row
+    EXPECT_DOUBLE_EQ(ctx.get("a"), sin(x[Rows - 1] / 2));
+
+    EXPECT_FALSE(ExecutionContext(compileString("y={1,2}")).executeBatch(4));
+}
+
+GTEST_TEST(Program, Lists004)
+{
+    const ProgramPtr program = compileString("x={0,1,2,3}, y=[a,a+1,2*a]");
+
+    // the constant literal is folded into a single instruction
+    EXPECT_EQ(program->lists().size(), 1);
+    EXPECT_EQ(program->code()[1].op, ConstantList);
+
+    ExecutionContext ctx(program);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        ctx.set("a", i);
+        EXPECT_EQ(ctx.execute(), Eq::InitialHash + 1);
+
+        const ValueSpan x = ctx.list("x");
+        ASSERT_EQ(x.size, 4);
+        EXPECT_EQ(x[0], 0);
+        EXPECT_EQ(x[3], 3);
+
+        const ValueSpan y = ctx.list("y");
+        ASSERT_EQ(y.size, 3);
+        EXPECT_EQ(y[0], i);
+        EXPECT_EQ(y[1], i + 1);
+        EXPECT_EQ(y[2], 2 * i);
+    }
+
+    EXPECT_TRUE(ctx.list("a").empty());
+
+    // list literals are terms of any expression
+    ExecutionContext terms(compileString("y={1,2}+x, s=sum({1,2,3})*x, z=2*(x,x+1), g=(x+1)*2"));
+    terms.set("x", 3);
+    terms.execute();
+    ASSERT_EQ(terms.list("y").size, 2);
+    EXPECT_EQ(terms.list("y")[1], 5);
+    EXPECT_EQ(terms.get("s"), 18);
+    ASSERT_EQ(terms.list("z").size, 2);
+    EXPECT_EQ(terms.list("z")[1], 8);
+    EXPECT_EQ(terms.get("g"), 8);
+
+    StringStream ss;
+    ss << "y = 1 + {1, 2)";
+    StatementParser parse;
+    EXPECT_THROW(parse.read(ss), Exception);
+}
+
+GTEST_TEST(Program, Vector005)
+{
+    const ProgramPtr program = compileString(
+        "x={0,1,2,3}, v=[a,a,a,a], y=x*2+1, z=x*v-sin(x), w=atan2(x,2)");
+
+    ExecutionContext ctx(program);
+    ctx.set("a", 3);
+    ctx.execute();
+
+    const ValueSpan y = ctx.list("y");
+    const ValueSpan z = ctx.list("z");
+    const ValueSpan w = ctx.list("w");
+    ASSERT_EQ(y.size, 4);
+    ASSERT_EQ(z.size, 4);
+    ASSERT_EQ(w.size, 4);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_DOUBLE_EQ(y[i], i * 2 + 1);
+        EXPECT_DOUBLE_EQ(z[i], -sin(Real(i)) + i * 3);
+        EXPECT_DOUBLE_EQ(w[i], atan2(Real(i), 2));
+    }
+
+    // lists of different sizes do not broadcast
+    ExecutionContext bad(compileString("x={0,1,2,3}, y={1,2}, z=x+y"));
+    EXPECT_EQ(bad.execute(), 0);
+    EXPECT_TRUE(bad.list("z").empty());
+    EXPECT_EQ(bad.status().code, ErrorListSize);
+}
+
+GTEST_TEST(Program, Reduce006)
+{
+    const ProgramPtr program = compileString(
+        "x={1,2,3,4}, y=[2,2,2,2], s=sum(x), m=mean(x,y), "
+        "lo=min(x), hi=max(x*y, 3), d=dot(x,y), n=norm(x)");
+
+    ExecutionContext ctx(program);
+    ctx.execute();
+
+    EXPECT_DOUBLE_EQ(ctx.get("s"), 10);
+    EXPECT_DOUBLE_EQ(ctx.get("m"), 18.0 / 8.0);
+    EXPECT_DOUBLE_EQ(ctx.get("lo"), 1);
+    EXPECT_DOUBLE_EQ(ctx.get("hi"), 8);
+    EXPECT_DOUBLE_EQ(ctx.get("d"), 20);
+    EXPECT_DOUBLE_EQ(ctx.get("n"), sqrt(30.0));
+
+    // the reduction names are keywords only when called
+    ExecutionContext names(compileString("min = 0, max = x, sum = max (min, 2) + max"));
+    names.set("x", 5);
+    names.execute();
+    EXPECT_DOUBLE_EQ(names.get("min"), 0);
+    EXPECT_DOUBLE_EQ(names.get("sum"), 7);
+
+    // large enough to take the pairwise path
+    constexpr int Size = 1000;
+
+    ValueList data;
+    Real      expected = 0;
+    for (int i = 0; i < Size; ++i)
+    {
+        data.push_back(Real(i) * 0.1);
+        expected += Real(i) * 0.1;
+    }
+    EXPECT_NEAR(Vector::sum({data.data(), data.size()}), expected, 1e-9);
+    EXPECT_DOUBLE_EQ(Vector::maximum({data.data(), data.size()}), 99.9);
+
+    // scalars reduce lane by lane in batch mode
+    Real a[3] = {1, -5, 3}, r[3];
+
+    ExecutionContext batch(compileString("max(a, 0) + norm(a)"));
+    batch.bind("a", StridedView::column(a));
+    EXPECT_TRUE(batch.executeBatch(3, r));
+    EXPECT_DOUBLE_EQ(r[0], 2);
+    EXPECT_DOUBLE_EQ(r[1], 5);
+    EXPECT_DOUBLE_EQ(r[2], 6);
+}
+
+GTEST_TEST(Program, Status007)
+{
+    Symbol add(Add);
+    Symbol one(Numerical);
+    one.setValue(1);
+
+    SymbolArray code;
+    code.push_back(&one);
+    code.push_back(&add);
+
+    // the simulated depth is not trusted past an underflow
+    const ProgramPtr program = Program::compile(code);
+    EXPECT_EQ(program->stackDepth(), code.size());
+    EXPECT_EQ(compileString("y = (a + b)*(c + d)")->stackDepth(), 4);
+
+    ExecutionContext ctx(program);
+    EXPECT_EQ(ctx.execute(), 0);
+    EXPECT_FALSE(ctx.status().ok());
+    EXPECT_EQ(ctx.status().code, ErrorStackUnderflow);
+    EXPECT_EQ(ctx.status().instruction, 1);
+    EXPECT_NE(ctx.status().message().find("add"), String::npos);
+
+    // a group count of zero or past the stack is an underflow too
+    Symbol count(Numerical), group(Grouping);
+    for (const int nr : {0, 3})
+    {
+        count.setValue(nr);
+
+        SymbolArray list;
+        list.push_back(&one);
+        list.push_back(&count);
+        list.push_back(&group);
+
+        ExecutionContext bad(Program::compile(list));
+        bad.execute();
+        EXPECT_EQ(bad.status().code, ErrorStackUnderflow);
+    }
+
+    Real     x[100], res[100];
+    ErrorMask mask;
+    for (int i = 0; i < 100; ++i)
+        x[i] = i % 7 == 0 ? -1 : i;
+
+    ExecutionContext batch(compileString("y = sqrt(x)"));
+    batch.bind("x", StridedView::column(x));
+    EXPECT_TRUE(batch.executeBatch(100, res, &mask));
+    EXPECT_EQ(batch.status().code, ErrorDomain);
+
+    EXPECT_EQ(mask.count(), 15);
+    for (int i = 0; i < 100; ++i)
+        EXPECT_EQ(mask.test(i), i % 7 == 0);
+
+    // a failure in the code itself fails every row
+    EXPECT_FALSE(ExecutionContext(Program::compile(code)).executeBatch(100, res, &mask));
+    EXPECT_EQ(mask.count(), 100);
+}
+
+GTEST_TEST(Program, Boxed008)
+{
+    EXPECT_EQ(sizeof(BoxedValue), 8);
+
+    const BoxedValue v(-2.5);
+    EXPECT_TRUE(v.isValue());
+    EXPECT_DOUBLE_EQ(v.value(), -2.5);
+
+    const BoxedValue id = BoxedValue::id(7);
+    EXPECT_TRUE(id.isId());
+    EXPECT_EQ(id.index(), 7);
+
+    const BoxedValue ls = BoxedValue::list(InitialHash + 3);
+    EXPECT_TRUE(ls.isList());
+    EXPECT_FALSE(ls.isValue());
+    EXPECT_EQ(ls.integer(), InitialHash + 3);
+
+    // NaNs of any sign or payload stay values
+    const BoxedValue nan(-NAN);
+    EXPECT_TRUE(nan.isValue());
+    EXPECT_TRUE(std::isnan(nan.value()));
+    EXPECT_TRUE(BoxedValue(INFINITY).isValue());
+    EXPECT_TRUE(BoxedValue(-INFINITY).isValue());
+}
+
+GTEST_TEST(Program, Precision009)
+{
+    constexpr int Size = 200;
+
+    float x[Size], y[Size], r[Size];
+    for (int i = 0; i < Size; ++i)
+        x[i] = float(i) * 0.01f;
+
+    ExecutionContext ctx(compileString("y = 2*sin(x) + x/4", PrecisionFloat32));
+    EXPECT_EQ(ctx.program().precision(), PrecisionFloat32);
+    EXPECT_FLOAT_EQ(ctx.program().constantPool<float>()[0], 2.f);
+
+    ctx.bind("x", StridedViewF::column(x));
+    ctx.bind("y", StridedViewF::column(y));
+    EXPECT_TRUE(ctx.executeBatch(Size, r));
+    for (int i = 0; i < Size; ++i)
+    {
+        EXPECT_NEAR(y[i], 2 * sin(Real(x[i])) + Real(x[i]) / 4, 1e-5);
+        EXPECT_FLOAT_EQ(r[i], y[i]);
+    }
+
+    // the row at a time path reads and writes the same float views
+    ctx.select(10);
+    EXPECT_NEAR(ctx.execute(), 2 * sin(Real(x[10])) + Real(x[10]) / 4, 1e-5);
+
+    // results must match the program's precision
+    Real wide[Size];
+    EXPECT_FALSE(ctx.executeBatch(Size, wide));
+    EXPECT_EQ(ctx.status().code, ErrorUnsupported);
+
+    // both precisions treat the same divisors as zero
+    float fd[3] = {1e-10f, 1e-17f, 0}, fq[3];
+    Real  dd[3] = {1e-10, 1e-17, 0}, dq[3];
+
+    ExecutionContext narrow(compileString("q = 1/d", PrecisionFloat32));
+    narrow.bind("d", StridedViewF::column(fd));
+    EXPECT_TRUE(narrow.executeBatch(3, fq));
+
+    ExecutionContext full(compileString("q = 1/d"));
+    full.bind("d", StridedView::column(dd));
+    EXPECT_TRUE(full.executeBatch(3, dq));
+
+    EXPECT_NEAR(fq[0], 1e10, 1e4);
+    EXPECT_NEAR(dq[0], 1e10, 1e-2);
+    for (int i = 1; i < 3; ++i)
+    {
+        EXPECT_TRUE(std::isnan(fq[i]));
+        EXPECT_TRUE(std::isnan(dq[i]));
+    }
+
+    // views of the other precision are converted in the batch paths too
+    float fx[3] = {1, 2, 3}, fy[3] = {};
+    ExecutionContext mixed(compileString("y = x * 2"));
+    mixed.bind("x", StridedViewF::column(fx));
+    mixed.bind("y", StridedViewF::column(fy));
+    EXPECT_TRUE(mixed.executeBatch(3));
+    EXPECT_FLOAT_EQ(fy[0], 2);
+    EXPECT_FLOAT_EQ(fy[2], 6);
+}
+
+GTEST_TEST(Program, Recompute010)
+{
+    const ProgramPtr program = compileString("a = x*2, b = y+1, c = a+b, d = f = x+3, e = 7");
+
+    const DependencyGraph& graph = program->graph();
+    EXPECT_EQ(graph.size(), 5);
+    EXPECT_TRUE(graph.incremental());
+    EXPECT_EQ(graph.readers(program->indexOf("x")).size, 2);
+    EXPECT_EQ(graph.writes(3).size, 2);
+
+    ExecutionContext ctx(program);
+    ctx.set("x", 1);
+    ctx.set("y", 1);
+
+    // the first recompute runs everything
+    EXPECT_EQ(ctx.recompute(), 5);
+    EXPECT_DOUBLE_EQ(ctx.get("c"), 4);
+    EXPECT_EQ(ctx.recompute(), 0);
+
+    // y only reaches b and c
+    ctx.set("y", 10);
+    EXPECT_EQ(ctx.recompute(), 2);
+    EXPECT_DOUBLE_EQ(ctx.get("b"), 11);
+    EXPECT_DOUBLE_EQ(ctx.get("c"), 13);
+
+    // x reaches a, c and d
+    ctx.set("x", 2);
+    EXPECT_EQ(ctx.recompute(), 3);
+    EXPECT_DOUBLE_EQ(ctx.get("c"), 15);
+    EXPECT_DOUBLE_EQ(ctx.get("f"), 5);
+
+    // memory written behind the context's back has to be invalidated
+    Real z = 1;
+    ExecutionContext bound(compileString("w = z*z, v = 3"));
+    bound.bind("z", StridedView::value(&z));
+    EXPECT_EQ(bound.recompute(), 2);
+    z = 4;
+    bound.invalidate(bound.indexOf("z"));
+    EXPECT_EQ(bound.recompute(), 1);
+    EXPECT_DOUBLE_EQ(bound.get("w"), 16);
+
+    // a variable that is assigned twice, or read before it
+    // is assigned, makes the program run in full
+    EXPECT_FALSE(compileString("a = x, b = a, a = 2")->graph().incremental());
+    EXPECT_FALSE(compileString("a = a + x")->graph().incremental());
+
+    ExecutionContext full(compileString("a = a + x"));
+    full.set("x", 1);
+    EXPECT_EQ(full.recompute(), 1);
+    EXPECT_EQ(full.recompute(), 1);
+    EXPECT_DOUBLE_EQ(full.get("a"), 2);
+}
+
+GTEST_TEST(Program, Functions011)
+{
+    FunctionRegistry functions;
+    functions.add("clamp01",
+                  1,
+                  [](const Real* a, U32) -> Real
+                  { return a[0] < 0 ? 0 : a[0] > 1 ? 1 : a[0]; });
+
+    const U32 hyp = functions.add(
+        "hyp",
+        2,
+        [](const Real* a, U32) -> Real
+        { return sqrt(a[0] * a[0] + a[1] * a[1]); },
+        [](Real* out, const Real* const* a, U32, const size_t lanes)
+        {
+            for (size_t i = 0; i < lanes; ++i)
+                out[i] = sqrt(a[0][i] * a[0][i] + a[1][i] * a[1][i]);
+        });
+
+    functions.add("count",
+                  AnyArity,
+                  [](const Real*, const U32 nr) -> Real
+                  { return Real(nr); });
+
+    const ProgramPtr program = compileString("y = hyp(x, 4) + clamp01(x) + count(1, 2, 3)", functions);
+    EXPECT_EQ(program->code()[4].arg, hyp);
+
+    ExecutionContext ctx(program);
+    ctx.set("x", 3);
+    EXPECT_DOUBLE_EQ(ctx.execute(), 5 + 1 + 3);
+
+    Real x[100], r[100];
+    for (int i = 0; i < 100; ++i)
+        x[i] = Real(i);
+    ctx.bind("x", StridedView::column(x));
+    EXPECT_TRUE(ctx.executeBatch(100, r));
+    for (int i = 0; i < 100; ++i)
+        EXPECT_DOUBLE_EQ(r[i], sqrt(Real(i * i + 16)) + (i > 0 ? 1 : 0) + 3);
+
+    // names that are not registered fail when they are called
+    ExecutionContext unknown(compileString("y = nope(2)", functions));
+    EXPECT_EQ(unknown.execute(), 0);
+    EXPECT_EQ(unknown.status().code, ErrorUnknownFunction);
+    EXPECT_NE(unknown.status().message().find("nope"), String::npos);
+
+    ExecutionStatus status;
+    {
+        ExecutionContext wrong(compileString("y = hyp(2)", functions));
+        wrong.execute();
+        status = wrong.status();
+    }
+    // the status keeps the name after the program is gone
+    EXPECT_EQ(status.code, ErrorArgumentCount);
+    EXPECT_NE(status.message().find("hyp"), String::npos);
+}
+
+GTEST_TEST(Program, Inline012)
+{
+    const ProgramPtr program = compileString(
+        "sq(x) = x*x,"
+        "lerp(a, b, t) = a + (b - a)*t,"
+        "y = lerp(1, sq(x + 1), t)");
+
+    // the calls are gone, only their bodies remain
+    for (const Instruction& ins : program->code())
+        EXPECT_NE(ins.op, UserFunction);
+
+    // parameters do not become variables
+    EXPECT_EQ(program->indexOf("a"), Npos);
+    EXPECT_EQ(program->indexOf("b"), Npos);
+
+    ExecutionContext ctx(program);
+    ctx.set("x", 2);
+    ctx.set("t", 0.5);
+    EXPECT_DOUBLE_EQ(ctx.execute(), 1 + (9 - 1) * 0.5);
+
+    // definitions may follow assignments in the same list
+    ExecutionContext late(compileString("q = 1, sq(t) = t*t, y = sq(a) + q"));
+    late.set("a", 3);
+    EXPECT_DOUBLE_EQ(late.execute(), 10);
+    EXPECT_EQ(late.indexOf("t"), Npos);
+
+    StringStream ss;
+    ss << "sq(x) = x*x, y = sq(1, 2)";
+    StatementParser parse;
+    EXPECT_THROW(parse.read(ss), Exception);
+
+    // nested calls multiply in size, so the expansion is bounded
+    const String powers = "p(x) = x*x*x*x, q(x) = p(p(x)), r(x) = q(q(x)), ";
+    ExecutionContext deep(compileString(powers + "y = r(a)"));
+    deep.set("a", 1.01);
+    EXPECT_NEAR(deep.execute(), pow(1.01, 256), 1e-9);
+
+    StringStream wide;
+    wide << powers << "s(x) = r(r(x)), y = s(a)";
+    StatementParser huge;
+    try
+    {
+        huge.read(wide);
+        ADD_FAILURE();
+    }
+    catch (Exception& ex)
+    {
+        EXPECT_NE(String(ex.what()).find("'r' expands to more than"), String::npos) << ex.what();
+    }
+}
+
+GTEST_TEST(Program, Forward013)
+{
+    ExecutionContext ctx(compileString("y = x*x*sin(z) + exp(x/z) - sqrt(norm(x, z))"));
+
+    const Real x = 1.3, z = 0.7;
+    ctx.set("x", x);
+    ctx.set("z", z);
+
+    const VInt seeds[2] = {ctx.indexOf("x"), ctx.indexOf("z")};
+    Real       d[2];
+
+    const Real r  = sqrt(x * x + z * z);
+    const Real y  = x * x * sin(z) + exp(x / z) - sqrt(r);
+    const Real dx = 2 * x * sin(z) + exp(x / z) / z - 0.5 / sqrt(r) * x / r;
+    const Real dz = x * x * cos(z) - exp(x / z) * x / (z * z) - 0.5 / sqrt(r) * z / r;
+
+    EXPECT_NEAR(ctx.gradient(seeds, 2, d), y, 1e-12);
+    EXPECT_NEAR(d[0], dx, 1e-12);
+    EXPECT_NEAR(d[1], dz, 1e-12);
+    EXPECT_NEAR(ctx.get("y"), y, 1e-12);
+
+    // agrees with a central difference for every math function
+    const char* functions[] = {
+        "abs",
+        "acos",
+        "asin",
+        "atan",
+        "cos",
+        "cosh",
+        "exp",
+        "log",
+        "log10",
+        "sin",
+        "sinh",
+        "sqrt",
+        "tan",
+        "tanh",
+    };
+
+    for (const char* fn : functions)
+    {
+        ExecutionContext f(compileString(String(fn) + "(x/2) + pow(x, 3) + atan2(x, 2) + fmod(x, 0.3)"));
+
+        const VInt seed = f.indexOf("x");
+        Real       g;
+
+        constexpr Real h = 1e-6;
+        f.set(seed, 0.5 + h);
+        const Real hi = f.execute();
+        f.set(seed, 0.5 - h);
+        const Real lo = f.execute();
+
+        f.set(seed, 0.5);
+        f.gradient(&seed, 1, &g);
+        EXPECT_NEAR(g, (hi - lo) / (2 * h), 1e-6) << fn;
+    }
+}
+
+GTEST_TEST(Program, Reverse014)
+{
+    // every variable is an input, even those only assigned to
+    const char* source = "a = x*y + sin(z), b = a/z - pow(x, 2), r = sum(a, b, 2) * norm(x, y) + max(x, z)";
+
+    ExecutionContext fwd(compileString(source));
+    ExecutionContext rev(compileString(source));
+    for (ExecutionContext* ctx : {&fwd, &rev})
+    {
+        ctx->set("x", 0.8);
+        ctx->set("y", -1.7);
+        ctx->set("z", 2.1);
+    }
+
+    const size_t nr = fwd.program().slots().size();
+
+    SimpleArray<VInt> seeds;
+    for (size_t s = 0; s < nr; ++s)
+        seeds.push_back(s);
+    ValueList expected;
+    expected.resizeFast(nr);
+
+    const Real value = fwd.gradient(seeds.data(), nr, expected.data());
+
+    ValueList gradient;
+    EXPECT_NEAR(rev.gradient(gradient), value, 1e-12);
+    EXPECT_EQ(gradient.size(), nr);
+    for (size_t s = 0; s < nr; ++s)
+        EXPECT_NEAR(gradient[s], expected[s], 1e-12) << fwd.program().slots().name(s);
+
+    EXPECT_NEAR(rev.get("a"), fwd.get("a"), 1e-12);
+    EXPECT_NE(gradient[rev.indexOf("z")], 0);
+}
+
+GTEST_TEST(Program, Symbolic015)
+{
+    const char* sources[] = {
+        "3*x + y",
+        "x^3 - 2*x + 1",
+        "sin(x)*cos(x) / (1 + x*x)",
+        "a = exp(x/2), b = a*log(x) + sqrt(a), b^x",
+        "a = x*y, a = a*x + tanh(a), mean(a, x, 4) + norm(a, y)",
+        "pow(x, y) + atan2(x, y) + fmod(x, 0.3) + abs(x - 2)",
+    };
+
+    for (const char* source : sources)
+    {
+        StringStream ss;
+        ss << source;
+        StatementParser parse;
+        parse.read(ss);
+
+        Differentiator diff;
+        EXPECT_TRUE(diff.derive(parse.symbols(), "x")) << diff.error();
+
+        ExecutionContext d(Program::compile(diff.symbols()));
+        ExecutionContext f(Program::compile(parse.symbols()));
+        for (ExecutionContext* ctx : {&d, &f})
+        {
+            ctx->set("x", 1.3);
+            ctx->set("y", 0.7);
+        }
+
+        const VInt seed = f.indexOf("x");
+        Real       expected;
+        f.gradient(&seed, 1, &expected);
+
+        EXPECT_NEAR(d.execute(), expected, 1e-12) << source;
+        EXPECT_TRUE(d.status().ok());
+        if (f.program().indexOf("a") != Npos)
+        {
+            EXPECT_NEAR(d.get("a"), f.get("a"), 1e-12);
+        }
+    }
+
+    // each running min or max is held, so the size is linear in the arguments
+    StringStream wide;
+    wide << "m = max(x, 2*x, x*x, 1, x + 1, 3, x - 2, sin(x), y), min(m, x/2, y, 2, x*y, 4, cos(x), 5)";
+    StatementParser many;
+    many.read(wide);
+
+    Differentiator diffMany;
+    EXPECT_TRUE(diffMany.derive(many.symbols(), "x")) << diffMany.error();
+    const ProgramPtr derived = Program::compile(diffMany.symbols());
+    EXPECT_LT(derived->code().size(), 300);
+
+    ExecutionContext f(Program::compile(many.symbols()));
+    ExecutionContext d(derived);
+    for (const Real x : {-1.5, 0.3, 1.7, 2.5})
+    {
+        f.set("x", x);
+        d.set("x", x);
+        f.set("y", 0.7);
+        d.set("y", 0.7);
+
+        const VInt seed = f.indexOf("x");
+        Real       expected;
+        f.gradient(&seed, 1, &expected);
+        EXPECT_NEAR(d.execute(), expected, 1e-12) << x;
+        EXPECT_DOUBLE_EQ(d.get("m"), f.get("m"));
+    }
+
+    // terms that do not depend on x fold away
+    StringStream ss;
+    ss << "3*x + y*4 - cos(2)";
+    StatementParser parse;
+    parse.read(ss);
+
+    Differentiator diff;
+    EXPECT_TRUE(diff.derive(parse.symbols(), "x"));
+    EXPECT_EQ(diff.symbols().size(), 1);
+    EXPECT_DOUBLE_EQ(diff.symbols()[0]->value(), 3);
+
+    StringStream bad;
+    bad << "f(x) + 1";
+    StatementParser other;
+    other.read(bad);
+    EXPECT_FALSE(diff.derive(other.symbols(), "x"));
+    EXPECT_FALSE(diff.error().empty());
+    EXPECT_TRUE(diff.symbols().empty());
+}
+
+GTEST_TEST(Program, Select016)
+{
+    EXPECT_DOUBLE_EQ(ExecutionContext(compileString(
+                         "(1 < 2) + (2 <= 2)*2 + (3 > 4)*4 + (1 >= 2)*8 + (2 == 2)*16 + (2 != 2)*32"))
+                         .execute(),
+                     19);
+    EXPECT_DOUBLE_EQ(ExecutionContext(compileString(
+                         "(!0) + (1 && 0)*2 + (0 || 2)*4 + (3 > 1 && 2 < 1 || 1)*8 + (~2)"))
+                         .execute(),
+                     1 + 4 + 8 - 3);
+
+    // a single '&' or '|' is not a logical operator
+    for (const char* bad : {"y = a & b", "y = a | b"})
+    {
+        StringStream ss;
+        ss << bad;
+        StatementParser parse;
+        EXPECT_THROW(parse.read(ss), Exception) << bad;
+    }
+
+    // comparisons do not chain, the grouped form is fine
+    for (const char* bad : {"y = a < b < c", "y = a == b != c"})
+    {
+        StringStream ss;
+        ss << bad;
+        StatementParser parse;
+        try
+        {
+            parse.read(ss);
+            ADD_FAILURE() << bad;
+        }
+        catch (Exception& ex)
+        {
+            EXPECT_NE(String(ex.what()).find("comparisons do not chain"), String::npos) << ex.what();
+        }
+    }
+    EXPECT_DOUBLE_EQ(ExecutionContext(compileString("(1 < 2) < 3")).execute(), 1);
+
+    // '?' binds loosest, then '||', '&&' and the comparisons
+    const ProgramPtr program = compileString("y = x + 1 < 3 && x > -1 ? x*x : select(x < 0, -x, 10)");
+
+    ExecutionContext ctx(program);
+    for (const Real x : {-2.0, -0.5, 0.5, 1.5, 4.0})
+    {
+        ctx.set("x", x);
+        const Real e = x + 1 < 3 && x > -1 ? x * x : x < 0 ? -x : 10;
+        EXPECT_DOUBLE_EQ(ctx.execute(), e) << x;
+        EXPECT_DOUBLE_EQ(ctx.get("y"), e);
+    }
+
+    // both branches become lanes that are blended by the condition
+    constexpr int Rows = 150;
+
+    Real  x[Rows], y[Rows];
+    float xf[Rows], yf[Rows];
+    for (int i = 0; i < Rows; ++i)
+    {
+        x[i]  = Real(i - Rows / 2) / 25;
+        xf[i] = float(x[i]);
+    }
+
+    ctx.bind("x", StridedView::column(x));
+    ctx.bind("y", StridedView::column(y));
+    EXPECT_TRUE(ctx.executeBatch(Rows));
+
+    ExecutionContext ctxF(compileString("y = x + 1 < 3 && x > -1 ? x*x : select(x < 0, -x, 10)", PrecisionFloat32));
+    ctxF.bind("x", StridedViewF::column(xf));
+    ctxF.bind("y", StridedViewF::column(yf));
+    EXPECT_TRUE(ctxF.executeBatch(Rows, (float*)nullptr));
+
+    for (int i = 0; i < Rows; ++i)
+    {
+        const Real e = x[i] + 1 < 3 && x[i] > -1 ? x[i] * x[i] : x[i] < 0 ? -x[i] : 10;
+        EXPECT_DOUBLE_EQ(y[i], e);
+        EXPECT_FLOAT_EQ(yf[i], float(e));
+    }
+
+    // derivatives follow the selected operand
+    const char* source = "x < 0 ? -x*y : max(x*x, y) + min(x, 2)";
+    ExecutionContext d(compileString(source));
+    d.set("y", 2);
+    for (const Real v : {-1.0, 1.0, 3.0})
+    {
+        d.set("x", v);
+        const VInt seed = d.indexOf("x");
+        Real       g;
+        d.gradient(&seed, 1, &g);
+
+        ValueList gradient;
+        d.gradient(gradient);
+        EXPECT_DOUBLE_EQ(gradient[seed], g);
+        EXPECT_DOUBLE_EQ(g, v < 0 ? -2 : v * v > 2 ? 2 * v + (v < 2) : 1);
+    }
+
+    StringStream ss;
+    ss << "a < b < c";
+    StatementParser parse;
+    EXPECT_THROW(parse.read(ss), Exception);
+}
+
+GTEST_TEST(Program, Fused017)
+{
+    const char* corpus[] = {
+        "y = 7+2*x",
+        "a = x*0.5 + y*y, b = sin(a) / (a + 1), c = b*2 - x/3",
+        "r = sqrt(x*x + y*y), t = atan2(y, x), u = r*cos(t) - x",
+        "p = 3*x^2 - 2*x + 1, q = p*y + exp(x/2), q - mean(p, q, 1)",
+        "v = x < 0 ? -x*y : x + y, w = v*v - abs(x - y)",
+    };
+
+    OpcodeHistogram histogram;
+    for (const char* source : corpus)
+    {
+        ExecutionContext ctx(compileString(source));
+        ctx.set("x", 0.7);
+        ctx.set("y", -1.3);
+        histogram.add(ctx.program());
+
+        // the reference code, run by the forward evaluator,
+        // agrees with the fused code run by execute
+        const VInt seed = ctx.indexOf("x");
+        Real       g;
+        const Real expected = ctx.gradient(&seed, 1, &g);
+        EXPECT_DOUBLE_EQ(ctx.execute(), expected) << source;
+        EXPECT_TRUE(ctx.status().ok());
+    }
+
+    EXPECT_GT(histogram.count(Numerical, Identifier, Mul), 0);
+    EXPECT_GT(histogram.count(Identifier, Identifier, Mul), 0);
+    EXPECT_GT(histogram.count(Numerical, MathSin), 0);
+    EXPECT_LT(double(histogram.fused()), 0.7 * double(histogram.total()));
+
+    OpcodeCounts pairs;
+    histogram.runs(2, pairs);
+    ASSERT_FALSE(pairs.empty());
+    EXPECT_GE(pairs[0].count, pairs[pairs.size() - 1].count);
+
+    OutputStringStream out;
+    histogram.print(out, 3);
+    EXPECT_NE(out.str().find("load load mul"), String::npos);
+
+    // failures report the index in the reference code
+    ExecutionContext bad(compileString("a = {1,2}, b = {1,2,3}, z = a + x*2, w = z*b"));
+    bad.set("x", 1);
+    EXPECT_EQ(bad.execute(), 0);
+    EXPECT_EQ(bad.status().code, ErrorListSize);
+    EXPECT_EQ(bad.program().code()[bad.status().instruction].op, Mul);
+}
+
+GTEST_TEST(Program, Lines018)
+{
+    const String source =
+        "a = x*2\r\n"
+        "# comment\n"
+        "b = a + 1, c = b*b\n"
+        "\n"
+        "f(t) = t*t + 1\n"
+        "d = f(c) -\n"
+        "    a\n";
+
+    ExecutionContext ctx(compileString(source));
+    const Program&   program = ctx.program();
+
+    const IndexArray& lines = program.lines();
+    ASSERT_EQ(lines.size(), program.code().size());
+
+    // each statement is attributed to the line it starts on, and
+    // inlined function bodies, less their arguments, to the definition
+    ASSERT_EQ(program.graph().size(), 4);
+    const U32 expected[4] = {1, 3, 3, 6};
+    for (size_t s = 0; s < 4; ++s)
+    {
+        const StatementRange& range = program.graph().statement(s);
+        EXPECT_EQ(lines[range.first], expected[s]) << s;
+        EXPECT_EQ(lines[range.last - 1], expected[s]) << s;
+    }
+    size_t body = 0;
+    for (const U32 line : lines)
+        body += line == 5;
+    EXPECT_EQ(body, 3);
+
+    ctx.set("x", 1);
+    EXPECT_DOUBLE_EQ(ctx.execute(), 80.0);
+    EXPECT_DOUBLE_EQ(ctx.get("c"), 9.0);
+}
+
+GTEST_TEST(Program, Metrics019)
+{
+    // every value lies within its bucket, and the buckets are ordered
+    for (const U64 v : {U64(0), U64(15), U64(16), U64(17), U64(1000), U64(123456789)})
+    {
+        const size_t b = latencyBucket(v);
+        EXPECT_LE(v, latencyBucketLimit(b)) << v;
+        if (b > 0)
+        {
+            EXPECT_GT(v, latencyBucketLimit(b - 1)) << v;
+        }
+    }
+    EXPECT_EQ(latencyBucket(~U64(0)), LatencyBuckets - 1);
+
+    Metrics metrics;
+    Metrics::install(&metrics);
+
+    const ProgramPtr program = compileString("a = x*2, b = y + 1, c = a*b");
+
+    constexpr int Threads = 4, Runs = 250;
+
+    std::thread workers[Threads];
+    for (std::thread& worker : workers)
+    {
+        worker = std::thread(
+            [&program]
+            {
+                ExecutionContext ctx(program);
+                ctx.set("x", 1);
+                ctx.set("y", 2);
+                for (int i = 0; i < Runs; ++i)
+                    ctx.execute();
+            });
+    }
+    for (std::thread& worker : workers)
+        worker.join();
+
+    // only the statement that reads y is re-evaluated
+    ExecutionContext ctx(program);
+    ctx.execute();
+    ctx.set("y", 3);
+    EXPECT_EQ(ctx.recompute(), 2);
+
+    ExecutionContext bad(compileString("a = {x,2}, b = {x,2,3}, a + b"));
+    bad.execute();
+    Metrics::install(nullptr);
+    ctx.execute();
+
+    MetricsSnapshot snap;
+    metrics.snapshot(snap);
+    EXPECT_EQ(snap[CountCompile], 2);
+    EXPECT_GT(snap[CountProgramBytes], 0);
+    EXPECT_EQ(snap[CountExecute], Threads * Runs + 2);
+    EXPECT_EQ(snap[CountExecuteFailure], 1);
+    EXPECT_EQ(snap[CountRecompute], 1);
+    EXPECT_EQ(snap[CountCacheHit], 1);
+    EXPECT_EQ(snap[CountCacheMiss], 2);
+    EXPECT_GT(snap[CountListBytes], 0);
+
+    EXPECT_EQ(snap.execute.count, Threads * Runs + 2);
+    EXPECT_EQ(snap.recompute.count, 1);
+    EXPECT_LE(snap.execute.percentile(0.5), snap.execute.percentile(0.99));
+    EXPECT_LE(snap.execute.percentile(0.99), snap.execute.max);
+    EXPECT_EQ(snap.execute.percentile(1), snap.execute.max);
+
+    OutputStringStream text, json;
+    metrics.text(text);
+    metrics.json(json);
+    EXPECT_NE(text.str().find("expression_execute_failures_total 1\n"), String::npos);
+    EXPECT_NE(text.str().find("expression_execute_latency_ns{quantile=\"0.99\"}"), String::npos);
+    EXPECT_EQ(json.str().find("{\"compiles\":2,"), 0);
+    EXPECT_NE(json.str().find("\"execute\":{\"count\":"), String::npos);
+    EXPECT_NE(text.str().find("expression_recompute_latency_ns_count 1\n"), String::npos);
+    EXPECT_NE(json.str().find("\"recompute\":{\"count\":1,"), String::npos);
+
+    metrics.reset();
+    metrics.snapshot(snap);
+    EXPECT_EQ(snap[CountExecute], 0);
+    EXPECT_EQ(snap.execute.count, 0);
+    EXPECT_EQ(snap.recompute.count, 0);
+}
+
+GTEST_TEST(Program, Corpus020)
+{
+    CorpusOptions options;
+    options.statements = 200;
+    options.variables  = 5;
+    options.depth      = 5;
+    options.operators  = "++--**//%^<>=!&|?";
+    options.calls      = 0.3;
+    options.lists      = 0.1;
+    options.functions  = 3;
+
+    const String source = CorpusGenerator(options).generate();
+    EXPECT_EQ(source, CorpusGenerator(options).generate());
+
+    CorpusOptions reseeded = options;
+    reseeded.seed          = 2;
+    EXPECT_NE(source, CorpusGenerator(reseeded).generate());
+
+    StringStream ss;
+    ss << source;
+    StatementParser parser(0x800);
+    parser.read(ss);
+    EXPECT_EQ(parser.definitions().size(), 3);
+
+    ExecutionContext ctx(Program::compile(parser.symbols()));
+    EXPECT_EQ(ctx.program().graph().size(), options.statements);
+
+    for (U32 i = 0; i < options.variables; ++i)
+        ctx.set(CorpusGenerator::input(i), 0.25 + i);
+    ctx.execute();
+    EXPECT_TRUE(ctx.status().ok()) << ctx.status().message();
+}
+
+GTEST_TEST(Program, Csv021)
+{
+    // enough rows for several blocks of each size
+    constexpr int Rows = 1000;
+
+    StringStream in;
+    in << "x, \"y\"\r\n";
+    for (int i = 0; i < Rows; ++i)
+        in << i << ',' << (i % 7) * 0.5 << (i % 3 ? "\n" : "\r\n");
+
+    CsvOptions options;
+    options.blockRows   = 64;
+    options.readSize    = 100;
+    options.passThrough = true;
+
+    CsvPipeline pipeline(options);
+    pipeline.add(compileString("a = x*2 + y, b = a > k"), "first");
+    pipeline.add(compileString("a - x*2"), "second");
+    pipeline.output("b");
+    pipeline.set("k", 500);
+
+    OutputStringStream out;
+    ASSERT_TRUE(pipeline.run(in, out)) << pipeline.error();
+    EXPECT_EQ(pipeline.rows(), Rows);
+
+    StringStream result(out.str());
+    String       line;
+    std::getline(result, line);
+    EXPECT_EQ(line, "x,y,b,first,second");
+
+    for (int i = 0; i < Rows; ++i)
+    {
+        ASSERT_TRUE(std::getline(result, line));
+
+        const Real   y = (i % 7) * 0.5;
+        const Real   a = i * 2 + y;
+        StringStream expected;
+        expected << i << ',' << y << ',' << (a > 500) << ',' << (a > 500) << ',' << y;
+        EXPECT_EQ(line, expected.str()) << i;
+    }
+
+    // failures name the line
+    StringStream bad("x,y\n1,2\n3,four\n");
+    EXPECT_FALSE(pipeline.run(bad, out));
+    EXPECT_NE(pipeline.error().find("line 3"), String::npos) << pipeline.error();
+
+    StringStream ragged("x,y\n1,2\n3\n");
+    EXPECT_FALSE(pipeline.run(ragged, out));
+    EXPECT_NE(pipeline.error().find("line 3 has 1 fields"), String::npos) << pipeline.error();
+
+    // blocks split across threads, with a float stage in between
+    constexpr int Wide = 5000;
+
+    StringStream wide;
+    wide << "x\n";
+    for (int i = 0; i < Wide; ++i)
+        wide << i << '\n';
+
+    CsvOptions threaded;
+    threaded.blockRows = 4096;
+    threaded.threads   = 3;
+
+    CsvPipeline parallel(threaded);
+    parallel.add(compileString("a = x*0.5", PrecisionFloat32));
+    parallel.add(compileString("a + x"), "r");
+
+    OutputStringStream wideOut;
+    ASSERT_TRUE(parallel.run(wide, wideOut)) << parallel.error();
+    EXPECT_EQ(parallel.rows(), Wide);
+
+    StringStream wideResult(wideOut.str());
+    std::getline(wideResult, line);
+    EXPECT_EQ(line, "r");
+    for (int i = 0; i < Wide; ++i)
+    {
+        ASSERT_TRUE(std::getline(wideResult, line));
+        StringStream expected;
+        expected << i * 1.5;
+        EXPECT_EQ(line, expected.str()) << i;
+    }
+}
+
+GTEST_TEST(Program, Columns022)
+{
+    constexpr size_t Rows = 1000;
+
+    const String input  = testing::TempDir() + "Columns022.in";
+    const String output = testing::TempDir() + "Columns022.out";
+
+    SimpleArray<String> inputs, outputs;
+    inputs.push_back("x");
+    inputs.push_back("y");
+    outputs.push_back("s");
+    outputs.push_back("r");
+    {
+        ColumnFile file;
+        ASSERT_TRUE(file.create(input, inputs, Rows)) << file.error();
+        EXPECT_EQ(file.columnF(0), nullptr);
+        for (size_t i = 0; i < Rows; ++i)
+        {
+            file.column(0)[i] = Real(i);
+            file.column(1)[i] = Real(i % 7);
+        }
+        EXPECT_EQ((size_t)file.column(1) % ColumnAlignment, 0u);
+        ASSERT_TRUE(file.close());
+    }
+
+    // first stage: the assigned s and the result r land in the output
+    ColumnFile in;
+    ASSERT_TRUE(in.open(input)) << in.error();
+    ASSERT_EQ(in.rows(), Rows);
+    ASSERT_EQ(in.columns(), 2u);
+    EXPECT_EQ(in.name(1), "y");
+
+    ColumnFile out;
+    ASSERT_TRUE(out.create(output, outputs, Rows)) << out.error();
+
+    ExecutionContext first(compileString("s = x * y, x = -1, s + 1"));
+    ASSERT_TRUE(in.bind(first));
+    ASSERT_TRUE(out.bind(first));
+    ASSERT_TRUE(first.executeBatch(Rows, out.column(out.find("r"))));
+    in.unbind(first);
+    out.unbind(first);
+    ASSERT_TRUE(out.close());
+
+    // the assignment to x did not reach the input file
+    ColumnFile check;
+    ASSERT_TRUE(check.open(input));
+    EXPECT_EQ(check.column(0)[10], 10.0);
+    EXPECT_EQ(in.column(0)[10], -1.0);
+
+    // second stage reads the first stage's file, in single precision
+    ColumnFile stage;
+    ASSERT_TRUE(stage.open(output)) << stage.error();
+
+    ExecutionContext second(compileString("r - s", PrecisionFloat32));
+    EXPECT_FALSE(stage.bind(second));
+
+    ColumnFile single;
+    ASSERT_TRUE(single.create(output + "f", outputs, Rows, ColumnFloat32));
+    for (size_t i = 0; i < Rows; ++i)
+    {
+        EXPECT_EQ(stage.column(0)[i], Real(i * (i % 7)));
+        EXPECT_EQ(stage.column(1)[i], Real(i * (i % 7) + 1));
+        single.columnF(0)[i] = (float)stage.column(0)[i];
+        single.columnF(1)[i] = (float)stage.column(1)[i];
+    }
+
+    SimpleArray<float> diff;
+    diff.resizeFast(Rows);
+    ASSERT_TRUE(single.bind(second)) << single.error();
+    ASSERT_TRUE(second.executeBatch(Rows, diff.data()));
+    for (size_t i = 0; i < Rows; ++i)
+        EXPECT_EQ(diff[i], 1.f);
+
+    // not a column file
+    {
+        OutputFileStream bad(input + "x", std::ios::binary);
+        bad << "x,y\n1,2\n";
+    }
+    ColumnFile broken;
+    EXPECT_FALSE(broken.open(input + "x"));
+    EXPECT_FALSE(broken.isOpen());
+    EXPECT_NE(broken.error().find("not a column file"), String::npos);
+    EXPECT_FALSE(broken.open(input + "missing"));
+}
+
+GTEST_TEST(Program, Snapshot023)
+{
+    const ProgramPtr program = compileString("y = x * 2, z = {x, y}, w = y + k");
+
+    ExecutionContext ctx(program);
+    ctx.set("x", 3);
+    ctx.set("k", 1);
+    EXPECT_DOUBLE_EQ(ctx.execute(), 7);
+
+    StateSnapshot base;
+    EXPECT_TRUE(base.empty());
+    ctx.snapshot(base);
+    EXPECT_FALSE(base.isDelta());
+    EXPECT_EQ(base.values(), program->slots().size());
+    EXPECT_EQ(base.lists(), 1u);
+
+    ctx.set("x", 5);
+    EXPECT_DOUBLE_EQ(ctx.execute(), 11);
+
+    // the list handle in z is unchanged, only its elements are
+    StateSnapshot delta;
+    ASSERT_TRUE(ctx.snapshot(delta, base));
+    EXPECT_TRUE(delta.isDelta());
+    EXPECT_EQ(delta.values(), 3u);
+    EXPECT_EQ(delta.lists(), 1u);
+
+    ASSERT_TRUE(ctx.restore(base));
+    EXPECT_DOUBLE_EQ(ctx.get("x"), 3);
+    EXPECT_DOUBLE_EQ(ctx.get("w"), 7);
+    ASSERT_EQ(ctx.list("z").size, 2u);
+    EXPECT_DOUBLE_EQ(ctx.list("z")[1], 6);
+
+    ASSERT_TRUE(ctx.restore(delta));
+    EXPECT_DOUBLE_EQ(ctx.get("y"), 10);
+    EXPECT_DOUBLE_EQ(ctx.get("w"), 11);
+    EXPECT_DOUBLE_EQ(ctx.list("z")[0], 5);
+
+    // restored values invalidate the statements that read them
+    ExecutionContext plain(compileString("y = x * 2, w = y + k, v = k * 3"));
+    plain.set("x", 3);
+    plain.set("k", 1);
+    plain.execute();
+
+    StateSnapshot state;
+    plain.snapshot(state);
+    plain.set("x", 4);
+    EXPECT_EQ(plain.recompute(), 2u);
+    EXPECT_DOUBLE_EQ(plain.get("w"), 9);
+
+    ASSERT_TRUE(plain.restore(state));
+    EXPECT_EQ(plain.recompute(), 2u);
+    EXPECT_DOUBLE_EQ(plain.get("w"), 7);
+    EXPECT_DOUBLE_EQ(plain.get("v"), 3);
+
+    // contexts of the same program share state
+    ExecutionContext twin(program);
+    ASSERT_TRUE(twin.restore(base));
+    EXPECT_DOUBLE_EQ(twin.get("w"), 7);
+    EXPECT_DOUBLE_EQ(twin.list("z")[1], 6);
+
+    ExecutionContext other(compileString("x + 1"));
+    EXPECT_FALSE(other.restore(base));
+    EXPECT_FALSE(other.snapshot(delta, base));
+    EXPECT_FALSE(ctx.snapshot(base, delta));
+
+    // a program at the address of a freed one is still another program
+    StateSnapshot stale;
+    {
+        ExecutionContext gone(compileString("x = 1"));
+        gone.execute();
+        gone.snapshot(stale);
+    }
+    ExecutionContext fresh(compileString("x = 2"));
+    EXPECT_FALSE(fresh.restore(stale));
+
+    // Statement keeps its layout across executes
+    StringStream ss;
+    ss << "a = b + 1";
+    StatementParser code;
+    code.read(ss);
+
+    Statement eval;
+    eval.set("b", 2);
+    eval.execute(code.symbols());
+
+    StateSnapshot saved;
+    eval.snapshot(saved);
+    eval.set("b", 10);
+    eval.execute(code.symbols());
+    EXPECT_DOUBLE_EQ(eval.get("a"), 11);
+
+    ASSERT_TRUE(eval.restore(saved));
+    EXPECT_DOUBLE_EQ(eval.get("a"), 3);
+    EXPECT_DOUBLE_EQ(eval.get("b"), 2);
+}
+
+GTEST_TEST(Program, Statement024)
+{
+    Metrics metrics;
+    Metrics::install(&metrics);
+
+    StringStream ss;
+    ss << "a = sin(x/2), b = 4*atan(1) + x*x - 3/x";
+    StatementParser code;
+    code.read(ss);
+
+    // the program is compiled once for the same symbols
+    Statement eval;
+    for (int i = 1; i <= 10; ++i)
+    {
+        eval.set("x", i);
+        eval.execute(code.symbols());
+        EXPECT_DOUBLE_EQ(eval.get("b"), 4 * atan(1) + i * i - 3.0 / i);
+    }
+
+    StringStream next;
+    next << "a = x + 1";
+    StatementParser other;
+    other.read(next);
+    eval.execute(other.symbols());
+    EXPECT_DOUBLE_EQ(eval.get("a"), 11);
+
+    eval.compile(other.symbols());
+
+    // a new read into the same parser may reuse the old addresses
+    StringStream five;
+    five << "5";
+    other.read(five);
+    EXPECT_DOUBLE_EQ(eval.execute(other.symbols()), 5);
+
+    StringStream seven;
+    seven << "7";
+    other.read(seven);
+    EXPECT_DOUBLE_EQ(eval.execute(other.symbols()), 7);
+    Metrics::install(nullptr);
+
+    MetricsSnapshot snap;
+    metrics.snapshot(snap);
+    EXPECT_EQ(snap[CountCompile], 5);
+    EXPECT_EQ(snap[CountExecute], 13);
+}
+
+#ifdef Expression_PROFILE
+GTEST_TEST(Program, Profile025)
+{
+    ExecutionContext ctx(compileString("a = x*0.5 + y*y, b = sin(a) / (a + 1), max(a, b, 2*x)"));
+    ctx.set("x", 0.7);
+    ctx.set("y", -1.3);
+
+    Profiler& profiler = ctx.profiler();
+    profiler.reset();
+    for (int i = 0; i < 3; ++i)
+        ctx.execute();
+
+    EXPECT_EQ(profiler.executions(), 3);
+    EXPECT_EQ(profiler.count(), 3 * ctx.program().fused().size());
+    EXPECT_EQ(profiler.opcode(MathSin).count, 3);
+    EXPECT_EQ(profiler.opcode(MathMax).count, 3);
+    EXPECT_GE(profiler.stackHighWater(), 3);
+
+    OutputStringStream out;
+    profiler.json(out);
+    EXPECT_EQ(out.str().find("{\"executions\":3,"), 0);
+    EXPECT_NE(out.str().find("\"op\":\"sin\""), String::npos);
+
+    Profiler total;
+    total.merge(profiler);
+    total.merge(profiler);
+    EXPECT_EQ(total.count(), 2 * profiler.count());
+    EXPECT_EQ(total.stackHighWater(), profiler.stackHighWater());
+
+    // per-instruction totals add up to the statements and the listing
+    const Program& program = ctx.program();
+    U64            sum     = 0;
+    for (size_t s = 0; s < program.graph().size(); ++s)
+        sum += profiler.statement(program, s).count;
+    EXPECT_EQ(sum, profiler.count());
+
+    const String source = "y = 2\nz = x*y +\n  sin(x)\n";
+    ExecutionContext lines(compileString(source));
+    lines.set("x", 0.5);
+    lines.execute();
+    lines.execute();
+
+    OutputStringStream listing;
+    lines.profiler().listing(listing, lines.program(), source);
+    const String text = listing.str();
+    EXPECT_NE(text.find("1  y = 2"), String::npos);
+    EXPECT_NE(text.find("  sin(x)"), String::npos);
+    EXPECT_EQ(text.find("(no source line)"), String::npos);
+
+    U64 line2 = 0;
+    for (size_t i = 0; i < lines.program().code().size(); ++i)
+    {
+        if (lines.program().lines()[i] == 2)
+            line2 += lines.profiler().instruction((U32)i).count;
+    }
+    EXPECT_EQ(line2 + lines.profiler().statement(lines.program(), 0).count,
+              lines.profiler().count());
+}
+#endif
+
+GTEST_TEST(Program, Lists026)
+{
+    StatementParser code;
+    Statement       eval;
+    eval.set("a", 5);
+
+    StringStream first;
+    first << "x = {a,2,3}, c = {1,2}";
+    code.read(first);
+    eval.execute(code.symbols());
+
+    // the lists held by x and c outlive the program that built them
+    StringStream second;
+    second << "q = {7, a}, y = sum(x), z = sum(c)";
+    code.read(second);
+    eval.execute(code.symbols());
+    EXPECT_DOUBLE_EQ(eval.get("y"), 10);
+    EXPECT_DOUBLE_EQ(eval.get("z"), 3);
+
+    ValueList x;
+    eval.get("x", x);
+    ASSERT_EQ(x.size(), 3);
+    EXPECT_DOUBLE_EQ(x[0], 5);
+    EXPECT_DOUBLE_EQ(x[2], 3);
+
+    // and the next execute of the same program
+    eval.set("a", 1);
+    eval.execute(code.symbols());
+    EXPECT_DOUBLE_EQ(eval.get("y"), 10);
+
+    ValueList q;
+    eval.get("q", q);
+    ASSERT_EQ(q.size(), 2);
+    EXPECT_DOUBLE_EQ(q[1], 1);
+
+    ExecutionContext ctx(compileString("x = {a, 2}, y = x * 2, sum(y)"));
+    ctx.set("a", 1);
+    for (int i = 0; i < 4; ++i)
+        EXPECT_DOUBLE_EQ(ctx.execute(), 6);
+    EXPECT_EQ(ctx.status().code, ErrorNone);
+
+    ExecutionContext nested(compileString("x = {a, 2}, y = {1, x}"));
+    nested.execute();
+    EXPECT_EQ(nested.status().code, ErrorTypeMismatch);
+    EXPECT_TRUE(nested.list("y").empty());
+}
@@ -0,0 +1,195 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "Expression/CsvPipeline.h"
+#include "Expression/StatementParser.h"
+#include "Utils/StreamMethods.h"
+
+using namespace Rt2;
+using namespace Rt2::Eq;
+
+// Usage: eqcsv [options] [input.csv [output.csv]]
+//
+//   -e formula       evaluates formula per row; may be repeated
+//   -f file.eq       evaluates the statements of a file per row
+//   --result name    writes the result of the last -e or -f to a column
+//   --output name    writes a variable to a column; may be repeated
+//   --set name=value sets a variable that is not an input column
+//   --delimiter c    the field separator, ',' by default
+//   --block rows     rows per block, 8192 by default
+//   --threads n      splits the evaluation of each block across n threads
+//   --pass           writes the input columns ahead of the outputs
+//
+// The input and output default to stdin and stdout. Programs run in
+// the order they are given, so a later one reads what an earlier one
+// assigned. A program without --result is only run for its assignments.
+
+namespace
+{
+    struct Source
+    {
+        String text;
+        String file;
+        String result;
+    };
+
+    struct Options
+    {
+        SimpleArray<Source> sources;
+        SimpleArray<String> outputs;
+        SimpleArray<String> names;
+        SimpleArray<double> values;
+        CsvOptions          csv;
+        String              input;
+        String              output;
+    };
+
+    void usage()
+    {
+        std::cerr << "usage: eqcsv [-e formula]... [-f file.eq]... [--result name]\n"
+                     "             [--output name]... [--set name=value]...\n"
+                     "             [--delimiter c] [--block rows] [--threads n] [--pass]\n"
+                     "             [input.csv [output.csv]]\n";
+    }
+
+    bool parseOptions(const int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const char* arg  = argv[i];
+            const bool  more = i + 1 < argc;
+
+            if (std::strcmp(arg, "-e") == 0 && more)
+                options.sources.push_back({argv[++i], "", ""});
+            else if (std::strcmp(arg, "-f") == 0 && more)
+                options.sources.push_back({"", argv[++i], ""});
+            else if (std::strcmp(arg, "--result") == 0 && more && !options.sources.empty())
+                options.sources[options.sources.size() - 1].result = argv[++i];
+            else if (std::strcmp(arg, "--output") == 0 && more)
+                options.outputs.push_back(argv[++i]);
+            else if (std::strcmp(arg, "--set") == 0 && more)
+            {
+                const String pair = argv[++i];
+                const size_t eq   = pair.find('=');
+                if (eq == String::npos || eq == 0)
+                    return false;
+                options.names.push_back(pair.substr(0, eq));
+                options.values.push_back(std::atof(pair.c_str() + eq + 1));
+            }
+            else if (std::strcmp(arg, "--delimiter") == 0 && more && argv[i + 1][0] != 0)
+                options.csv.delimiter = argv[++i][0];
+            else if (std::strcmp(arg, "--block") == 0 && more)
+                options.csv.blockRows = (size_t)std::max(1, std::atoi(argv[++i]));
+            else if (std::strcmp(arg, "--threads") == 0 && more)
+                options.csv.threads = (size_t)std::max(1, std::atoi(argv[++i]));
+            else if (std::strcmp(arg, "--pass") == 0)
+                options.csv.passThrough = true;
+            else if (arg[0] != '-' && options.input.empty())
+                options.input = arg;
+            else if (arg[0] != '-' && options.output.empty())
+                options.output = arg;
+            else
+                return false;
+        }
+        return !options.sources.empty();
+    }
+
+    ProgramPtr compile(const Source& source)
+    {
+        StatementParser parser;
+        if (source.file.empty())
+        {
+            StringStream ss;
+            ss << source.text;
+            parser.read(ss);
+        }
+        else
+            parser.read(source.file);
+        return Program::compile(parser.symbols());
+    }
+
+    int run(const Options& options, CsvPipeline& pipeline)
+    {
+        InputFileStream  fin;
+        OutputFileStream fout;
+        if (!options.input.empty())
+        {
+            fin.open(options.input, std::ios::binary);
+            if (!fin.is_open())
+            {
+                std::cerr << "cannot read " << options.input << '\n';
+                return 1;
+            }
+        }
+        if (!options.output.empty())
+        {
+            fout.open(options.output, std::ios::binary);
+            if (!fout.is_open())
+            {
+                std::cerr << "cannot write " << options.output << '\n';
+                return 1;
+            }
+        }
+
+        IStream& in  = options.input.empty() ? std::cin : fin;
+        OStream& out = options.output.empty() ? std::cout : fout;
+        if (!pipeline.run(in, out))
+        {
+            std::cerr << pipeline.error() << '\n';
+            return 1;
+        }
+        return 0;
+    }
+}  // namespace
+
+int main(const int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        usage();
+        return 1;
+    }
+
+    std::ios::sync_with_stdio(false);
+
+    CsvPipeline pipeline(options.csv);
+    try
+    {
+        for (const Source& source : options.sources)
+            pipeline.add(compile(source), source.result);
+    }
+    catch (Exception& ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return 1;
+    }
+
+    for (const String& name : options.outputs)
+        pipeline.output(name);
+    for (size_t i = 0; i < options.names.size(); ++i)
+        pipeline.set(options.names[i], options.values[i]);
+
+    return run(options, pipeline);
+}
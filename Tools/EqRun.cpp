@@ -0,0 +1,900 @@
+/*
+-------------------------------------------------------------------------------
+    Copyright (c) Charles Carley.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Expression/ColumnFile.h"
+#include "Expression/CsvPipeline.h"
+#include "Expression/ExecutionContext.h"
+#include "Expression/StatementParser.h"
+#include "Utils/StreamMethods.h"
+
+using namespace Rt2;
+using namespace Rt2::Eq;
+
+// Usage: eqrun [options] file.eq
+//
+// Compiles file.eq once and evaluates it for every row of the input.
+// Each input column is bound to the variable of the same name.
+//
+//   --input file      rows from a CSV file whose first line names the
+//                     columns; '-' or no input at all reads stdin
+//   --delimiter c     the CSV field separator, ',' by default
+//   --columns file    rows from a column file (see ColumnFile)
+//   --range n=a:b[:s] rows where n runs from a to b in steps of s;
+//                     may be repeated, every range must give as many rows
+//   --out file        writes to a file instead of stdout
+//   --format f        csv, columns or none; columns needs --out
+//   --output name     also writes a variable; may be repeated
+//   --result name     names the result column, 'result' by default
+//   --set n=value     sets a variable that is not an input column
+//   --threads n       splits each block of rows across n threads
+//   --block rows      rows per block, 65536 by default
+//   --precision p     64 or 32 bit evaluation
+//   --stats           prints compile time, the program summary and the
+//                     throughput to stderr
+//
+// Rows are read, evaluated and written a block at a time, so memory
+// does not grow with the input, except that writing a column file
+// from CSV input keeps the written columns until the input ends to
+// size the file. CSV input runs on a CsvPipeline, which parses,
+// evaluates and writes on separate threads.
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    enum Format
+    {
+        FormatCsv,
+        FormatColumns,
+        FormatNone,
+    };
+
+    struct Range
+    {
+        String name;
+        double first{0};
+        double last{0};
+        double step{1};
+        size_t rows{0};
+    };
+
+    struct Options
+    {
+        String              source;
+        String              input;
+        String              columns;
+        char                delimiter{','};
+        SimpleArray<Range>  ranges;
+        String              out;
+        Format              format{FormatCsv};
+        SimpleArray<String> outputs;
+        String              result{"result"};
+        SimpleArray<String> names;
+        SimpleArray<double> values;
+        size_t              threads{1};
+        size_t              block{65536};
+        Precision           precision{PrecisionFloat64};
+        bool                stats{false};
+    };
+
+    double seconds(const Clock::time_point& start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    bool parseRange(const String& text, Range& range)
+    {
+        const size_t eq = text.find('=');
+        if (eq == String::npos || eq == 0)
+            return false;
+        range.name = text.substr(0, eq);
+
+        char*       end;
+        const char* p = text.c_str() + eq + 1;
+        range.first   = std::strtod(p, &end);
+        if (end == p || *end != ':')
+            return false;
+        p          = end + 1;
+        range.last = std::strtod(p, &end);
+        if (end == p)
+            return false;
+        if (*end == ':')
+        {
+            p          = end + 1;
+            range.step = std::strtod(p, &end);
+            if (end == p)
+                return false;
+        }
+        if (*end != 0 || !(range.step > 0) || range.last < range.first)
+            return false;
+
+        range.rows = (size_t)std::floor((range.last - range.first) / range.step + 1e-9) + 1;
+        return true;
+    }
+
+    bool parseOptions(const int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const char* arg  = argv[i];
+            const bool  more = i + 1 < argc;
+
+            if (std::strcmp(arg, "--input") == 0 && more)
+                options.input = argv[++i];
+            else if (std::strcmp(arg, "--delimiter") == 0 && more && argv[i + 1][0] != 0)
+                options.delimiter = argv[++i][0];
+            else if (std::strcmp(arg, "--columns") == 0 && more)
+                options.columns = argv[++i];
+            else if (std::strcmp(arg, "--range") == 0 && more)
+            {
+                Range range;
+                if (!parseRange(argv[++i], range))
+                    return false;
+                options.ranges.push_back(range);
+            }
+            else if (std::strcmp(arg, "--out") == 0 && more)
+                options.out = argv[++i];
+            else if (std::strcmp(arg, "--format") == 0 && more)
+            {
+                const String format = argv[++i];
+                if (format == "csv")
+                    options.format = FormatCsv;
+                else if (format == "columns")
+                    options.format = FormatColumns;
+                else if (format == "none")
+                    options.format = FormatNone;
+                else
+                    return false;
+            }
+            else if (std::strcmp(arg, "--output") == 0 && more)
+                options.outputs.push_back(argv[++i]);
+            else if (std::strcmp(arg, "--result") == 0 && more)
+                options.result = argv[++i];
+            else if (std::strcmp(arg, "--set") == 0 && more)
+            {
+                const String pair = argv[++i];
+                const size_t eq   = pair.find('=');
+                if (eq == String::npos || eq == 0)
+                    return false;
+                options.names.push_back(pair.substr(0, eq));
+                options.values.push_back(std::atof(pair.c_str() + eq + 1));
+            }
+            else if (std::strcmp(arg, "--threads") == 0 && more)
+                options.threads = (size_t)std::max(1, std::atoi(argv[++i]));
+            else if (std::strcmp(arg, "--block") == 0 && more)
+                options.block = (size_t)std::max(1, std::atoi(argv[++i]));
+            else if (std::strcmp(arg, "--precision") == 0 && more)
+            {
+                const int bits = std::atoi(argv[++i]);
+                if (bits != 32 && bits != 64)
+                    return false;
+                options.precision = bits == 32 ? PrecisionFloat32 : PrecisionFloat64;
+            }
+            else if (std::strcmp(arg, "--stats") == 0)
+                options.stats = true;
+            else if (arg[0] != '-' && options.source.empty())
+                options.source = arg;
+            else
+                return false;
+        }
+
+        const int inputs = !options.input.empty() + !options.columns.empty() + !options.ranges.empty();
+        if (options.source.empty() || inputs > 1)
+            return false;
+        return options.format != FormatColumns || !options.out.empty();
+    }
+
+    /// <summary>
+    /// A block of rows, one column per input, output and result.
+    /// Input columns may point into a mapped column file.
+    /// </summary>
+    template <typename T>
+    struct Block
+    {
+        SimpleArray<T>  storage;
+        SimpleArray<T*> columns;
+        size_t          rows{0};
+        size_t          first{0};
+
+        /// <summary>
+        /// Points every column at the storage, with room for
+        /// capacity rows each.
+        /// </summary>
+        void reserve(const size_t capacity)
+        {
+            if (storage.size() < capacity * columns.size())
+                storage.resizeFast(capacity * columns.size());
+            for (size_t c = 0; c < columns.size(); ++c)
+                columns[c] = storage.data() + c * capacity;
+        }
+    };
+
+    template <typename T>
+    class Input
+    {
+    public:
+        virtual ~Input() = default;
+
+        SimpleArray<String> names;
+        String              error;
+
+        /// <summary>
+        /// The number of rows.
+        /// </summary>
+        virtual size_t total() const = 0;
+
+        /// <summary>
+        /// Points the first names.size() columns of the block at the
+        /// next rows, at most max of them. Returns false on an error.
+        /// </summary>
+        virtual bool read(Block<T>& block, size_t max) = 0;
+    };
+
+    template <typename T>
+    class ColumnInput final : public Input<T>
+    {
+    private:
+        ColumnFile _file;
+        size_t     _row{0};
+
+    public:
+        bool open(const String& path)
+        {
+            if (!_file.open(path))
+            {
+                this->error = _file.error();
+                return false;
+            }
+            for (size_t c = 0; c < _file.columns(); ++c)
+                this->names.push_back(_file.name(c));
+            return true;
+        }
+
+        size_t total() const override
+        {
+            return _file.rows();
+        }
+
+        bool read(Block<T>& block, const size_t max) override
+        {
+            const size_t rows = std::min(max, _file.rows() - _row);
+            for (size_t c = 0; c < _file.columns(); ++c)
+            {
+                // the file's own type is used in place
+                if constexpr (std::is_same_v<T, float>)
+                {
+                    if (_file.type() == ColumnFloat32)
+                    {
+                        block.columns[c] = _file.columnF(c) + _row;
+                        continue;
+                    }
+                    const Math::Real* src = _file.column(c) + _row;
+                    for (size_t r = 0; r < rows; ++r)
+                        block.columns[c][r] = (float)src[r];
+                }
+                else
+                {
+                    if (_file.type() == ColumnFloat64)
+                    {
+                        block.columns[c] = _file.column(c) + _row;
+                        continue;
+                    }
+                    const float* src = _file.columnF(c) + _row;
+                    for (size_t r = 0; r < rows; ++r)
+                        block.columns[c][r] = src[r];
+                }
+            }
+            block.first = _row;
+            block.rows  = rows;
+            _row += rows;
+            return true;
+        }
+    };
+
+    template <typename T>
+    class RangeInput final : public Input<T>
+    {
+    private:
+        const SimpleArray<Range>& _ranges;
+        size_t                    _row{0};
+
+    public:
+        explicit RangeInput(const SimpleArray<Range>& ranges) :
+            _ranges(ranges)
+        {
+            for (const Range& range : ranges)
+                this->names.push_back(range.name);
+        }
+
+        bool check()
+        {
+            for (const Range& range : _ranges)
+            {
+                if (range.rows != _ranges[0].rows)
+                {
+                    this->error = "range " + range.name + " gives " + std::to_string(range.rows) +
+                                  " rows, expected " + std::to_string(_ranges[0].rows);
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        size_t total() const override
+        {
+            return _ranges[0].rows;
+        }
+
+        bool read(Block<T>& block, const size_t max) override
+        {
+            const size_t rows = std::min(max, total() - _row);
+            for (size_t c = 0; c < _ranges.size(); ++c)
+            {
+                // multiplied rather than summed, so that the
+                // error does not grow along the range
+                const Range& range = _ranges[c];
+                for (size_t r = 0; r < rows; ++r)
+                    block.columns[c][r] = (T)(range.first + double(_row + r) * range.step);
+            }
+            block.first = _row;
+            block.rows  = rows;
+            _row += rows;
+            return true;
+        }
+    };
+
+    template <typename T>
+    class Runner
+    {
+    private:
+        const Options&                 _options;
+        ProgramPtr                     _program;
+        SimpleArray<ExecutionContext*> _contexts;
+        SimpleArray<String>            _columns;
+        SimpleArray<VInt>              _slots;
+        SimpleArray<U32>               _written;
+        size_t                         _inputs{0};
+        std::unique_ptr<Input<T>>      _input;
+        Block<T>                       _block;
+        size_t                         _capacity{0};
+        ColumnFile                     _file;
+        OutputFileStream               _stream;
+        OStream*                       _out{&std::cout};
+        String                         _text;
+        String                         _error;
+        size_t                         _rows{0};
+        double                         _evaluate{0};
+
+        bool fail(const String& message)
+        {
+            _error = message;
+            return false;
+        }
+
+        size_t find(const String& name) const
+        {
+            for (size_t i = 0; i < _columns.size(); ++i)
+            {
+                if (_columns[i] == name)
+                    return i;
+            }
+            return Npos;
+        }
+
+        void layout()
+        {
+            _inputs  = _input->names.size();
+            _columns = _input->names;
+
+            for (const String& name : _options.outputs)
+            {
+                size_t idx = find(name);
+                if (idx == Npos)
+                {
+                    idx = _columns.size();
+                    _columns.push_back(name);
+                }
+                _written.push_back((U32)idx);
+            }
+            _columns.push_back(_options.result);
+            _written.push_back((U32)_columns.size() - 1);
+
+            // every column but the result is a variable
+            for (size_t c = 0; c + 1 < _columns.size(); ++c)
+                _slots.push_back(_program->indexOf(_columns[c]));
+
+            _capacity = std::max<size_t>(std::min(_options.block, _input->total()), 1);
+            _block.columns.resizeFast(_columns.size());
+        }
+
+        bool evaluate()
+        {
+            const size_t rows    = _block.rows;
+            const size_t threads = std::min(_contexts.size(), std::max<size_t>(rows / 1024, 1));
+            const size_t per     = (rows + threads - 1) / threads;
+
+            // outputs that the program does not assign read as NaN
+            for (size_t c = _inputs; c < _columns.size(); ++c)
+                std::fill_n(_block.columns[c], rows, T(NAN));
+
+            std::atomic<bool> failed{false};
+            String            message;
+            std::mutex        lock;
+
+            const auto run = [&](const size_t t)
+            {
+                const size_t first = t * per;
+                const size_t count = std::min(per, rows - first);
+                if (first >= rows)
+                    return;
+
+                ExecutionContext* ctx = _contexts[t];
+                for (size_t c = 0; c < _slots.size(); ++c)
+                    ctx->bind(_slots[c], BasicStridedView<T>::column(_block.columns[c] + first));
+
+                if (!ctx->executeBatch(count, _block.columns[_columns.size() - 1] + first))
+                {
+                    std::lock_guard guard(lock);
+                    if (!failed)
+                        message = "rows " + std::to_string(_block.first + first + 1) + " to " +
+                                  std::to_string(_block.first + first + count) + ": " +
+                                  ctx->status().message();
+                    failed = true;
+                }
+            };
+
+            const Clock::time_point start = Clock::now();
+            if (threads == 1)
+                run(0);
+            else
+            {
+                std::unique_ptr<std::thread[]> workers(new std::thread[threads]);
+                for (size_t t = 0; t < threads; ++t)
+                    workers[t] = std::thread(run, t);
+                for (size_t t = 0; t < threads; ++t)
+                    workers[t].join();
+            }
+            _evaluate += seconds(start);
+
+            return failed ? fail(message) : true;
+        }
+
+        bool begin()
+        {
+            if (_options.format == FormatNone)
+                return true;
+
+            if (_options.format == FormatColumns)
+            {
+                SimpleArray<String> names;
+                for (const U32 c : _written)
+                    names.push_back(_columns[c]);
+
+                if (!_file.create(_options.out,
+                                  names,
+                                  _input->total(),
+                                  std::is_same_v<T, float> ? ColumnFloat32 : ColumnFloat64))
+                    return fail(_file.error());
+                return true;
+            }
+
+            if (!_options.out.empty())
+            {
+                _stream.open(_options.out, std::ios::binary);
+                if (!_stream.is_open())
+                    return fail("cannot write " + _options.out);
+                _out = &_stream;
+            }
+            for (size_t i = 0; i < _written.size(); ++i)
+            {
+                if (i > 0)
+                    *_out << ',';
+                *_out << _columns[_written[i]];
+            }
+            *_out << '\n';
+            return true;
+        }
+
+        bool write()
+        {
+            if (_options.format == FormatNone)
+                return true;
+
+            if (_options.format == FormatColumns)
+            {
+                for (size_t i = 0; i < _written.size(); ++i)
+                {
+                    T* dest = std::is_same_v<T, float> ? (T*)_file.columnF(i) : (T*)_file.column(i);
+                    std::memcpy(dest + _block.first, _block.columns[_written[i]], _block.rows * sizeof(T));
+                }
+                return true;
+            }
+
+            char number[32];
+            _text.resize(0);
+            for (size_t r = 0; r < _block.rows; ++r)
+            {
+                for (size_t i = 0; i < _written.size(); ++i)
+                {
+                    if (i > 0)
+                        _text.push_back(',');
+
+                    const auto res = std::to_chars(number, number + sizeof number, _block.columns[_written[i]][r]);
+                    _text.append(number, res.ptr);
+                }
+                _text.push_back('\n');
+            }
+            _out->write(_text.data(), (std::streamsize)_text.size());
+            return *_out ? true : fail("failed to write the output");
+        }
+
+    public:
+        Runner(const Options& options, ProgramPtr program) :
+            _options(options),
+            _program(std::move(program))
+        {
+            for (size_t t = 0; t < options.threads; ++t)
+            {
+                ExecutionContext* ctx = new ExecutionContext(_program);
+                for (size_t i = 0; i < options.names.size(); ++i)
+                    ctx->set(options.names[i], options.values[i]);
+                _contexts.push_back(ctx);
+            }
+        }
+
+        ~Runner()
+        {
+            for (const ExecutionContext* ctx : _contexts)
+                delete ctx;
+        }
+
+        bool open()
+        {
+            if (!_options.columns.empty())
+            {
+                auto* input = new ColumnInput<T>();
+                _input.reset(input);
+                if (!input->open(_options.columns))
+                    return fail(input->error);
+            }
+            else
+            {
+                auto* input = new RangeInput<T>(_options.ranges);
+                _input.reset(input);
+                if (!input->check())
+                    return fail(input->error);
+            }
+            layout();
+            return true;
+        }
+
+        bool run()
+        {
+            if (!begin())
+                return false;
+
+            for (;;)
+            {
+                // the last block may have pointed columns into a mapped file
+                _block.reserve(_capacity);
+                if (!_input->read(_block, _capacity))
+                    return fail(_input->error);
+
+                if (_block.rows == 0)
+                    break;
+                if (!evaluate() || !write())
+                    return false;
+                _rows += _block.rows;
+            }
+
+            if (_options.format == FormatColumns)
+                return _file.close() ? true : fail(_file.error());
+            if (_options.format == FormatCsv)
+            {
+                _out->flush();
+                return *_out ? true : fail("failed to write the output");
+            }
+            return true;
+        }
+
+        const String& error() const
+        {
+            return _error;
+        }
+
+        size_t rows() const
+        {
+            return _rows;
+        }
+
+        double evaluateSeconds() const
+        {
+            return _evaluate;
+        }
+    };
+
+    class NullSink final : public CsvSink
+    {
+    public:
+        bool begin(const SimpleArray<String>&) override
+        {
+            return true;
+        }
+
+        bool write(const Math::Real* const*, size_t) override
+        {
+            return true;
+        }
+
+        bool end() override
+        {
+            return true;
+        }
+    };
+
+    /// <summary>
+    /// Writes the rows of a CsvPipeline run to a column file. The row
+    /// count is only known once the input ends, so the written values
+    /// are kept, row major, until then.
+    /// </summary>
+    template <typename T>
+    class ColumnSink final : public CsvSink
+    {
+    private:
+        const String&       _path;
+        SimpleArray<String> _names;
+        SimpleArray<T>      _values;
+        ColumnFile          _file;
+
+    public:
+        explicit ColumnSink(const String& path) :
+            _path(path)
+        {
+        }
+
+        bool begin(const SimpleArray<String>& names) override
+        {
+            _names = names;
+            return true;
+        }
+
+        bool write(const Math::Real* const* columns, const size_t rows) override
+        {
+            for (size_t r = 0; r < rows; ++r)
+            {
+                for (size_t c = 0; c < _names.size(); ++c)
+                    _values.push_back((T)columns[c][r]);
+            }
+            return true;
+        }
+
+        bool end() override
+        {
+            const size_t nr   = _names.size();
+            const size_t rows = _values.size() / nr;
+            if (!_file.create(_path,
+                              _names,
+                              rows,
+                              std::is_same_v<T, float> ? ColumnFloat32 : ColumnFloat64))
+            {
+                error = _file.error();
+                return false;
+            }
+
+            for (size_t c = 0; c < nr; ++c)
+            {
+                T* dest = std::is_same_v<T, float> ? (T*)_file.columnF(c) : (T*)_file.column(c);
+                for (size_t r = 0; r < rows; ++r)
+                    dest[r] = _values[r * nr + c];
+            }
+            if (!_file.close())
+            {
+                error = _file.error();
+                return false;
+            }
+            return true;
+        }
+    };
+
+    void usage()
+    {
+        std::cerr << "usage: eqrun [--input file | --columns file | --range n=a:b[:s]...]\n"
+                     "             [--delimiter c] [--out file] [--format csv|columns|none]\n"
+                     "             [--output name]... [--result name] [--set n=value]...\n"
+                     "             [--threads n] [--block rows] [--precision 64|32]\n"
+                     "             [--stats] file.eq\n";
+    }
+
+    void summary(const Program& program, const size_t symbols, const double parse, const double compile)
+    {
+        const size_t code  = program.code().size();
+        const size_t fused = program.fused().size();
+
+        std::cerr << "compile    " << (parse + compile) * 1e3 << " ms ("
+                  << parse * 1e3 << " ms parsing, " << compile * 1e3 << " ms compiling)\n"
+                  << "symbols    " << symbols << '\n'
+                  << "code       " << code << " instructions, " << fused << " after fusion";
+        if (code > 0)
+            std::cerr << " (" << (int)std::lround(100.0 * double(code - fused) / double(code))
+                      << "% fewer dispatches)";
+        std::cerr << '\n'
+                  << "constants  " << program.constants().size() << " values, "
+                  << program.lists().size() << " folded lists\n"
+                  << "variables  " << program.slots().size() << " in "
+                  << program.graph().size() << " statements ("
+                  << (program.graph().incremental() ? "incremental" : "not incremental") << ")\n"
+                  << "stack      " << program.stackDepth() << " values deep\n";
+    }
+
+    template <typename T>
+    int run(const Options& options, ProgramPtr program)
+    {
+        const Clock::time_point start = Clock::now();
+
+        Runner<T> runner(options, std::move(program));
+        if (!runner.open() || !runner.run())
+        {
+            std::cerr << runner.error() << '\n';
+            return 1;
+        }
+
+        if (options.stats)
+        {
+            const double total = seconds(start);
+            const double eval  = runner.evaluateSeconds();
+            std::cerr << "rows       " << runner.rows() << " in " << total << " s, "
+                      << double(runner.rows()) / std::max(total, 1e-9) / 1e6 << " Mrows/s\n"
+                      << "evaluate   " << eval << " s on " << options.threads << " threads, "
+                      << double(runner.rows()) / std::max(eval, 1e-9) / 1e6 << " Mrows/s\n";
+        }
+        return 0;
+    }
+    int runCsv(const Options& options, ProgramPtr program)
+    {
+        const Clock::time_point start = Clock::now();
+
+        InputFileStream fin;
+        IStream*        in = &std::cin;
+        if (!options.input.empty() && options.input != "-")
+        {
+            fin.open(options.input, std::ios::binary);
+            if (!fin.is_open())
+            {
+                std::cerr << "cannot read " << options.input << '\n';
+                return 1;
+            }
+            in = &fin;
+        }
+
+        CsvOptions csv;
+        csv.delimiter = options.delimiter;
+        csv.blockRows = options.block;
+        csv.threads   = options.threads;
+
+        CsvPipeline pipeline(csv);
+        pipeline.add(std::move(program), options.result);
+        for (const String& name : options.outputs)
+            pipeline.output(name);
+        for (size_t i = 0; i < options.names.size(); ++i)
+            pipeline.set(options.names[i], options.values[i]);
+
+        bool ok;
+        if (options.format == FormatNone)
+        {
+            NullSink sink;
+            ok = pipeline.run(*in, sink);
+        }
+        else if (options.format == FormatColumns)
+        {
+            if (options.precision == PrecisionFloat32)
+            {
+                ColumnSink<float> sink(options.out);
+                ok = pipeline.run(*in, sink);
+            }
+            else
+            {
+                ColumnSink<Math::Real> sink(options.out);
+                ok = pipeline.run(*in, sink);
+            }
+        }
+        else
+        {
+            OutputFileStream fout;
+            if (!options.out.empty())
+            {
+                fout.open(options.out, std::ios::binary);
+                if (!fout.is_open())
+                {
+                    std::cerr << "cannot write " << options.out << '\n';
+                    return 1;
+                }
+            }
+            ok = pipeline.run(*in, options.out.empty() ? std::cout : fout);
+        }
+
+        if (!ok)
+        {
+            std::cerr << pipeline.error() << '\n';
+            return 1;
+        }
+
+        if (options.stats)
+        {
+            // evaluation overlaps parsing and writing, so only
+            // the throughput of the whole run is meaningful
+            const double total = seconds(start);
+            std::cerr << "rows       " << pipeline.rows() << " in " << total << " s, "
+                      << double(pipeline.rows()) / std::max(total, 1e-9) / 1e6 << " Mrows/s\n"
+                      << "evaluate   on " << options.threads << " threads, overlapped with I/O\n";
+        }
+        return 0;
+    }
+}  // namespace
+
+int main(const int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        usage();
+        return 1;
+    }
+
+    std::ios::sync_with_stdio(false);
+
+    ProgramPtr program;
+    try
+    {
+        const Clock::time_point start = Clock::now();
+
+        StatementParser parser;
+        parser.read(options.source);
+        const double parse = seconds(start);
+
+        const Clock::time_point compiled = Clock::now();
+        program = Program::compile(parser.symbols(), options.precision);
+
+        if (options.stats)
+            summary(*program, parser.symbols().size(), parse, seconds(compiled));
+    }
+    catch (Exception& ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return 1;
+    }
+
+    if (options.columns.empty() && options.ranges.empty())
+        return runCsv(options, std::move(program));
+    if (options.precision == PrecisionFloat32)
+        return run<float>(options, std::move(program));
+    return run<Math::Real>(options, std::move(program));
+}